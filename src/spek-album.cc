@@ -0,0 +1,167 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+
+#include "spek-audio.h"
+
+#include "spek-album.h"
+
+enum
+{
+    CUE_FRAMES = 75, // Per second, the INDEX times are in minutes, seconds and frames.
+};
+
+// Forward declarations.
+static bool read_cue(std::istream& in, const std::string& dir, std::vector<AudioSource>& tracks);
+static bool read_playlist(
+    std::istream& in, const std::string& dir, std::vector<AudioSource>& tracks);
+static std::string extension(const std::string& path);
+static std::string resolve(const std::string& dir, const std::string& name);
+static std::string next_word(const std::string& line, size_t& pos);
+static std::string upper(std::string s);
+
+bool spek_is_album(const std::string& path)
+{
+    std::string ext = extension(path);
+    return ext == "cue" || ext == "m3u" || ext == "m3u8";
+}
+
+bool spek_read_album(const std::string& path, std::vector<AudioSource>& tracks)
+{
+    tracks.clear();
+    std::ifstream in(path.c_str());
+    if (!in) {
+        return false;
+    }
+    size_t slash = path.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    bool ok = extension(path) == "cue" ?
+        read_cue(in, dir, tracks) : read_playlist(in, dir, tracks);
+    return ok && !tracks.empty();
+}
+
+static bool read_cue(std::istream& in, const std::string& dir, std::vector<AudioSource>& tracks)
+{
+    std::string file_name;
+    bool in_track = false; // A TRACK whose INDEX 01 hasn't come yet.
+    bool file_started = false; // The current file already has a track.
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t pos = 0;
+        if (!line.compare(0, 3, "\xEF\xBB\xBF")) {
+            pos = 3;
+        }
+        std::string command = upper(next_word(line, pos));
+        if (command == "FILE") {
+            file_name = resolve(dir, next_word(line, pos));
+            file_started = false;
+            in_track = false;
+        } else if (command == "TRACK") {
+            next_word(line, pos);
+            // Data tracks of mixed mode discs have no audio to analyse.
+            in_track = upper(next_word(line, pos)) == "AUDIO";
+        } else if (command == "INDEX" && in_track && !file_name.empty()) {
+            if (atoi(next_word(line, pos).c_str()) != 1) {
+                continue;
+            }
+            int minutes = 0, seconds = 0, frames = 0;
+            std::string time = next_word(line, pos);
+            if (sscanf(time.c_str(), "%d:%d:%d", &minutes, &seconds, &frames) != 3) {
+                return false;
+            }
+            double start = minutes * 60 + seconds + frames / (double)CUE_FRAMES;
+            if (file_started) {
+                if (start < tracks.back().start) {
+                    return false;
+                }
+                tracks.back().end = start;
+            } else {
+                start = 0.0;
+            }
+            AudioSource track;
+            track.file_name = file_name;
+            track.start = start;
+            tracks.push_back(track);
+            file_started = true;
+            in_track = false;
+        }
+    }
+    return true;
+}
+
+static bool read_playlist(
+    std::istream& in, const std::string& dir, std::vector<AudioSource>& tracks)
+{
+    std::string line;
+    bool first = true;
+    while (std::getline(in, line)) {
+        if (first && !line.compare(0, 3, "\xEF\xBB\xBF")) {
+            line.erase(0, 3);
+        }
+        first = false;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        AudioSource track;
+        track.file_name = resolve(dir, line);
+        tracks.push_back(track);
+    }
+    return true;
+}
+
+static std::string extension(const std::string& path)
+{
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos) {
+        return std::string();
+    }
+    std::string ext = path.substr(dot + 1);
+    for (char& c : ext) {
+        c = tolower((unsigned char)c);
+    }
+    return ext;
+}
+
+// Paths are relative to the directory of the list unless they're absolute, or URLs.
+static std::string resolve(const std::string& dir, const std::string& name)
+{
+    if (name.empty() || name[0] == '/' || name[0] == '\\' ||
+        (name.size() > 1 && name[1] == ':') || name.find("://") != std::string::npos) {
+        return name;
+    }
+    return dir + name;
+}
+
+// The word of the line from `pos` on, without the quotes if it's quoted.
+static std::string next_word(const std::string& line, size_t& pos)
+{
+    while (pos < line.size() && isspace((unsigned char)line[pos])) {
+        pos++;
+    }
+    size_t start = pos;
+    if (pos < line.size() && line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        pos = end < line.size() ? end + 1 : end;
+        return line.substr(start + 1, end - start - 1);
+    }
+    while (pos < line.size() && !isspace((unsigned char)line[pos])) {
+        pos++;
+    }
+    return line.substr(start, pos - start);
+}
+
+static std::string upper(std::string s)
+{
+    for (char& c : s) {
+        c = toupper((unsigned char)c);
+    }
+    return s;
+}
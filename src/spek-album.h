@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct AudioSource;
+
+// Whether `path` is a cue sheet or an M3U playlist, which Audio::open() reads as one stream.
+bool spek_is_album(const std::string& path);
+
+// The tracks listed in the cue sheet or the playlist at `path`, in order, with the paths of
+// their files relative to its directory. Each file of a playlist is a track of its own, the
+// tracks of a cue sheet go from their INDEX 01 to the next one in the same file, or to its end.
+// The first track of a file also has the pregap before its INDEX 01, so nothing is left out.
+// Returns false if it can't be read or lists no tracks.
+bool spek_read_album(const std::string& path, std::vector<AudioSource>& tracks);
@@ -0,0 +1,145 @@
+#include <math.h>
+
+#include "spek-loudness.h"
+#include "spek-utils.h"
+
+#include "spek-analyzer.h"
+
+enum
+{
+    MIN_CLIP_RUN = 3, // Consecutive full-scale samples to count as clipping.
+};
+
+// The largest positive value of 16-bit samples, the least precise format that can clip.
+static const float CLIP_LEVEL = 1.0f - 1.0f / 32768.0f;
+
+double spek_analyzer_db(double amplitude)
+{
+    return amplitude > 0.0 ? 20.0 * log10(amplitude) : -INFINITY;
+}
+
+void PeakAnalyzer::process(const float *samples, int n)
+{
+    float peak = this->peak;
+    for (int i = 0; i < n; i++) {
+        peak = fmaxf(peak, fabsf(samples[i]));
+    }
+    this->peak = peak;
+}
+
+void PeakAnalyzer::process_channels(const float *samples, int n)
+{
+    this->process(samples, n * spek_max(this->format.channels, 1));
+}
+
+std::vector<AnalyzerResult> PeakAnalyzer::get_results() const
+{
+    return { { "peak", spek_analyzer_db(this->peak), "dBFS" } };
+}
+
+void RmsAnalyzer::process(const float *samples, int n)
+{
+    // Sum each block on its own first to keep the precision over hours of samples.
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i] * samples[i];
+    }
+    this->sum += sum;
+    this->count += n;
+}
+
+void RmsAnalyzer::process_channels(const float *samples, int n)
+{
+    this->process(samples, n * spek_max(this->format.channels, 1));
+}
+
+std::vector<AnalyzerResult> RmsAnalyzer::get_results() const
+{
+    double rms = this->count ? sqrt(this->sum / this->count) : 0.0;
+    return { { "rms", spek_analyzer_db(rms), "dBFS" } };
+}
+
+void DcOffsetAnalyzer::process(const float *samples, int n)
+{
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    this->sum += sum;
+    this->count += n;
+}
+
+void DcOffsetAnalyzer::process_channels(const float *samples, int n)
+{
+    this->process(samples, n * spek_max(this->format.channels, 1));
+}
+
+std::vector<AnalyzerResult> DcOffsetAnalyzer::get_results() const
+{
+    double mean = this->count ? this->sum / this->count : 0.0;
+    return { { "dc_offset", 100.0 * mean, "%" } };
+}
+
+void ClipAnalyzer::process(const float *samples, int n)
+{
+    for (int i = 0; i < n; i++) {
+        this->process_sample(samples[i], 0);
+    }
+}
+
+void ClipAnalyzer::process_channels(const float *samples, int n)
+{
+    // The runs are of consecutive samples of the same channel.
+    int channels = spek_max(this->format.channels, 1);
+    this->run.resize(channels, 0);
+    for (int i = 0; i < n; i++) {
+        for (int channel = 0; channel < channels; channel++) {
+            this->process_sample(samples[i * channels + channel], channel);
+        }
+    }
+}
+
+void ClipAnalyzer::process_sample(float sample, int channel)
+{
+    if (fabsf(sample) >= CLIP_LEVEL) {
+        this->samples++;
+        if (++this->run[channel] == MIN_CLIP_RUN) {
+            this->runs++;
+        }
+    } else {
+        this->run[channel] = 0;
+    }
+}
+
+std::vector<AnalyzerResult> ClipAnalyzer::get_results() const
+{
+    return {
+        { "clipped_samples", (double)this->samples, "" },
+        { "clipped_runs", (double)this->runs, "" },
+    };
+}
+
+std::unique_ptr<Analyzer> spek_analyzer_create(const std::string& name)
+{
+    if (name == "peak") {
+        return std::unique_ptr<Analyzer>(new PeakAnalyzer());
+    }
+    if (name == "rms") {
+        return std::unique_ptr<Analyzer>(new RmsAnalyzer());
+    }
+    if (name == "dc_offset") {
+        return std::unique_ptr<Analyzer>(new DcOffsetAnalyzer());
+    }
+    if (name == "clipping") {
+        return std::unique_ptr<Analyzer>(new ClipAnalyzer());
+    }
+    if (name == "loudness") {
+        return std::unique_ptr<Analyzer>(new LoudnessAnalyzer());
+    }
+    return nullptr;
+}
+
+std::vector<std::string> spek_analyzer_names()
+{
+    return { "peak", "rms", "dc_offset", "clipping", "loudness" };
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// What an analyzer is fed with, known once the pipeline starts.
+struct AnalyzerFormat
+{
+    int sample_rate; // Of the samples, the file's even if the FFTs run at a lower rate.
+    int bits_per_sample; // Of the decoded format, 0 if unknown or floating point.
+    double duration;
+    // The columns of the first FFT size, in dB, with `bands` values from `low` to `high` Hz.
+    int bands;
+    double low;
+    double high;
+    int channels; // Of the file, see Analyzer::wants_all_channels().
+};
+
+struct AnalyzerResult
+{
+    std::string name;
+    double value;
+    std::string unit;
+};
+
+// A measurement taken in the same pass over the file as the spectrogram, see
+// spek_pipeline_add_analyzer(). All the calls but get_results() come from one thread the
+// pipeline runs for the analyzer, the samples in order and the columns in order, but the two
+// aren't synchronised with each other.
+class Analyzer
+{
+public:
+    virtual ~Analyzer() {}
+
+    virtual std::string get_name() const = 0;
+    // Whether to pass on the columns of the first FFT size as well.
+    virtual bool wants_columns() const { return false; }
+    // Whether to get the samples of all the channels through process_channels() instead of
+    // those of the analysed one through process().
+    virtual bool wants_all_channels() const { return false; }
+
+    virtual void start(const AnalyzerFormat& format) { this->format = format; }
+    // The decoded samples of the analysed channel, in blocks of any size.
+    virtual void process(const float *samples, int n) = 0;
+    // `n` samples of each of the channels, interleaved.
+    virtual void process_channels(const float *samples, int n) { (void)samples; (void)n; }
+    // One averaged spectrum per column, `sample` is the column's index.
+    virtual void process_column(int sample, const float *values) { (void)sample; (void)values; }
+    // After the last samples and columns, not called if the analysis was stopped.
+    virtual void finish() {}
+
+    // Safe to call once the pipeline passed on the end of the analysis.
+    virtual std::vector<AnalyzerResult> get_results() const = 0;
+    // The results in a few words for the description of the file, if they belong there.
+    virtual std::string get_summary() const { return std::string(); }
+
+protected:
+    AnalyzerFormat format;
+};
+
+// The peak sample value of all the channels, in dBFS.
+class PeakAnalyzer : public Analyzer
+{
+public:
+    PeakAnalyzer() : peak(0.0f) {}
+
+    std::string get_name() const { return "peak"; }
+    bool wants_all_channels() const { return true; }
+    void process(const float *samples, int n);
+    void process_channels(const float *samples, int n);
+    std::vector<AnalyzerResult> get_results() const;
+
+private:
+    float peak;
+};
+
+// The root mean square level over the whole stream and all the channels, in dBFS, a full-scale
+// sine is at -3 dBFS.
+class RmsAnalyzer : public Analyzer
+{
+public:
+    RmsAnalyzer() : sum(0.0), count(0) {}
+
+    std::string get_name() const { return "rms"; }
+    bool wants_all_channels() const { return true; }
+    void process(const float *samples, int n);
+    void process_channels(const float *samples, int n);
+    std::vector<AnalyzerResult> get_results() const;
+
+private:
+    double sum;
+    int64_t count;
+};
+
+// The mean sample value of all the channels, as a percentage of full scale.
+class DcOffsetAnalyzer : public Analyzer
+{
+public:
+    DcOffsetAnalyzer() : sum(0.0), count(0) {}
+
+    std::string get_name() const { return "dc_offset"; }
+    bool wants_all_channels() const { return true; }
+    void process(const float *samples, int n);
+    void process_channels(const float *samples, int n);
+    std::vector<AnalyzerResult> get_results() const;
+
+private:
+    double sum;
+    int64_t count;
+};
+
+// Samples at full scale, and the runs of consecutive ones: a single full-scale sample may be
+// legitimate, a run of them is the flat top of a clipped waveform. Summed over the channels.
+class ClipAnalyzer : public Analyzer
+{
+public:
+    ClipAnalyzer() : samples(0), runs(0), run(1, 0) {}
+
+    std::string get_name() const { return "clipping"; }
+    bool wants_all_channels() const { return true; }
+    void process(const float *samples, int n);
+    void process_channels(const float *samples, int n);
+    std::vector<AnalyzerResult> get_results() const;
+
+private:
+    void process_sample(float sample, int channel);
+
+    int64_t samples;
+    int64_t runs; // Of at least MIN_CLIP_RUN samples.
+    std::vector<int> run; // The length of the current run of each channel.
+};
+
+// The built-in analyzers by name, NULL if there is none.
+std::unique_ptr<Analyzer> spek_analyzer_create(const std::string& name);
+std::vector<std::string> spek_analyzer_names();
+
+// Level in dBFS of a linear amplitude, -inf for silence.
+double spek_analyzer_db(double amplitude);
@@ -0,0 +1,426 @@
+#include <pthread.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include "spek-audio.h"
+#include "spek-fft.h"
+#include "spek-pipeline.h"
+#include "spek-utils.h"
+
+#include "spek-api.h"
+
+enum
+{
+    DEFAULT_FFT_BITS = 11,
+    MIN_FFT_BITS = 8,
+    MAX_FFT_BITS = 16,
+    DEFAULT_COLUMNS = 1024,
+};
+
+struct spek_analysis
+{
+    std::unique_ptr<AudioFile> file; // Until the pipeline takes it over.
+    spek_pipeline *pipeline;
+    spek_info info;
+    int channel;
+    enum window_function window_function;
+    int fft_bits;
+    int columns;
+    std::chrono::steady_clock::time_point start;
+    size_t memory;
+
+    // Shared with the worker, guarded by the mutex.
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool started;
+    float *buffer; // The caller's, while it waits for columns.
+    spek_levels *levels; // Also the caller's, may be NULL.
+    int buffer_columns; // Room in the buffer.
+    int buffer_filled;
+    int bands;
+    int columns_done;
+    int columns_read;
+    bool finished;
+    bool cancelled;
+};
+
+static std::atomic<int64_t> analyses_open(0);
+static std::atomic<int64_t> analyses_started(0);
+static std::atomic<int64_t> analyses_finished(0);
+static std::atomic<int64_t> analyses_failed(0);
+static std::atomic<int64_t> columns_total(0);
+
+// Forward declarations.
+static spek_analysis * analysis_open(std::unique_ptr<AudioFile> file, int *status);
+static void analysis_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data);
+static int status_of(AudioError error);
+
+int spek_api_version(void)
+{
+    return SPEK_API_VERSION;
+}
+
+const char * spek_status_string(int status)
+{
+    switch (status) {
+    case SPEK_OK:
+        return "Success";
+    case SPEK_ERROR_CANNOT_OPEN_FILE:
+        return "Cannot open input file";
+    case SPEK_ERROR_NO_STREAMS:
+        return "Cannot find stream info";
+    case SPEK_ERROR_NO_AUDIO:
+        return "The file contains no audio streams";
+    case SPEK_ERROR_NO_DECODER:
+        return "Cannot find decoder";
+    case SPEK_ERROR_NO_DURATION:
+        return "Unknown duration";
+    case SPEK_ERROR_NO_CHANNELS:
+        return "No audio channels";
+    case SPEK_ERROR_CANNOT_OPEN_DECODER:
+        return "Cannot open decoder";
+    case SPEK_ERROR_BAD_SAMPLE_FORMAT:
+        return "Unsupported sample format";
+    case SPEK_ERROR_INVALID_ARGUMENT:
+        return "Invalid argument";
+    case SPEK_ERROR_INVALID_STATE:
+        return "Invalid state";
+    case SPEK_ERROR_CANCELLED:
+        return "Cancelled";
+    case SPEK_ERROR_MIXED_FORMATS:
+        return "The tracks have different sample rates or channels";
+    default:
+        return "Unknown error";
+    }
+}
+
+spek_analysis * spek_open_file(const char *path, int stream, int *status)
+{
+    if (!path || stream < 0) {
+        if (status) {
+            *status = SPEK_ERROR_INVALID_ARGUMENT;
+        }
+        return NULL;
+    }
+    Audio audio;
+    return analysis_open(audio.open(path, stream), status);
+}
+
+spek_analysis * spek_open_memory(const void *data, size_t size, int stream, int *status)
+{
+    if (!data || !size || stream < 0) {
+        if (status) {
+            *status = SPEK_ERROR_INVALID_ARGUMENT;
+        }
+        return NULL;
+    }
+    Audio audio;
+    return analysis_open(audio.open_memory(data, size, stream), status);
+}
+
+void spek_close(spek_analysis *analysis)
+{
+    if (!analysis) {
+        return;
+    }
+    if (analysis->pipeline) {
+        // Let the worker out of the callback, the pipeline waits for it.
+        spek_cancel(analysis);
+        spek_pipeline_close(analysis->pipeline);
+    }
+    pthread_cond_destroy(&analysis->cond);
+    pthread_mutex_destroy(&analysis->mutex);
+    delete analysis;
+    analyses_open--;
+}
+
+int spek_get_info(const spek_analysis *analysis, struct spek_info *info)
+{
+    if (!analysis || !info) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    *info = analysis->info;
+    return SPEK_OK;
+}
+
+int spek_set_channel(spek_analysis *analysis, int channel)
+{
+    if (!analysis || channel < 0 || channel >= analysis->info.channels) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (analysis->pipeline) {
+        return SPEK_ERROR_INVALID_STATE;
+    }
+    analysis->channel = channel;
+    return SPEK_OK;
+}
+
+int spek_set_window(spek_analysis *analysis, enum spek_window window)
+{
+    if (!analysis) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (analysis->pipeline) {
+        return SPEK_ERROR_INVALID_STATE;
+    }
+    switch (window) {
+    case SPEK_WINDOW_HANN:
+        analysis->window_function = WINDOW_HANN;
+        break;
+    case SPEK_WINDOW_HAMMING:
+        analysis->window_function = WINDOW_HAMMING;
+        break;
+    case SPEK_WINDOW_BLACKMAN_HARRIS:
+        analysis->window_function = WINDOW_BLACKMAN_HARRIS;
+        break;
+    default:
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    return SPEK_OK;
+}
+
+int spek_set_fft_bits(spek_analysis *analysis, int bits)
+{
+    if (!analysis || bits < MIN_FFT_BITS || bits > MAX_FFT_BITS) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (analysis->pipeline) {
+        return SPEK_ERROR_INVALID_STATE;
+    }
+    analysis->fft_bits = bits;
+    return SPEK_OK;
+}
+
+int spek_set_columns(spek_analysis *analysis, int columns)
+{
+    if (!analysis || columns <= 0) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (analysis->pipeline) {
+        return SPEK_ERROR_INVALID_STATE;
+    }
+    analysis->columns = columns;
+    return SPEK_OK;
+}
+
+int spek_start(spek_analysis *analysis)
+{
+    if (!analysis) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (analysis->pipeline) {
+        return SPEK_ERROR_INVALID_STATE;
+    }
+    FFT fft;
+    analysis->bands = (1 << (analysis->fft_bits - 1)) + 1;
+    analysis->start = std::chrono::steady_clock::now();
+    analysis->pipeline = spek_pipeline_open(
+        std::move(analysis->file),
+        fft.create(analysis->fft_bits),
+        0,
+        analysis->channel,
+        analysis->window_function,
+        analysis->columns,
+        analysis_cb,
+        analysis
+    );
+    spek_pipeline_start(analysis->pipeline);
+    pthread_mutex_lock(&analysis->mutex);
+    // Only the caller's buffers grow after this point.
+    analysis->memory = sizeof(spek_analysis) + spek_pipeline_memory(analysis->pipeline);
+    analysis->started = true;
+    pthread_mutex_unlock(&analysis->mutex);
+    analyses_started++;
+    return SPEK_OK;
+}
+
+int spek_read_columns(spek_analysis *analysis, float *buffer, int max_columns)
+{
+    return spek_read_columns_levels(analysis, buffer, NULL, max_columns);
+}
+
+int spek_read_columns_levels(
+    spek_analysis *analysis, float *buffer, struct spek_levels *levels, int max_columns)
+{
+    if (!analysis || !buffer || max_columns <= 0) {
+        return -SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    if (!analysis->pipeline) {
+        return -SPEK_ERROR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock(&analysis->mutex);
+    analysis->buffer = buffer;
+    analysis->levels = levels;
+    analysis->buffer_columns = max_columns;
+    analysis->buffer_filled = 0;
+    pthread_cond_broadcast(&analysis->cond);
+    while (
+        analysis->buffer_filled < max_columns && !analysis->finished && !analysis->cancelled
+    ) {
+        pthread_cond_wait(&analysis->cond, &analysis->mutex);
+    }
+    int columns = analysis->buffer_filled;
+    analysis->buffer = NULL;
+    analysis->levels = NULL;
+    analysis->columns_read += columns;
+    bool cancelled = analysis->cancelled;
+    pthread_mutex_unlock(&analysis->mutex);
+
+    return cancelled ? -SPEK_ERROR_CANCELLED : columns;
+}
+
+void spek_cancel(spek_analysis *analysis)
+{
+    if (!analysis) {
+        return;
+    }
+    pthread_mutex_lock(&analysis->mutex);
+    analysis->cancelled = true;
+    pthread_cond_broadcast(&analysis->cond);
+    pthread_mutex_unlock(&analysis->mutex);
+}
+
+int spek_get_stats(const spek_analysis *analysis, struct spek_stats *stats)
+{
+    if (!analysis || !stats) {
+        return SPEK_ERROR_INVALID_ARGUMENT;
+    }
+    spek_analysis *a = const_cast<spek_analysis*>(analysis);
+    pthread_mutex_lock(&a->mutex);
+    stats->bands = (1 << (a->fft_bits - 1)) + 1;
+    stats->columns = a->columns;
+    stats->columns_done = a->columns_done;
+    stats->columns_read = a->columns_read;
+    stats->finished = a->finished;
+    stats->memory = a->started ? a->memory : sizeof(spek_analysis);
+    stats->seconds = 0.0;
+    if (a->started) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - a->start;
+        stats->seconds = elapsed.count();
+    }
+    pthread_mutex_unlock(&a->mutex);
+    return SPEK_OK;
+}
+
+void spek_get_global_stats(struct spek_global_stats *stats)
+{
+    if (!stats) {
+        return;
+    }
+    stats->analyses_open = analyses_open;
+    stats->analyses_started = analyses_started;
+    stats->analyses_finished = analyses_finished;
+    stats->analyses_failed = analyses_failed;
+    stats->columns = columns_total;
+}
+
+static spek_analysis * analysis_open(std::unique_ptr<AudioFile> file, int *status)
+{
+    int error = status_of(file->get_error());
+    if (status) {
+        *status = error;
+    }
+    if (error != SPEK_OK) {
+        analyses_failed++;
+        return NULL;
+    }
+
+    spek_analysis *a = new spek_analysis();
+    a->info.streams = file->get_streams();
+    a->info.channels = file->get_channels();
+    a->info.sample_rate = file->get_sample_rate();
+    a->info.bits_per_sample = file->get_bits_per_sample();
+    a->info.bit_rate = file->get_bit_rate();
+    a->info.duration = file->get_duration();
+    a->file = std::move(file);
+    a->pipeline = NULL;
+    a->channel = 0;
+    a->window_function = WINDOW_DEFAULT;
+    a->fft_bits = DEFAULT_FFT_BITS;
+    a->columns = DEFAULT_COLUMNS;
+    a->memory = 0;
+    pthread_mutex_init(&a->mutex, NULL);
+    pthread_cond_init(&a->cond, NULL);
+    a->started = false;
+    a->buffer = NULL;
+    a->levels = NULL;
+    a->buffer_columns = 0;
+    a->buffer_filled = 0;
+    a->bands = 0;
+    a->columns_done = 0;
+    a->columns_read = 0;
+    a->finished = false;
+    a->cancelled = false;
+    analyses_open++;
+    return a;
+}
+
+// Called on the worker thread, which waits for room in the caller's buffer so the columns go
+// straight there and the analysis doesn't get ahead of the caller.
+static void analysis_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data)
+{
+    spek_analysis *a = (spek_analysis *)cb_data;
+    pthread_mutex_lock(&a->mutex);
+    if (sample < 0) {
+        if (!a->cancelled) {
+            analyses_finished++;
+        }
+        a->finished = true;
+        pthread_cond_broadcast(&a->cond);
+        pthread_mutex_unlock(&a->mutex);
+        return;
+    }
+    while (!a->cancelled && (!a->buffer || a->buffer_filled == a->buffer_columns)) {
+        pthread_cond_wait(&a->cond, &a->mutex);
+    }
+    if (!a->cancelled) {
+        memcpy(
+            a->buffer + (size_t)a->buffer_filled * a->bands, values,
+            spek_min(bands, a->bands) * sizeof(float)
+        );
+        if (a->levels) {
+            spek_levels& levels = a->levels[a->buffer_filled];
+            levels.min = envelope ? envelope->min : 0.0f;
+            levels.max = envelope ? envelope->max : 0.0f;
+            levels.rms = envelope ? envelope->rms : 0.0f;
+        }
+        a->buffer_filled++;
+        a->columns_done++;
+        columns_total++;
+        pthread_cond_broadcast(&a->cond);
+    }
+    pthread_mutex_unlock(&a->mutex);
+}
+
+static int status_of(AudioError error)
+{
+    switch (error) {
+    case AudioError::OK:
+        return SPEK_OK;
+    case AudioError::CANNOT_OPEN_FILE:
+        return SPEK_ERROR_CANNOT_OPEN_FILE;
+    case AudioError::NO_STREAMS:
+        return SPEK_ERROR_NO_STREAMS;
+    case AudioError::NO_AUDIO:
+        return SPEK_ERROR_NO_AUDIO;
+    case AudioError::NO_DECODER:
+        return SPEK_ERROR_NO_DECODER;
+    case AudioError::NO_DURATION:
+        return SPEK_ERROR_NO_DURATION;
+    case AudioError::NO_CHANNELS:
+        return SPEK_ERROR_NO_CHANNELS;
+    case AudioError::CANNOT_OPEN_DECODER:
+        return SPEK_ERROR_CANNOT_OPEN_DECODER;
+    case AudioError::BAD_SAMPLE_FORMAT:
+        return SPEK_ERROR_BAD_SAMPLE_FORMAT;
+    case AudioError::MIXED_FORMATS:
+        return SPEK_ERROR_MIXED_FORMATS;
+    }
+    return SPEK_ERROR_CANNOT_OPEN_FILE;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+// The C interface of libspek, for embedding the analysis in other programs.
+//
+// An analysis reads one stream of a file, from a path or from memory, and computes a fixed
+// number of columns, each the averaged spectrum of its share of the file. The columns are
+// written straight into the caller's buffers as the FFTs produce them, and the analysis waits
+// for the caller to take them, so it holds on to little more than one column at a time.
+//
+// Any number of analyses can run at once, each has its own threads. The functions taking an
+// analysis may be called from any thread, but not from several at once for the same analysis,
+// except spek_get_stats(), spek_cancel() and the functions taking no analysis.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Raised for the changes that break the programs built against the previous version.
+#define SPEK_API_VERSION 1
+
+typedef struct spek_analysis spek_analysis;
+
+enum spek_status {
+    SPEK_OK = 0,
+    SPEK_ERROR_CANNOT_OPEN_FILE,
+    SPEK_ERROR_NO_STREAMS,
+    SPEK_ERROR_NO_AUDIO,
+    SPEK_ERROR_NO_DECODER,
+    SPEK_ERROR_NO_DURATION,
+    SPEK_ERROR_NO_CHANNELS,
+    SPEK_ERROR_CANNOT_OPEN_DECODER,
+    SPEK_ERROR_BAD_SAMPLE_FORMAT,
+    SPEK_ERROR_INVALID_ARGUMENT, // Out of range, or NULL where it can't be.
+    SPEK_ERROR_INVALID_STATE, // E.g. configuring an analysis that's already started.
+    SPEK_ERROR_CANCELLED,
+    SPEK_ERROR_MIXED_FORMATS, // The tracks of an album differ in sample rate or channels.
+};
+
+enum spek_window {
+    SPEK_WINDOW_HANN,
+    SPEK_WINDOW_HAMMING,
+    SPEK_WINDOW_BLACKMAN_HARRIS,
+};
+
+// The stream as the container and the decoder declare it.
+struct spek_info
+{
+    int streams; // Audio streams in the file.
+    int channels;
+    int sample_rate;
+    int bits_per_sample; // 0 for lossy formats.
+    int bit_rate; // In bits per second, 0 if unknown.
+    double duration; // In seconds.
+};
+
+// The progress and the resources of one analysis.
+struct spek_stats
+{
+    int bands; // Values per column.
+    int columns; // As configured.
+    int columns_done; // Computed so far.
+    int columns_read; // Taken by the caller so far.
+    int finished; // All the columns are computed.
+    size_t memory; // Bytes held by the analysis, not counting the caller's buffers.
+    double seconds; // Since the analysis was started.
+};
+
+// The decoded samples of one column, in full scale units: their lowest and highest values and
+// their root mean square level.
+struct spek_levels
+{
+    float min;
+    float max;
+    float rms;
+};
+
+// Totals over all the analyses of the process, for monitoring.
+struct spek_global_stats
+{
+    int64_t analyses_open;
+    int64_t analyses_started;
+    int64_t analyses_finished;
+    int64_t analyses_failed; // Couldn't be opened.
+    int64_t columns;
+};
+
+// SPEK_API_VERSION of the library, which may be newer than the header.
+int spek_api_version(void);
+// The message for a status, in English.
+const char * spek_status_string(int status);
+
+// Open the audio stream number `stream` of a file, counting from 0. A cue sheet or an M3U
+// playlist is analysed as one file made of its tracks. Returns NULL and sets `status` if given
+// when the file can't be analysed.
+spek_analysis * spek_open_file(const char *path, int stream, int *status);
+// Same as spek_open_file(), for the `size` bytes of a file at `data`. They are read in place
+// and must stay there until the analysis is closed.
+spek_analysis * spek_open_memory(const void *data, size_t size, int stream, int *status);
+// Stop the analysis if it's running and free it.
+void spek_close(spek_analysis *analysis);
+
+int spek_get_info(const spek_analysis *analysis, struct spek_info *info);
+
+// Configure the analysis, before spek_start(). The defaults are the first channel, the Hann
+// window, FFTs of 2^11 samples and 1024 columns.
+int spek_set_channel(spek_analysis *analysis, int channel);
+int spek_set_window(spek_analysis *analysis, enum spek_window window);
+// Each column has 2^(bits-1) + 1 bands, from 0 Hz to half the sample rate. `bits` is from 8 to
+// 16.
+int spek_set_fft_bits(spek_analysis *analysis, int bits);
+int spek_set_columns(spek_analysis *analysis, int columns);
+
+int spek_start(spek_analysis *analysis);
+// Wait for the next columns and write up to `max_columns` of them to `buffer`, the bands of
+// each in dBFS one after the other, from the lowest frequency. `buffer` has room for
+// `max_columns` times the bands of spek_get_stats(). Returns the number of columns written,
+// which follow those of the previous calls, 0 once they are all read, or minus a status.
+int spek_read_columns(spek_analysis *analysis, float *buffer, int max_columns);
+// Same as spek_read_columns(), also writing the levels of each column to `levels` if it isn't
+// NULL, with room for `max_columns` of them.
+int spek_read_columns_levels(
+    spek_analysis *analysis, float *buffer, struct spek_levels *levels, int max_columns);
+// Make spek_read_columns() return -SPEK_ERROR_CANCELLED as soon as possible, e.g. from another
+// thread. The analysis still has to be closed.
+void spek_cancel(spek_analysis *analysis);
+
+int spek_get_stats(const spek_analysis *analysis, struct spek_stats *stats);
+void spek_get_global_stats(struct spek_global_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,4 +1,21 @@
 #include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef OS_WIN
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <thread>
 
 extern "C" {
 #define __STDC_CONSTANT_MACROS
@@ -8,21 +25,115 @@ extern "C" {
 #include <libavutil/mathematics.h>
 }
 
+#include "spek-album.h"
+
 #include "spek-audio.h"
 
+enum
+{
+    INPUT_BUFFER_SIZE = 256 * 1024, // Size of the chunks handed over to the demuxer.
+    QUEUE_SIZE = 64 * 1024 * 1024, // Bytes of packets kept for a stream that isn't read.
+    BATCH_SIZE = 16 * 1024, // Default number of samples returned by read().
+    PROBE_SIZE = 64 * 1024, // Bytes the prober may read to find the stream parameters.
+    PROBE_DURATION = 500000, // Microseconds of input the prober may analyse.
+};
+
+// A local file read in large chunks and exposed to FFmpeg through a custom AVIOContext.
+// The default file protocol issues lots of small synchronous reads, which is slow on network
+// file systems; with large sequential reads the kernel reads ahead in the background.
+// Also wraps the files the client already holds in memory.
+struct AudioInput
+{
+    AVIOContext *io_context;
+    const uint8_t *data; // Of a file in memory, nullptr if read from `fd`.
+    int64_t size;
+    int64_t pos;
+    int fd; // Of the file, owned, -1 if in memory.
+};
+
+// Forward declarations.
+static AudioInput * input_open(const std::string& file_name);
+static AudioInput * input_create(const uint8_t *data, int64_t size, int fd);
+static void input_close(AudioInput *input);
+static int interrupt_callback(void *);
+static float convert_sample(AVSampleFormat format, const uint8_t *data, int offset);
+
+// Packets demuxed for one stream while reading another.
+struct AudioPacketQueue
+{
+    std::deque<AVPacket*> packets;
+    size_t size = 0; // Bytes of the packets.
+    bool dropped = false; // Fell behind by more than QUEUE_SIZE, no longer read.
+};
+
+// Owns the input and hands out its packets to one or more AudioFileImpl instances, so that
+// several audio streams can be decoded in a single pass over the file. Streams nobody reads
+// are discarded by the demuxer itself and never even parsed.
+class AudioDemuxer
+{
+public:
+    AudioDemuxer(AudioInput *input, AVFormatContext *format_context);
+    ~AudioDemuxer();
+
+    AVFormatContext *get_format_context() const { return this->format_context; }
+
+    // Packets are only kept for the streams added here, all others are discarded.
+    void add_stream(int index);
+    void remove_stream(int index);
+
+    // Returns the next packet of the stream `index`, or a negative error code at the end.
+    // A stream with more than QUEUE_SIZE of packets waiting is dropped, otherwise they would
+    // pile up without end if it's badly interleaved or not read at all. The reads of it fail
+    // with AVERROR(ENOMEM) from then on.
+    int read(int index, AVPacket *packet);
+    // Seeks the stream `index` to `timestamp`, only possible if it's the only one read.
+    bool seek(int index, int64_t timestamp);
+
+private:
+    AudioInput *input;
+    AVFormatContext *format_context;
+    pthread_mutex_t mutex;
+    // By stream index.
+    std::map<int, AudioPacketQueue> queues;
+
+    void clear_queue(AudioPacketQueue& queue);
+};
+
+// Forward declarations.
+static std::vector<std::unique_ptr<AudioFile>> open_input(
+    AudioInput *input, const std::string& file_name, int stream, bool all
+);
+static std::unique_ptr<AudioFile> open_stream(
+    std::shared_ptr<AudioDemuxer> demuxer, AudioError error, int stream,
+    const std::vector<int>& audio_streams
+);
+static AudioError read_info(
+    AVFormatContext *format_context, int audio_stream, const AVCodec **codec, AudioInfo& info
+);
+static std::unique_ptr<AudioFile> open_file(
+    const std::string& file_name, int stream, bool read_ahead
+);
+static AudioInfo info_of(const AudioFile& file);
+
 class AudioFileImpl : public AudioFile
 {
 public:
     AudioFileImpl(
-        AudioError error, AVFormatContext *format_context, AVCodecContext *codec_context,
-        int audio_stream, const std::string& codec_name, int bit_rate, int sample_rate,
-        int bits_per_sample, int streams, int channels, double duration
+        AudioError error, std::shared_ptr<AudioDemuxer> demuxer,
+        AVCodecContext *codec_context, int stream, int audio_stream,
+        const std::string& codec_name, int bit_rate, int sample_rate, int bits_per_sample,
+        int streams, int channels, double duration
     );
     ~AudioFileImpl() override;
     void start(int channel, int samples) override;
+    void set_batch_size(int samples) override;
     int read() override;
+    void interrupt() override;
+    bool rewind() override;
+    bool seek(double time) override;
 
     AudioError get_error() const override { return this->error; }
+    int get_stream() const override { return this->stream; }
     std::string get_codec_name() const override { return this->codec_name; }
     int get_bit_rate() const override { return this->bit_rate; }
     int get_sample_rate() const override { return this->sample_rate; }
@@ -31,14 +142,19 @@ public:
     int get_channels() const override { return this->channels; }
     double get_duration() const override { return this->duration; }
     const float *get_buffer() const override { return this->buffer; }
+    void set_all_channels(bool value) override { this->all_channels = value; }
+    const float *get_frames() const override { return this->frames; }
+    const SampleBits& get_sample_bits() const override { return this->sample_bits; }
     int64_t get_frames_per_interval() const override { return this->frames_per_interval; }
     int64_t get_error_per_interval() const override { return this->error_per_interval; }
     int64_t get_error_base() const override { return this->error_base; }
+    std::vector<double> get_track_starts() const override { return std::vector<double>(); }
 
 private:
     AudioError error;
-    AVFormatContext *format_context;
+    std::shared_ptr<AudioDemuxer> demuxer;
     AVCodecContext *codec_context;
+    int stream;
     int audio_stream;
     std::string codec_name;
     int bit_rate;
@@ -50,30 +166,250 @@ private:
 
     int channel;
 
-    AVPacket packet;
-    int offset;
+    bool convert_frame(int pos);
+    bool convert_channels(AVSampleFormat format, int pos);
+    void track_bits(AVSampleFormat format);
+
+    AVPacket *packet;
+    bool packet_pending; // Read from the demuxer but not accepted by the decoder yet.
+    bool flushing; // No more packets, draining the decoder.
+    std::atomic<bool> interrupted;
     AVFrame *frame;
+    int batch_size;
     int buffer_len;
     float *buffer;
+    bool all_channels;
+    int frames_len;
+    float *frames;
+    SampleBits sample_bits;
     // TODO: these guys don't belong here, move them somewhere else when revamping the pipeline
     int64_t frames_per_interval;
     int64_t error_per_interval;
     int64_t error_base;
 };
 
+// A run of an album that is read from a single file, see Audio::open_sequence().
+struct AudioPart
+{
+    std::string file_name;
+    double start; // Where it starts in the file, in seconds.
+    double duration;
+    bool to_end; // Read to the end of the file rather than for `duration`.
+    double offset; // Where it starts in the sequence.
+};
+
+// Reads the parts one after the other through an AudioFileImpl each, only one of them is open
+// at a time besides the next one, which is opened ahead on another thread.
+class AudioSequence : public AudioFile
+{
+public:
+    AudioSequence(
+        AudioError error, int stream, bool read_ahead, const std::vector<AudioPart>& parts,
+        const std::vector<double>& track_starts, double duration
+    );
+    ~AudioSequence() override;
+    void start(int channel, int samples) override;
+    void set_batch_size(int samples) override;
+    int read() override;
+    void interrupt() override;
+    bool rewind() override;
+    bool seek(double time) override;
+
+    AudioError get_error() const override { return this->error.load(); }
+    int get_stream() const override { return this->stream; }
+    std::string get_codec_name() const override { return this->info.codec_name; }
+    int get_bit_rate() const override { return this->info.bit_rate; }
+    int get_sample_rate() const override { return this->info.sample_rate; }
+    int get_bits_per_sample() const override { return this->info.bits_per_sample; }
+    int get_streams() const override { return this->info.streams; }
+    int get_channels() const override { return this->info.channels; }
+    double get_duration() const override { return this->info.duration; }
+    const float *get_buffer() const override;
+    void set_all_channels(bool value) override;
+    const float *get_frames() const override;
+    const SampleBits& get_sample_bits() const override;
+    int64_t get_frames_per_interval() const override { return this->frames_per_interval; }
+    int64_t get_error_per_interval() const override { return this->error_per_interval; }
+    int64_t get_error_base() const override { return this->error_base; }
+    std::vector<double> get_track_starts() const override { return this->track_starts; }
+
+private:
+    std::atomic<AudioError> error; // Also set by read() if a part after the first one fails.
+    int stream;
+    bool read_ahead;
+    std::vector<AudioPart> parts;
+    std::vector<double> track_starts;
+    AudioInfo info;
+
+    std::unique_ptr<AudioFile> open_part(int index, AudioError& error) const;
+    std::unique_ptr<AudioFile> take_part(int index, AudioError& error);
+    void use_part(int index, std::unique_ptr<AudioFile> file);
+    bool next_part();
+    void start_prefetch();
+    void join_prefetch();
+    static void * prefetch_func(void *pp);
+
+    int index; // Of the part being read.
+    std::unique_ptr<AudioFile> file; // Replaced under the mutex, for interrupt().
+    pthread_mutex_t mutex;
+    int64_t frames_left; // Of the current part, or -1 if it's read to the end of its file.
+    bool prefetch_wanted; // Open the next part ahead once the current one is being read.
+    bool prefetching;
+    pthread_t prefetch_thread;
+    int prefetch_index;
+    std::unique_ptr<AudioFile> prefetched;
+    AudioError prefetch_error;
+    std::atomic<bool> interrupted;
+    bool started;
+    int channel;
+    int samples;
+    int batch_size;
+    bool all_channels;
+    SampleBits done_bits; // Of the parts read before the current one.
+    mutable SampleBits sample_bits;
+    int64_t frames_per_interval;
+    int64_t error_per_interval;
+    int64_t error_base;
+};
+
 
-Audio::Audio()
+Audio::Audio() : read_ahead(true)
 {}
 
 Audio::~Audio()
 {}
 
 std::unique_ptr<AudioFile> Audio::open(const std::string& file_name, int stream)
+{
+    auto files = this->open_streams(file_name, stream, false);
+    return std::move(files[0]);
+}
+
+std::vector<std::unique_ptr<AudioFile>> Audio::open_streams(
+    const std::string& file_name, int stream, bool all
+)
+{
+    if (spek_is_album(file_name)) {
+        std::vector<std::unique_ptr<AudioFile>> files;
+        std::vector<AudioSource> tracks;
+        if (spek_read_album(file_name, tracks)) {
+            files.push_back(this->open_sequence(tracks, stream));
+        } else {
+            // Without an input FFmpeg fails on the empty name, with the same error as elsewhere.
+            files = open_input(nullptr, std::string(), stream, false);
+        }
+        return files;
+    }
+    AudioInput *input = this->read_ahead ? input_open(file_name) : nullptr;
+    return open_input(input, file_name, stream, all);
+}
+
+std::unique_ptr<AudioFile> Audio::open_sequence(
+    const std::vector<AudioSource>& sources, int stream
+)
+{
+    AudioError error = sources.empty() ? AudioError::CANNOT_OPEN_FILE : AudioError::OK;
+    std::vector<std::string> file_names;
+    std::map<std::string, int> file_indices;
+    for (const AudioSource& source : sources) {
+        if (spek_is_album(source.file_name)) {
+            // Lists of lists aren't followed, they could go round in circles.
+            error = AudioError::CANNOT_OPEN_FILE;
+        }
+        if (file_indices.insert(std::make_pair(source.file_name, file_names.size())).second) {
+            file_names.push_back(source.file_name);
+        }
+    }
+
+    // The durations of the files are needed up front to place the tracks.
+    std::vector<AudioInfo> infos;
+    if (!error) {
+        infos = this->probe(file_names, stream, std::thread::hardware_concurrency());
+    }
+    for (const AudioInfo& info : infos) {
+        if (!!info.error) {
+            error = info.error;
+            break;
+        }
+        if (info.sample_rate != infos[0].sample_rate || info.channels != infos[0].channels) {
+            error = AudioError::MIXED_FORMATS;
+        }
+    }
+
+    std::vector<AudioPart> parts;
+    std::vector<double> track_starts;
+    double duration = 0.0;
+    for (size_t i = 0; i < sources.size() && !error; i++) {
+        const AudioSource& source = sources[i];
+        double length = source.end > 0.0 ?
+            source.end - source.start :
+            infos[file_indices[source.file_name]].duration - source.start;
+        if (length < 0.0) {
+            length = 0.0;
+        }
+        if (i) {
+            track_starts.push_back(duration);
+        }
+        // The tracks of a cue sheet follow each other in the same file, read them in one go.
+        AudioPart *last = parts.empty() ? nullptr : &parts.back();
+        if (last && last->file_name == source.file_name && !last->to_end &&
+            fabs(last->start + last->duration - source.start) < 1e-6) {
+            last->duration += length;
+            last->to_end = source.end <= 0.0;
+        } else {
+            AudioPart part;
+            part.file_name = source.file_name;
+            part.start = source.start;
+            part.duration = length;
+            part.to_end = source.end <= 0.0;
+            part.offset = duration;
+            parts.push_back(part);
+        }
+        duration += length;
+    }
+
+    return std::unique_ptr<AudioFile>(new AudioSequence(
+        error, stream, this->read_ahead, parts, track_starts, duration
+    ));
+}
+
+std::unique_ptr<AudioFile> Audio::open_memory(const void *data, size_t size, int stream)
+{
+    AudioInput *input = data && size ?
+        input_create(static_cast<const uint8_t*>(data), size, -1) : nullptr;
+    // Without an input there is nothing to open, FFmpeg fails on the empty name.
+    auto files = open_input(input, std::string(), stream, false);
+    return std::move(files[0]);
+}
+
+static std::unique_ptr<AudioFile> open_file(
+    const std::string& file_name, int stream, bool read_ahead
+)
+{
+    AudioInput *input = read_ahead ? input_open(file_name) : nullptr;
+    auto files = open_input(input, file_name, stream, false);
+    return std::move(files[0]);
+}
+
+// Open the streams of the file, read through `input` if there is one. The demuxer takes over
+// the input.
+static std::vector<std::unique_ptr<AudioFile>> open_input(
+    AudioInput *input, const std::string& file_name, int stream, bool all
+)
 {
     AudioError error = AudioError::OK;
 
     AVFormatContext *format_context = nullptr;
-    if (avformat_open_input(&format_context, file_name.c_str(), nullptr, nullptr) != 0) {
+    if (input) {
+        format_context = avformat_alloc_context();
+        if (format_context) {
+            format_context->pb = input->io_context;
+        } else {
+            error = AudioError::CANNOT_OPEN_FILE;
+        }
+    }
+    if (!error &&
+        avformat_open_input(&format_context, file_name.c_str(), nullptr, nullptr) != 0) {
         error = AudioError::CANNOT_OPEN_FILE;
     }
 
@@ -85,77 +421,52 @@ std::unique_ptr<AudioFile> Audio::open(const std::string& file_name, int stream)
         }
     }
 
-    int audio_stream = -1;
-    int streams = 0;
+    // Indices of the audio streams among all streams of the file.
+    std::vector<int> audio_streams;
     if (!error) {
         for (unsigned int i = 0; i < format_context->nb_streams; i++) {
             if (format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-                if (stream == streams) {
-                    audio_stream = i;
-                }
-                streams++;
+                audio_streams.push_back(i);
             }
         }
-        if (audio_stream == -1) {
-            error = AudioError::NO_AUDIO;
-        }
     }
 
-    AVStream *avstream = nullptr;
-    AVCodecParameters *codecpar = nullptr;
-    const AVCodec *codec = nullptr;
-    if (!error) {
-        avstream = format_context->streams[audio_stream];
-        codecpar = avstream->codecpar;
-        codec = avcodec_find_decoder(codecpar->codec_id);
-        if (!codec) {
-            error = AudioError::NO_DECODER;
+    auto demuxer = std::make_shared<AudioDemuxer>(input, format_context);
+    std::vector<std::unique_ptr<AudioFile>> files;
+    files.push_back(open_stream(demuxer, error, stream, audio_streams));
+    if (all) {
+        for (int i = 0; i < static_cast<int>(audio_streams.size()); i++) {
+            if (i != stream) {
+                files.push_back(open_stream(demuxer, error, i, audio_streams));
+            }
         }
     }
+    return files;
+}
 
-    std::string codec_name;
-    int bit_rate = 0;
-    int sample_rate = 0;
-    int bits_per_sample = 0;
-    int channels = 0;
-    double duration = 0;
+static std::unique_ptr<AudioFile> open_stream(
+    std::shared_ptr<AudioDemuxer> demuxer, AudioError error, int stream,
+    const std::vector<int>& audio_streams
+)
+{
+    int streams = audio_streams.size();
+    int audio_stream = -1;
     if (!error) {
-        // We can already fill in the stream info even if the codec won't be able to open it.
-        if (codec->long_name) {
-            codec_name = codec->long_name;
-        } else if (codec->name) {
-            codec_name = codec->name;
-        }
-        bit_rate = codecpar->bit_rate;
-        sample_rate = codecpar->sample_rate;
-        bits_per_sample = codecpar->bits_per_raw_sample;
-        if (!bits_per_sample) {
-            // APE uses bpcs, FLAC uses bprs.
-            bits_per_sample = codecpar->bits_per_coded_sample;
-        }
-        if (codecpar->codec_id == AV_CODEC_ID_AAC ||
-            codecpar->codec_id == AV_CODEC_ID_MUSEPACK8 ||
-            codecpar->codec_id == AV_CODEC_ID_WMAV1 ||
-            codecpar->codec_id == AV_CODEC_ID_WMAV2) {
-            // These decoders set both bps and bitrate.
-            bits_per_sample = 0;
-        }
-        if (bits_per_sample) {
-            bit_rate = 0;
-        }
-        channels = codecpar->channels;
-
-        if (avstream->duration != AV_NOPTS_VALUE) {
-            duration = avstream->duration * av_q2d(avstream->time_base);
-        } else if (format_context->duration != AV_NOPTS_VALUE) {
-            duration = format_context->duration / (double) AV_TIME_BASE;
+        if (stream >= 0 && stream < streams) {
+            audio_stream = audio_streams[stream];
         } else {
-            error = AudioError::NO_DURATION;
+            error = AudioError::NO_AUDIO;
         }
+    }
 
-        if (!error && channels <= 0) {
-            error = AudioError::NO_CHANNELS;
-        }
+    AudioInfo info;
+    info.streams = streams;
+    const AVCodec *codec = nullptr;
+    AVCodecParameters *codecpar = nullptr;
+    if (!error) {
+        AVFormatContext *format_context = demuxer->get_format_context();
+        error = read_info(format_context, audio_stream, &codec, info);
+        codecpar = format_context->streams[audio_stream]->codecpar;
     }
 
     AVCodecContext *codec_context = nullptr;
@@ -184,30 +495,452 @@ std::unique_ptr<AudioFile> Audio::open(const std::string& file_name, int stream)
         }
     }
 
+    if (!error) {
+        demuxer->add_stream(audio_stream);
+    }
+
     return std::unique_ptr<AudioFile>(new AudioFileImpl(
-        error, format_context, codec_context,
-        audio_stream, codec_name, bit_rate, sample_rate,
-        bits_per_sample, streams, channels, duration
+        error, demuxer, codec_context,
+        stream, audio_stream, info.codec_name, info.bit_rate, info.sample_rate,
+        info.bits_per_sample, streams, info.channels, info.duration
     ));
 }
 
+// Fill in the stream info from the codec parameters, which doesn't require opening the decoder.
+static AudioError read_info(
+    AVFormatContext *format_context, int audio_stream, const AVCodec **codec, AudioInfo& info
+)
+{
+    AVStream *avstream = format_context->streams[audio_stream];
+    AVCodecParameters *codecpar = avstream->codecpar;
+    *codec = avcodec_find_decoder(codecpar->codec_id);
+    if (!*codec) {
+        return AudioError::NO_DECODER;
+    }
+
+    // We can already fill in the stream info even if the codec won't be able to open it.
+    if ((*codec)->long_name) {
+        info.codec_name = (*codec)->long_name;
+    } else if ((*codec)->name) {
+        info.codec_name = (*codec)->name;
+    }
+    info.bit_rate = codecpar->bit_rate;
+    info.sample_rate = codecpar->sample_rate;
+    info.bits_per_sample = codecpar->bits_per_raw_sample;
+    if (!info.bits_per_sample) {
+        // APE uses bpcs, FLAC uses bprs.
+        info.bits_per_sample = codecpar->bits_per_coded_sample;
+    }
+    if (codecpar->codec_id == AV_CODEC_ID_AAC ||
+        codecpar->codec_id == AV_CODEC_ID_MUSEPACK8 ||
+        codecpar->codec_id == AV_CODEC_ID_WMAV1 ||
+        codecpar->codec_id == AV_CODEC_ID_WMAV2) {
+        // These decoders set both bps and bitrate.
+        info.bits_per_sample = 0;
+    }
+    if (info.bits_per_sample) {
+        info.bit_rate = 0;
+    }
+    info.channels = codecpar->channels;
+
+    if (avstream->duration != AV_NOPTS_VALUE) {
+        info.duration = avstream->duration * av_q2d(avstream->time_base);
+    } else if (format_context->duration != AV_NOPTS_VALUE) {
+        info.duration = format_context->duration / (double) AV_TIME_BASE;
+    } else {
+        return AudioError::NO_DURATION;
+    }
+
+    if (info.channels <= 0) {
+        return AudioError::NO_CHANNELS;
+    }
+    return AudioError::OK;
+}
+
+AudioInfo Audio::probe(const std::string& file_name, int stream)
+{
+    if (spek_is_album(file_name)) {
+        // The tracks are probed when the sequence is opened.
+        return info_of(*this->open(file_name, stream));
+    }
+
+    AudioInfo info;
+
+    // Only look at the container headers, with a bounded amount of data to probe.
+    AVFormatContext *format_context = nullptr;
+    AVDictionary *options = nullptr;
+    av_dict_set_int(&options, "probesize", PROBE_SIZE, 0);
+    av_dict_set_int(&options, "analyzeduration", PROBE_DURATION, 0);
+    if (avformat_open_input(&format_context, file_name.c_str(), nullptr, &options) != 0) {
+        info.error = AudioError::CANNOT_OPEN_FILE;
+    }
+    av_dict_free(&options);
+
+    // Some demuxers (raw MP3, ADTS, MPEG-TS) only know the parameters after parsing a few packets.
+    bool complete = false;
+    for (int pass = 0; !info.error && !complete && pass < 2; pass++) {
+        if (pass) {
+            avformat_find_stream_info(format_context, nullptr);
+        }
+        std::vector<int> audio_streams;
+        for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+            if (format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+                audio_streams.push_back(i);
+            }
+        }
+        info.streams = audio_streams.size();
+        if (stream < 0 || stream >= info.streams) {
+            if (pass) {
+                info.error = AudioError::NO_AUDIO;
+            }
+            continue;
+        }
+        const AVCodec *codec;
+        AudioError error = read_info(format_context, audio_streams[stream], &codec, info);
+        if (error == AudioError::NO_DECODER) {
+            info.error = error;
+        }
+        complete = !error && info.sample_rate > 0;
+    }
+
+    if (format_context) {
+        avformat_close_input(&format_context);
+    }
+
+    if (!info.error && !complete) {
+        // Last resort, let the decoder fill in the blanks.
+        info = info_of(*this->open(file_name, stream));
+    }
+
+    return info;
+}
+
+static AudioInfo info_of(const AudioFile& file)
+{
+    AudioInfo info;
+    info.error = file.get_error();
+    info.codec_name = file.get_codec_name();
+    info.bit_rate = file.get_bit_rate();
+    info.sample_rate = file.get_sample_rate();
+    info.bits_per_sample = file.get_bits_per_sample();
+    info.streams = file.get_streams();
+    info.channels = file.get_channels();
+    info.duration = file.get_duration();
+    return info;
+}
+
+struct probe_job
+{
+    Audio *audio;
+    const std::vector<std::string> *file_names;
+    int stream;
+    std::vector<AudioInfo> *infos;
+    std::atomic<size_t> next;
+};
+
+static void * probe_func(void *pp)
+{
+    probe_job *job = static_cast<probe_job*>(pp);
+    size_t i;
+    while ((i = job->next++) < job->file_names->size()) {
+        (*job->infos)[i] = job->audio->probe((*job->file_names)[i], job->stream);
+    }
+    return nullptr;
+}
+
+std::vector<AudioInfo> Audio::probe(
+    const std::vector<std::string>& file_names, int stream, int threads
+)
+{
+    std::vector<AudioInfo> infos(file_names.size());
+    probe_job job;
+    job.audio = this;
+    job.file_names = &file_names;
+    job.stream = stream;
+    job.infos = &infos;
+    job.next = 0;
+
+    std::vector<pthread_t> workers;
+    for (int i = 1; i < threads && (size_t)i < file_names.size(); i++) {
+        pthread_t thread;
+        if (!pthread_create(&thread, nullptr, &probe_func, &job)) {
+            workers.push_back(thread);
+        }
+    }
+    // The calling thread does its share too.
+    probe_func(&job);
+    for (pthread_t thread : workers) {
+        pthread_join(thread, nullptr);
+    }
+    return infos;
+}
+
+AudioDemuxer::AudioDemuxer(AudioInput *input, AVFormatContext *format_context) :
+    input(input), format_context(format_context)
+{
+    pthread_mutex_init(&this->mutex, nullptr);
+    if (this->format_context) {
+        // Lets AudioFile::interrupt() break out of blocking reads.
+        this->format_context->interrupt_callback.callback = interrupt_callback;
+        this->format_context->interrupt_callback.opaque = nullptr;
+        for (unsigned int i = 0; i < this->format_context->nb_streams; i++) {
+            this->format_context->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+}
+
+AudioDemuxer::~AudioDemuxer()
+{
+    for (auto& item : this->queues) {
+        this->clear_queue(item.second);
+    }
+    if (this->format_context) {
+        avformat_close_input(&this->format_context);
+    }
+    if (this->input) {
+        // Custom I/O is not freed by avformat_close_input().
+        input_close(this->input);
+    }
+    pthread_mutex_destroy(&this->mutex);
+}
+
+void AudioDemuxer::add_stream(int index)
+{
+    pthread_mutex_lock(&this->mutex);
+    this->format_context->streams[index]->discard = AVDISCARD_DEFAULT;
+    this->queues[index];
+    pthread_mutex_unlock(&this->mutex);
+}
+
+void AudioDemuxer::remove_stream(int index)
+{
+    pthread_mutex_lock(&this->mutex);
+    auto it = this->queues.find(index);
+    if (it != this->queues.end()) {
+        this->clear_queue(it->second);
+        this->queues.erase(it);
+        this->format_context->streams[index]->discard = AVDISCARD_ALL;
+    }
+    pthread_mutex_unlock(&this->mutex);
+}
+
+int AudioDemuxer::read(int index, AVPacket *packet)
+{
+    pthread_mutex_lock(&this->mutex);
+    AudioPacketQueue& queue = this->queues[index];
+    if (queue.dropped) {
+        pthread_mutex_unlock(&this->mutex);
+        return AVERROR(ENOMEM);
+    }
+    if (!queue.packets.empty()) {
+        AVPacket *queued = queue.packets.front();
+        queue.packets.pop_front();
+        queue.size -= queued->size;
+        av_packet_move_ref(packet, queued);
+        av_packet_free(&queued);
+        pthread_mutex_unlock(&this->mutex);
+        return 0;
+    }
+
+    int res;
+    while ((res = av_read_frame(this->format_context, packet)) >= 0) {
+        if (packet->stream_index == index) {
+            break;
+        }
+        auto it = this->queues.find(packet->stream_index);
+        AVPacket *queued = nullptr;
+        if (it != this->queues.end() && !it->second.dropped) {
+            queued = av_packet_alloc();
+        }
+        if (queued) {
+            av_packet_move_ref(queued, packet);
+            it->second.packets.push_back(queued);
+            it->second.size += queued->size;
+            if (it->second.size > QUEUE_SIZE) {
+                this->clear_queue(it->second);
+                it->second.dropped = true;
+                this->format_context->streams[packet->stream_index]->discard = AVDISCARD_ALL;
+            }
+        } else {
+            av_packet_unref(packet);
+        }
+    }
+    pthread_mutex_unlock(&this->mutex);
+    return res;
+}
+
+bool AudioDemuxer::seek(int index, int64_t timestamp)
+{
+    pthread_mutex_lock(&this->mutex);
+    bool result = false;
+    if (this->queues.size() == 1 && this->queues.count(index)) {
+        this->clear_queue(this->queues[index]);
+        result = av_seek_frame(this->format_context, index, timestamp, AVSEEK_FLAG_BACKWARD) >= 0;
+    }
+    pthread_mutex_unlock(&this->mutex);
+    return result;
+}
+
+void AudioDemuxer::clear_queue(AudioPacketQueue& queue)
+{
+    for (AVPacket *packet : queue.packets) {
+        av_packet_free(&packet);
+    }
+    queue.packets.clear();
+    queue.size = 0;
+}
+
+// The interrupt flag of the file being read by the current thread, if any.
+static thread_local const std::atomic<bool> *current_interrupted = nullptr;
+
+static int interrupt_callback(void *)
+{
+    return current_interrupted && current_interrupted->load(std::memory_order_relaxed);
+}
+
+static int input_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    AudioInput *input = static_cast<AudioInput*>(opaque);
+    int64_t len = input->size - input->pos;
+    if (len <= 0) {
+        return AVERROR_EOF;
+    }
+    if (len > buf_size) {
+        len = buf_size;
+    }
+#ifndef OS_WIN
+    if (input->fd >= 0) {
+        // A file truncated in the meantime, e.g. being rewritten by another program, just ends
+        // early.
+        ssize_t n;
+        do {
+            n = pread(input->fd, buf, len, input->pos);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            return AVERROR(errno);
+        }
+        if (n == 0) {
+            return AVERROR_EOF;
+        }
+        input->pos += n;
+        return n;
+    }
+#endif
+    memcpy(buf, input->data + input->pos, len);
+    input->pos += len;
+    return len;
+}
+
+static int64_t input_seek(void *opaque, int64_t offset, int whence)
+{
+    AudioInput *input = static_cast<AudioInput*>(opaque);
+    if (whence & AVSEEK_SIZE) {
+        return input->size;
+    }
+    int64_t pos;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = input->pos + offset;
+        break;
+    case SEEK_END:
+        pos = input->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0 || pos > input->size) {
+        return AVERROR(EINVAL);
+    }
+    input->pos = pos;
+    return pos;
+}
+
+// Returns nullptr if the file can't be read this way, the caller should fall back to the default
+// I/O.
+static AudioInput * input_open(const std::string& file_name)
+{
+#ifdef OS_WIN
+    (void)file_name;
+    return nullptr;
+#else
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Let the kernel read further ahead, decoding follows the file sequentially.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return input_create(nullptr, st.st_size, fd);
+#endif
+}
+
+// Reads the file `fd` and takes it over if it isn't -1, otherwise the `size` bytes at `data`,
+// which have to outlive the input.
+static AudioInput * input_create(const uint8_t *data, int64_t size, int fd)
+{
+    AudioInput *input = new AudioInput();
+    input->data = data;
+    input->size = size;
+    input->pos = 0;
+    input->fd = fd;
+    uint8_t *buffer = static_cast<uint8_t*>(av_malloc(INPUT_BUFFER_SIZE));
+    input->io_context = buffer ? avio_alloc_context(
+        buffer, INPUT_BUFFER_SIZE, 0, input, input_read, nullptr, input_seek
+    ) : nullptr;
+    if (!input->io_context) {
+        av_free(buffer);
+        input_close(input);
+        return nullptr;
+    }
+    return input;
+}
+
+static void input_close(AudioInput *input)
+{
+    if (input->io_context) {
+        av_freep(&input->io_context->buffer);
+        avio_context_free(&input->io_context);
+    }
+#ifndef OS_WIN
+    if (input->fd >= 0) {
+        close(input->fd);
+    }
+#endif
+    delete input;
+}
+
 AudioFileImpl::AudioFileImpl(
-    AudioError error, AVFormatContext *format_context, AVCodecContext *codec_context,
-    int audio_stream, const std::string& codec_name, int bit_rate, int sample_rate,
-    int bits_per_sample, int streams, int channels, double duration
+    AudioError error, std::shared_ptr<AudioDemuxer> demuxer,
+    AVCodecContext *codec_context, int stream, int audio_stream,
+    const std::string& codec_name, int bit_rate, int sample_rate, int bits_per_sample,
+    int streams, int channels, double duration
 ) :
-    error(error), format_context(format_context), codec_context(codec_context),
-    audio_stream(audio_stream), codec_name(codec_name), bit_rate(bit_rate),
+    error(error), demuxer(demuxer), codec_context(codec_context),
+    stream(stream), audio_stream(audio_stream), codec_name(codec_name), bit_rate(bit_rate),
     sample_rate(sample_rate),
     bits_per_sample(bits_per_sample), streams(streams), channels(channels), duration(duration)
 {
-    av_init_packet(&this->packet);
-    this->packet.data = nullptr;
-    this->packet.size = 0;
-    this->offset = 0;
+    this->packet = av_packet_alloc();
+    this->packet_pending = false;
+    this->flushing = false;
+    this->interrupted = false;
     this->frame = av_frame_alloc();
+    this->batch_size = BATCH_SIZE;
     this->buffer_len = 0;
     this->buffer = nullptr;
+    this->all_channels = false;
+    this->frames_len = 0;
+    this->frames = nullptr;
     this->frames_per_interval = 0;
     this->error_per_interval = 0;
     this->error_base = 0;
@@ -218,20 +951,20 @@ AudioFileImpl::~AudioFileImpl()
     if (this->buffer) {
         av_freep(&this->buffer);
     }
+    if (this->frames) {
+        av_freep(&this->frames);
+    }
     if (this->frame) {
         av_frame_free(&this->frame);
     }
-    if (this->packet.data) {
-        this->packet.data -= this->offset;
-        this->packet.size += this->offset;
-        this->offset = 0;
-        av_packet_unref(&this->packet);
+    if (this->packet) {
+        av_packet_free(&this->packet);
     }
     if (this->codec_context) {
         avcodec_free_context(&codec_context);
     }
-    if (this->format_context) {
-        avformat_close_input(&this->format_context);
+    if (this->audio_stream >= 0) {
+        this->demuxer->remove_stream(this->audio_stream);
     }
 }
 
@@ -242,8 +975,12 @@ void AudioFileImpl::start(int channel, int samples)
         assert(false);
         this->error = AudioError::NO_CHANNELS;
     }
+    // Set up by the first frame, the sample format isn't known before.
+    this->sample_bits = SampleBits();
+    // Not in seek(), the preview seeks on the reader thread while it may be interrupted.
+    this->interrupted = false;
 
-    AVStream *stream = this->format_context->streams[this->audio_stream];
+    AVStream *stream = this->demuxer->get_format_context()->streams[this->audio_stream];
     int64_t rate = this->sample_rate * (int64_t)stream->time_base.num;
     int64_t duration = (int64_t)(this->duration * stream->time_base.den / stream->time_base.num);
     this->error_base = samples * (int64_t)stream->time_base.den;
@@ -251,95 +988,519 @@ void AudioFileImpl::start(int channel, int samples)
     this->error_per_interval = (duration * rate) % this->error_base;
 }
 
+void AudioFileImpl::set_batch_size(int samples)
+{
+    this->batch_size = samples > 0 ? samples : 1;
+}
+
+// Decodes frames until the buffer holds at least `batch_size` samples, so the
+// caller's per-call overhead doesn't scale with the number of (often tiny) frames.
 int AudioFileImpl::read()
 {
     if (!!this->error) {
         return -1;
     }
 
-    for (;;) {
-        while (this->packet.size > 0) {
+    current_interrupted = &this->interrupted;
+    int len = 0;
+    while (len < this->batch_size) {
+        if (this->interrupted.load(std::memory_order_relaxed)) {
+            len = 0;
+            break;
+        }
+        int ret = avcodec_receive_frame(this->codec_context, this->frame);
+        if (ret == 0) {
+            bool converted = this->convert_frame(len);
+            len += this->frame->nb_samples;
             av_frame_unref(this->frame);
-            int len = 0;
-            int ret = avcodec_send_packet(this->codec_context,&this->packet);
-            if (ret < 0) {
+            if (!converted) {
+                // Out of memory, there is nowhere to put the samples.
+                len = -1;
                 break;
             }
-            ret = avcodec_receive_frame(this->codec_context,this->frame);
-            if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            continue;
+        }
+        if (ret == AVERROR_EOF || this->flushing) {
+            // The decoder is fully drained.
+            break;
+        }
+        // The decoder needs more input; a broken packet is skipped the same way.
+
+        if (!this->packet_pending) {
+            int res = this->demuxer->read(this->audio_stream, this->packet);
+            if (res == AVERROR(ENOMEM)) {
+                // Dropped by the demuxer, the rest of the stream is gone.
+                len = -1;
                 break;
             }
-            else {
-                len = this->packet.size;
-            }
-            this->packet.data += len;
-            this->packet.size -= len;
-            this->offset += len;
-            int samples = this->frame->nb_samples;
-            if (samples > this->buffer_len) {
-                this->buffer = static_cast<float*>(
-                    av_realloc(this->buffer, samples * sizeof(float))
-                );
-                this->buffer_len = samples;
-            }
-
-            AVSampleFormat format = static_cast<AVSampleFormat>(this->frame->format);
-            int is_planar = av_sample_fmt_is_planar(format);
-            for (int sample = 0; sample < samples; ++sample) {
-                uint8_t *data;
-                int offset;
-                if (is_planar) {
-                    data = this->frame->data[this->channel];
-                    offset = sample;
-                } else {
-                    data = this->frame->data[0];
-                    offset = sample * this->channels;
-                }
-                float value;
-                switch (format) {
-                case AV_SAMPLE_FMT_S16:
-                case AV_SAMPLE_FMT_S16P:
-                    value = reinterpret_cast<int16_t*>(data)[offset]
-                        / static_cast<float>(INT16_MAX);
-                    break;
-                case AV_SAMPLE_FMT_S32:
-                case AV_SAMPLE_FMT_S32P:
-                    value = reinterpret_cast<int32_t*>(data)[offset]
-                        / static_cast<float>(INT32_MAX);
-                    break;
-                case AV_SAMPLE_FMT_FLT:
-                case AV_SAMPLE_FMT_FLTP:
-                    value = reinterpret_cast<float*>(data)[offset];
-                    break;
-                case AV_SAMPLE_FMT_DBL:
-                case AV_SAMPLE_FMT_DBLP:
-                    value = reinterpret_cast<double*>(data)[offset];
-                    break;
-                default:
-                    value = 0.0f;
-                    break;
+            if (res < 0) {
+                if (this->interrupted.load(std::memory_order_relaxed)) {
+                    continue;
                 }
-                this->buffer[sample] = value;
+                // End of file or error, collect the frames still buffered in the decoder.
+                avcodec_send_packet(this->codec_context, nullptr);
+                this->flushing = true;
+                continue;
             }
-            return samples;
+            this->packet_pending = true;
         }
-        if (this->packet.data) {
-            this->packet.data -= this->offset;
-            this->packet.size += this->offset;
-            this->offset = 0;
-            av_packet_unref(&this->packet);
+        ret = avcodec_send_packet(this->codec_context, this->packet);
+        if (ret == AVERROR(EAGAIN)) {
+            // Receive the pending frames first, then send the packet again.
+            continue;
         }
+        av_packet_unref(this->packet);
+        this->packet_pending = false;
+    }
+    current_interrupted = nullptr;
+    return len;
+}
 
-        int res = 0;
-        while ((res = av_read_frame(this->format_context, &this->packet)) >= 0) {
-            if (this->packet.stream_index == this->audio_stream) {
-                break;
+void AudioFileImpl::interrupt()
+{
+    this->interrupted.store(true, std::memory_order_relaxed);
+}
+
+bool AudioFileImpl::rewind()
+{
+    return this->seek(0.0);
+}
+
+bool AudioFileImpl::seek(double time)
+{
+    if (!!this->error) {
+        return false;
+    }
+    AVStream *stream = this->demuxer->get_format_context()->streams[this->audio_stream];
+    int64_t timestamp = (int64_t)(time * stream->time_base.den / stream->time_base.num);
+    if (stream->start_time != AV_NOPTS_VALUE) {
+        timestamp += stream->start_time;
+    }
+    if (!this->demuxer->seek(this->audio_stream, timestamp)) {
+        return false;
+    }
+    avcodec_flush_buffers(this->codec_context);
+    av_packet_unref(this->packet);
+    this->packet_pending = false;
+    this->flushing = false;
+    return true;
+}
+
+// Append the current frame's samples for the selected channel to the buffer at `pos`.
+// Returns false if the buffer can't grow.
+bool AudioFileImpl::convert_frame(int pos)
+{
+    int samples = this->frame->nb_samples;
+    if (pos + samples > this->buffer_len) {
+        float *buffer = static_cast<float*>(
+            av_realloc(this->buffer, (pos + samples) * sizeof(float))
+        );
+        if (!buffer) {
+            return false;
+        }
+        this->buffer = buffer;
+        this->buffer_len = pos + samples;
+    }
+
+    AVSampleFormat format = static_cast<AVSampleFormat>(this->frame->format);
+    int is_planar = av_sample_fmt_is_planar(format);
+    float *buffer = this->buffer + pos;
+    for (int sample = 0; sample < samples; ++sample) {
+        uint8_t *data;
+        int offset;
+        if (is_planar) {
+            data = this->frame->data[this->channel];
+            offset = sample;
+        } else {
+            data = this->frame->data[0];
+            offset = sample * this->channels;
+        }
+        buffer[sample] = convert_sample(format, data, offset);
+    }
+
+    if (this->all_channels && !this->convert_channels(format, pos)) {
+        return false;
+    }
+    this->track_bits(format);
+    return true;
+}
+
+// Append the current frame's samples for all the channels to the frames at `pos`, interleaved.
+// Returns false if the frames can't grow.
+bool AudioFileImpl::convert_channels(AVSampleFormat format, int pos)
+{
+    int samples = this->frame->nb_samples;
+    if (pos + samples > this->frames_len) {
+        float *frames = static_cast<float*>(
+            av_realloc(this->frames, (pos + samples) * (size_t)this->channels * sizeof(float))
+        );
+        if (!frames) {
+            return false;
+        }
+        this->frames = frames;
+        this->frames_len = pos + samples;
+    }
+
+    uint8_t **data = this->frame->extended_data;
+    float *frames = this->frames + pos * (size_t)this->channels;
+    if (av_sample_fmt_is_planar(format)) {
+        for (int channel = 0; channel < this->channels; channel++) {
+            for (int sample = 0; sample < samples; sample++) {
+                frames[sample * this->channels + channel] =
+                    convert_sample(format, data[channel], sample);
             }
-            av_packet_unref(&this->packet);
         }
-        if (res < 0) {
-            // End of file or error.
+    } else {
+        for (int i = 0; i < samples * this->channels; i++) {
+            frames[i] = convert_sample(format, data[0], i);
+        }
+    }
+    return true;
+}
+
+static float convert_sample(AVSampleFormat format, const uint8_t *data, int offset)
+{
+    switch (format) {
+    case AV_SAMPLE_FMT_S16:
+    case AV_SAMPLE_FMT_S16P:
+        return reinterpret_cast<const int16_t*>(data)[offset] / static_cast<float>(INT16_MAX);
+    case AV_SAMPLE_FMT_S32:
+    case AV_SAMPLE_FMT_S32P:
+        return reinterpret_cast<const int32_t*>(data)[offset] / static_cast<float>(INT32_MAX);
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_FLTP:
+        return reinterpret_cast<const float*>(data)[offset];
+    case AV_SAMPLE_FMT_DBL:
+    case AV_SAMPLE_FMT_DBLP:
+        return reinterpret_cast<const double*>(data)[offset];
+    default:
+        return 0.0f;
+    }
+}
+
+// Take in the raw integer samples of all the channels before they are converted.
+void AudioFileImpl::track_bits(AVSampleFormat format)
+{
+    int bits;
+    switch (format) {
+    case AV_SAMPLE_FMT_S16:
+    case AV_SAMPLE_FMT_S16P:
+        bits = 16;
+        break;
+    case AV_SAMPLE_FMT_S32:
+    case AV_SAMPLE_FMT_S32P:
+        bits = 32;
+        break;
+    default:
+        return;
+    }
+    if (this->sample_bits.get_bits() != bits) {
+        this->sample_bits.reset(this->channels, bits);
+    }
+
+    int samples = this->frame->nb_samples;
+    uint8_t **data = this->frame->extended_data;
+    int planes = av_sample_fmt_is_planar(format) ? this->channels : 1;
+    int channels = planes == 1 ? this->channels : 1;
+    for (int plane = 0; plane < planes; plane++) {
+        if (bits == 16) {
+            this->sample_bits.add(
+                reinterpret_cast<int16_t*>(data[plane]), samples * channels, plane, channels
+            );
+        } else {
+            this->sample_bits.add(
+                reinterpret_cast<int32_t*>(data[plane]), samples * channels, plane, channels
+            );
+        }
+    }
+}
+
+AudioSequence::AudioSequence(
+    AudioError error, int stream, bool read_ahead, const std::vector<AudioPart>& parts,
+    const std::vector<double>& track_starts, double duration
+) :
+    error(error), stream(stream), read_ahead(read_ahead), parts(parts), track_starts(track_starts)
+{
+    pthread_mutex_init(&this->mutex, nullptr);
+    this->index = 0;
+    this->frames_left = -1;
+    this->prefetch_wanted = true;
+    this->prefetching = false;
+    this->prefetch_index = -1;
+    this->prefetch_error = AudioError::OK;
+    this->interrupted = false;
+    this->started = false;
+    this->channel = 0;
+    this->samples = 0;
+    this->batch_size = BATCH_SIZE;
+    this->all_channels = false;
+    this->frames_per_interval = 0;
+    this->error_per_interval = 0;
+    this->error_base = 0;
+
+    // The stream info is that of the first file, only the duration is of them all.
+    if (!this->error.load()) {
+        AudioError error = AudioError::OK;
+        this->file = this->open_part(0, error);
+        if (this->file) {
+            this->info = info_of(*this->file);
+        }
+        this->error = error;
+    }
+    this->info.duration = duration;
+    if (!this->error.load() && !this->parts[0].to_end) {
+        this->frames_left = llround(this->parts[0].duration * this->info.sample_rate);
+    }
+}
+
+AudioSequence::~AudioSequence()
+{
+    this->join_prefetch();
+    pthread_mutex_destroy(&this->mutex);
+}
+
+void AudioSequence::start(int channel, int samples)
+{
+    this->channel = channel;
+    this->samples = samples;
+    this->started = true;
+    this->done_bits = SampleBits();
+    pthread_mutex_lock(&this->mutex);
+    this->interrupted = false;
+    pthread_mutex_unlock(&this->mutex);
+
+    // The parts have different time bases, count in microseconds instead.
+    int64_t rate = this->info.sample_rate;
+    int64_t duration = (int64_t)(this->info.duration * AV_TIME_BASE);
+    this->error_base = samples * (int64_t)AV_TIME_BASE;
+    this->frames_per_interval = av_rescale_rnd(duration, rate, this->error_base, AV_ROUND_DOWN);
+    this->error_per_interval = (duration * rate) % this->error_base;
+
+    if (this->file) {
+        this->file->start(channel, samples);
+    }
+}
+
+void AudioSequence::set_batch_size(int samples)
+{
+    this->batch_size = samples;
+    if (this->file) {
+        this->file->set_batch_size(samples);
+    }
+}
+
+void AudioSequence::set_all_channels(bool value)
+{
+    this->all_channels = value;
+    if (this->file) {
+        this->file->set_all_channels(value);
+    }
+}
+
+// A read never spans two parts, the one that ends a part may return fewer than `batch_size`.
+int AudioSequence::read()
+{
+    if (!!this->error.load()) {
+        return -1;
+    }
+
+    while (true) {
+        if (this->prefetch_wanted) {
+            this->prefetch_wanted = false;
+            this->start_prefetch();
+        }
+        int len = this->file->read();
+        if (len < 0) {
+            return len;
+        }
+        if (this->frames_left >= 0) {
+            len = (int)std::min((int64_t)len, this->frames_left);
+            this->frames_left -= len;
+        }
+        if (len > 0) {
+            return len;
+        }
+        if (this->interrupted.load(std::memory_order_relaxed)) {
             return 0;
         }
+        if (!this->next_part()) {
+            return !!this->error.load() ? -1 : 0;
+        }
+    }
+}
+
+void AudioSequence::interrupt()
+{
+    pthread_mutex_lock(&this->mutex);
+    this->interrupted.store(true, std::memory_order_relaxed);
+    if (this->file) {
+        this->file->interrupt();
+    }
+    pthread_mutex_unlock(&this->mutex);
+}
+
+bool AudioSequence::rewind()
+{
+    return this->seek(0.0);
+}
+
+bool AudioSequence::seek(double time)
+{
+    if (!!this->error.load()) {
+        return false;
+    }
+    int index = 0;
+    while (index + 1 < (int)this->parts.size() && time >= this->parts[index + 1].offset) {
+        index++;
+    }
+    const AudioPart& part = this->parts[index];
+    if (index != this->index) {
+        AudioError error;
+        std::unique_ptr<AudioFile> file = this->take_part(index, error);
+        if (!file) {
+            return false;
+        }
+        this->use_part(index, std::move(file));
+    }
+
+    double offset = std::max(0.0, time - part.offset);
+    if (!this->file->seek(part.start + offset)) {
+        return false;
+    }
+    this->frames_left = part.to_end ?
+        -1 : std::max(0LL, llround((part.duration - offset) * this->info.sample_rate));
+    // Only open the next part ahead when this one is read from its start, seeks into the
+    // middle are for a quick look around, see the preview of the pipeline.
+    this->prefetch_wanted = offset == 0.0;
+    return true;
+}
+
+const float *AudioSequence::get_buffer() const
+{
+    return this->file ? this->file->get_buffer() : nullptr;
+}
+
+const float *AudioSequence::get_frames() const
+{
+    return this->file ? this->file->get_frames() : nullptr;
+}
+
+const SampleBits& AudioSequence::get_sample_bits() const
+{
+    this->sample_bits = this->done_bits;
+    if (this->file) {
+        this->sample_bits.merge(this->file->get_sample_bits());
+    }
+    return this->sample_bits;
+}
+
+// Opens the part and seeks to where it starts. Returns nullptr and sets `error` if it can't or
+// if its format doesn't match the first one's. Only reads the parts, safe to call from the
+// prefetch thread.
+std::unique_ptr<AudioFile> AudioSequence::open_part(int index, AudioError& error) const
+{
+    const AudioPart& part = this->parts[index];
+    auto file = open_file(part.file_name, this->stream, this->read_ahead);
+    error = file->get_error();
+    if (!error && index && (file->get_sample_rate() != this->info.sample_rate ||
+        file->get_channels() != this->info.channels)) {
+        error = AudioError::MIXED_FORMATS;
+    }
+    if (!error && part.start > 0.0 && !file->seek(part.start)) {
+        error = AudioError::CANNOT_OPEN_FILE;
+    }
+    if (!!error) {
+        return nullptr;
+    }
+    return file;
+}
+
+// The part opened by the prefetch thread if it's that one, otherwise opens it now.
+std::unique_ptr<AudioFile> AudioSequence::take_part(int index, AudioError& error)
+{
+    this->join_prefetch();
+    std::unique_ptr<AudioFile> file;
+    if (this->prefetch_index == index) {
+        file = std::move(this->prefetched);
+        error = this->prefetch_error;
+    } else {
+        file = this->open_part(index, error);
     }
+    this->prefetched.reset();
+    this->prefetch_index = -1;
+    return file;
+}
+
+// Makes `file` the one read from, set up like the one it replaces.
+void AudioSequence::use_part(int index, std::unique_ptr<AudioFile> file)
+{
+    if (this->started) {
+        file->start(this->channel, this->samples);
+    }
+    file->set_batch_size(this->batch_size);
+    file->set_all_channels(this->all_channels);
+    this->done_bits.merge(this->file->get_sample_bits());
+
+    pthread_mutex_lock(&this->mutex);
+    std::swap(this->file, file);
+    this->index = index;
+    if (this->interrupted.load(std::memory_order_relaxed)) {
+        this->file->interrupt();
+    }
+    pthread_mutex_unlock(&this->mutex);
+
+    const AudioPart& part = this->parts[index];
+    this->frames_left = part.to_end ? -1 : llround(part.duration * this->info.sample_rate);
+    this->prefetch_wanted = true;
+}
+
+// Moves on to the next part, returns false if there is none or, with the error set, if it
+// can't be read. The files may have changed since they were probed.
+bool AudioSequence::next_part()
+{
+    int index = this->index + 1;
+    if (index >= (int)this->parts.size()) {
+        return false;
+    }
+    AudioError error;
+    std::unique_ptr<AudioFile> file = this->take_part(index, error);
+    if (!file) {
+        this->error = error;
+        return false;
+    }
+    this->use_part(index, std::move(file));
+    return true;
+}
+
+void AudioSequence::start_prefetch()
+{
+    int index = this->index + 1;
+    if (index >= (int)this->parts.size() || this->prefetch_index == index) {
+        return;
+    }
+    this->join_prefetch();
+    this->prefetched.reset();
+    this->prefetch_index = index;
+    this->prefetching =
+        !pthread_create(&this->prefetch_thread, nullptr, &AudioSequence::prefetch_func, this);
+    if (!this->prefetching) {
+        // Then the part is opened when it's needed.
+        this->prefetch_index = -1;
+    }
+}
+
+void AudioSequence::join_prefetch()
+{
+    if (this->prefetching) {
+        pthread_join(this->prefetch_thread, nullptr);
+        this->prefetching = false;
+    }
+}
+
+void * AudioSequence::prefetch_func(void *pp)
+{
+    AudioSequence *sequence = static_cast<AudioSequence*>(pp);
+    sequence->prefetched =
+        sequence->open_part(sequence->prefetch_index, sequence->prefetch_error);
+    return nullptr;
 }
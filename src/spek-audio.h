@@ -3,17 +3,61 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
+
+#include "spek-bits.h"
 
 class AudioFile;
+struct AudioInfo;
 enum class AudioError;
 
+// A part of an album, see Audio::open_sequence(): the file from `start` to `end` seconds, or to
+// its end if `end` is 0.
+struct AudioSource
+{
+    std::string file_name;
+    double start = 0.0;
+    double end = 0.0;
+};
+
 class Audio
 {
 public:
     Audio();
     ~Audio();
 
+    // Read local files in large chunks of our own instead of through FFmpeg's file protocol.
+    void set_read_ahead(bool value) { this->read_ahead = value; }
+
+    // Cue sheets and playlists are opened as one stream with open_sequence(), see spek_is_album().
     std::unique_ptr<AudioFile> open(const std::string& file_name, int stream);
+    // Same as open(), for a file the caller holds in memory. The `size` bytes at `data` are
+    // read in place, they must stay there until the file is closed.
+    std::unique_ptr<AudioFile> open_memory(const void *data, size_t size, int stream);
+
+    // Reads `sources` one after the other as a single stream, e.g. the tracks of an album, with
+    // the duration of them all. They must have the same sample rate and channels. Only the
+    // first file is opened here, each of the others is opened on another thread while the one
+    // before it is read, so that decoding goes on without a gap. Consecutive sources of the
+    // same file are read in one go.
+    std::unique_ptr<AudioFile> open_sequence(const std::vector<AudioSource>& sources, int stream);
+
+    // Same as open(), but if `all` is set also opens the remaining audio streams so they are
+    // decoded in the same pass over the file. The first file is always for `stream`.
+    std::vector<std::unique_ptr<AudioFile>> open_streams(
+        const std::string& file_name, int stream, bool all
+    );
+
+    // Reads the stream info from the container headers without opening the decoder, resorting
+    // to open() only for formats that don't declare it. Safe to call from several threads.
+    AudioInfo probe(const std::string& file_name, int stream);
+    // Probes each file in `file_names` using up to `threads` threads.
+    std::vector<AudioInfo> probe(
+        const std::vector<std::string>& file_names, int stream, int threads
+    );
+
+private:
+    bool read_ahead;
 };
 
 class AudioFile
@@ -22,9 +66,20 @@ public:
     virtual ~AudioFile() {}
 
     virtual void start(int channel, int samples) = 0;
+    // Each read() returns at least this many samples, except at the end of the stream.
+    virtual void set_batch_size(int samples) = 0;
     virtual int read() = 0;
+    // Makes a read() in progress, and the next ones until start() is called again, return 0 as
+    // soon as possible. Safe to call from any thread.
+    virtual void interrupt() = 0;
+    // Seeks back to the beginning so the stream can be analysed again with different
+    // parameters without reopening the file. Returns false if the stream can't be rewound.
+    virtual bool rewind() = 0;
+    // Seeks to the packet containing `time` seconds, or the closest one before it.
+    virtual bool seek(double time) = 0;
 
     virtual AudioError get_error() const = 0;
+    virtual int get_stream() const = 0;
     virtual std::string get_codec_name() const = 0;
     virtual int get_bit_rate() const = 0;
     virtual int get_sample_rate() const = 0;
@@ -33,9 +88,18 @@ public:
     virtual int get_channels() const = 0;
     virtual double get_duration() const = 0;
     virtual const float *get_buffer() const = 0;
+    // Whether read() also converts the samples of all the channels, for get_frames().
+    virtual void set_all_channels(bool value) = 0;
+    // The samples of all the channels interleaved, as many frames as read() returned.
+    virtual const float *get_frames() const = 0;
+    // The bits used by the integer samples of every channel read since start(), not only the
+    // selected one. Empty for floating point formats.
+    virtual const SampleBits& get_sample_bits() const = 0;
     virtual int64_t get_frames_per_interval() const = 0;
     virtual int64_t get_error_per_interval() const = 0;
     virtual int64_t get_error_base() const = 0;
+    // Where the tracks after the first one start, in seconds. Empty unless it's a sequence.
+    virtual std::vector<double> get_track_starts() const = 0;
 };
 
 enum class AudioError
@@ -49,6 +113,20 @@ enum class AudioError
     NO_CHANNELS,
     CANNOT_OPEN_DECODER,
     BAD_SAMPLE_FORMAT,
+    MIXED_FORMATS, // The files of a sequence don't have the same sample rate and channels.
+};
+
+// Stream info as reported by AudioFile, see Audio::probe().
+struct AudioInfo
+{
+    AudioError error = AudioError::OK;
+    std::string codec_name;
+    int bit_rate = 0;
+    int sample_rate = 0;
+    int bits_per_sample = 0;
+    int streams = 0;
+    int channels = 0;
+    double duration = 0.0;
 };
 
 inline bool operator!(AudioError error) {
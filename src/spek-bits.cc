@@ -0,0 +1,246 @@
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "spek-bits.h"
+
+void SampleBits::reset(int channels, int bits)
+{
+    this->bits = bits;
+    Channel channel = { 0, UINT32_MAX, INT32_MAX, INT32_MIN };
+    this->channels.assign(channels, channel);
+}
+
+// The samples that didn't fill a whole vector, or all of them if the channels don't line up
+// with the lanes.
+template<typename T> static void add_samples(
+    const T *samples, int n, int channel, int channels, uint32_t *ored, uint32_t *anded,
+    int32_t *min, int32_t *max)
+{
+    int c = 0;
+    for (int i = 0; i < n; i++) {
+        int32_t value = samples[i];
+        ored[channel + c] |= (uint32_t)value;
+        anded[channel + c] &= (uint32_t)value;
+        min[channel + c] = value < min[channel + c] ? value : min[channel + c];
+        max[channel + c] = value > max[channel + c] ? value : max[channel + c];
+        if (++c == channels) {
+            c = 0;
+        }
+    }
+}
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+// Fold the lanes of the vector reductions into the channels they hold.
+static void fold_lanes(
+    const int32_t *ored, const int32_t *anded, const int32_t *min, const int32_t *max,
+    int lanes, int channel, int channels, uint32_t *c_ored, uint32_t *c_anded,
+    int32_t *c_min, int32_t *c_max)
+{
+    for (int lane = 0; lane < lanes; lane++) {
+        int c = channel + lane % channels;
+        c_ored[c] |= (uint32_t)ored[lane];
+        c_anded[c] &= (uint32_t)anded[lane];
+        c_min[c] = min[lane] < c_min[c] ? min[lane] : c_min[c];
+        c_max[c] = max[lane] > c_max[c] ? max[lane] : c_max[c];
+    }
+}
+#endif
+
+void SampleBits::add(const int16_t *samples, int n, int channel, int channels)
+{
+    int count = this->channels.size();
+    std::vector<uint32_t> ored(count), anded(count);
+    std::vector<int32_t> min(count), max(count);
+    for (int c = 0; c < count; c++) {
+        ored[c] = this->channels[c].ored;
+        anded[c] = this->channels[c].anded;
+        min[c] = this->channels[c].min;
+        max[c] = this->channels[c].max;
+    }
+
+    int i = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    // Each lane always sees the same channel if their number divides the lanes.
+    if (8 % channels == 0 && n >= 8) {
+        int16_t lanes[4][8];
+#if defined(__SSE2__)
+        __m128i v_or = _mm_setzero_si128();
+        __m128i v_and = _mm_set1_epi16(-1);
+        __m128i v_min = _mm_set1_epi16(INT16_MAX);
+        __m128i v_max = _mm_set1_epi16(INT16_MIN);
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+            v_or = _mm_or_si128(v_or, v);
+            v_and = _mm_and_si128(v_and, v);
+            v_min = _mm_min_epi16(v_min, v);
+            v_max = _mm_max_epi16(v_max, v);
+        }
+        _mm_storeu_si128((__m128i *)lanes[0], v_or);
+        _mm_storeu_si128((__m128i *)lanes[1], v_and);
+        _mm_storeu_si128((__m128i *)lanes[2], v_min);
+        _mm_storeu_si128((__m128i *)lanes[3], v_max);
+#else
+        int16x8_t v_or = vdupq_n_s16(0);
+        int16x8_t v_and = vdupq_n_s16(-1);
+        int16x8_t v_min = vdupq_n_s16(INT16_MAX);
+        int16x8_t v_max = vdupq_n_s16(INT16_MIN);
+        for (; i + 8 <= n; i += 8) {
+            int16x8_t v = vld1q_s16(samples + i);
+            v_or = vorrq_s16(v_or, v);
+            v_and = vandq_s16(v_and, v);
+            v_min = vminq_s16(v_min, v);
+            v_max = vmaxq_s16(v_max, v);
+        }
+        vst1q_s16(lanes[0], v_or);
+        vst1q_s16(lanes[1], v_and);
+        vst1q_s16(lanes[2], v_min);
+        vst1q_s16(lanes[3], v_max);
+#endif
+        int32_t wide[4][8];
+        for (int k = 0; k < 4; k++) {
+            for (int lane = 0; lane < 8; lane++) {
+                wide[k][lane] = lanes[k][lane];
+            }
+        }
+        fold_lanes(
+            wide[0], wide[1], wide[2], wide[3], 8, channel, channels,
+            ored.data(), anded.data(), min.data(), max.data()
+        );
+    }
+#endif
+    // `i` is a multiple of the channels, so the rest starts with `channel` again.
+    add_samples(
+        samples + i, n - i, channel, channels, ored.data(), anded.data(), min.data(), max.data()
+    );
+
+    for (int c = 0; c < count; c++) {
+        this->channels[c] = { ored[c], anded[c], min[c], max[c] };
+    }
+}
+
+void SampleBits::add(const int32_t *samples, int n, int channel, int channels)
+{
+    int count = this->channels.size();
+    std::vector<uint32_t> ored(count), anded(count);
+    std::vector<int32_t> min(count), max(count);
+    for (int c = 0; c < count; c++) {
+        ored[c] = this->channels[c].ored;
+        anded[c] = this->channels[c].anded;
+        min[c] = this->channels[c].min;
+        max[c] = this->channels[c].max;
+    }
+
+    int i = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    if (4 % channels == 0 && n >= 4) {
+        int32_t lanes[4][4];
+#if defined(__SSE2__)
+        __m128i v_or = _mm_setzero_si128();
+        __m128i v_and = _mm_set1_epi32(-1);
+        __m128i v_min = _mm_set1_epi32(INT32_MAX);
+        __m128i v_max = _mm_set1_epi32(INT32_MIN);
+        for (; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+            v_or = _mm_or_si128(v_or, v);
+            v_and = _mm_and_si128(v_and, v);
+            // No 32-bit minimum and maximum before SSE4.1, select with a comparison instead.
+            __m128i less = _mm_cmplt_epi32(v, v_min);
+            v_min = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, v_min));
+            __m128i greater = _mm_cmpgt_epi32(v, v_max);
+            v_max = _mm_or_si128(_mm_and_si128(greater, v), _mm_andnot_si128(greater, v_max));
+        }
+        _mm_storeu_si128((__m128i *)lanes[0], v_or);
+        _mm_storeu_si128((__m128i *)lanes[1], v_and);
+        _mm_storeu_si128((__m128i *)lanes[2], v_min);
+        _mm_storeu_si128((__m128i *)lanes[3], v_max);
+#else
+        int32x4_t v_or = vdupq_n_s32(0);
+        int32x4_t v_and = vdupq_n_s32(-1);
+        int32x4_t v_min = vdupq_n_s32(INT32_MAX);
+        int32x4_t v_max = vdupq_n_s32(INT32_MIN);
+        for (; i + 4 <= n; i += 4) {
+            int32x4_t v = vld1q_s32(samples + i);
+            v_or = vorrq_s32(v_or, v);
+            v_and = vandq_s32(v_and, v);
+            v_min = vminq_s32(v_min, v);
+            v_max = vmaxq_s32(v_max, v);
+        }
+        vst1q_s32(lanes[0], v_or);
+        vst1q_s32(lanes[1], v_and);
+        vst1q_s32(lanes[2], v_min);
+        vst1q_s32(lanes[3], v_max);
+#endif
+        fold_lanes(
+            lanes[0], lanes[1], lanes[2], lanes[3], 4, channel, channels,
+            ored.data(), anded.data(), min.data(), max.data()
+        );
+    }
+#endif
+    add_samples(
+        samples + i, n - i, channel, channels, ored.data(), anded.data(), min.data(), max.data()
+    );
+
+    for (int c = 0; c < count; c++) {
+        this->channels[c] = { ored[c], anded[c], min[c], max[c] };
+    }
+}
+
+void SampleBits::merge(const SampleBits& other)
+{
+    if (!other.bits) {
+        return;
+    }
+    if (!this->bits) {
+        *this = other;
+        return;
+    }
+    if (other.bits != this->bits || other.channels.size() != this->channels.size()) {
+        *this = SampleBits();
+        return;
+    }
+    for (size_t c = 0; c < this->channels.size(); c++) {
+        Channel& a = this->channels[c];
+        const Channel& b = other.channels[c];
+        a.ored |= b.ored;
+        a.anded &= b.anded;
+        a.min = b.min < a.min ? b.min : a.min;
+        a.max = b.max > a.max ? b.max : a.max;
+    }
+}
+
+int SampleBits::get_effective_bits(int channel) const
+{
+    const Channel& c = this->channels[channel];
+    if (c.min > c.max) {
+        // Nothing was added.
+        return 0;
+    }
+    // The 16-bit samples are sign-extended, only their low bits count.
+    uint32_t changing = c.ored ^ c.anded;
+    if (this->bits < 32) {
+        changing &= (1u << this->bits) - 1;
+    }
+    if (!changing) {
+        return 0;
+    }
+    int unused = 0;
+    while (!(changing & (1u << unused))) {
+        unused++;
+    }
+    return this->bits - unused;
+}
+
+double SampleBits::get_peak(int channel) const
+{
+    const Channel& c = this->channels[channel];
+    if (c.min > c.max) {
+        return 0.0;
+    }
+    double peak = fmax(-(double)c.min, (double)c.max);
+    return peak / ldexp(1.0, this->bits - 1);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+// Tracks which bits the integer samples of each channel actually use, and their peak, while
+// they are decoded. It takes an OR, an AND, a minimum and a maximum over the raw samples four
+// or eight at a time, which costs next to nothing next to the decoding itself.
+//
+// A bit that is always 0 or always 1 carries nothing, so the effective bit depth goes down to
+// the lowest bit that changes: a 16-bit recording padded to 24 bits has 16.
+class SampleBits
+{
+public:
+    SampleBits() : bits(0) {}
+
+    // Start over for `channels` channels of `bits` bit samples, 16 or 32.
+    void reset(int channels, int bits);
+    // `n` samples of `channels` interleaved channels, the first for `channel`. For planar
+    // formats `channels` is 1 and each plane is added on its own.
+    void add(const int16_t *samples, int n, int channel, int channels);
+    void add(const int32_t *samples, int n, int channel, int channels);
+    // Take in the samples `other` saw, e.g. those of the next file of an album. Nothing is known
+    // any more if their sizes or channels differ.
+    void merge(const SampleBits& other);
+
+    // The size of the samples, 0 if nothing was added e.g. for floating point formats.
+    int get_bits() const { return this->bits; }
+    int get_channels() const { return this->channels.size(); }
+    // The bits from the most significant one down to the lowest one that changes, 0 if all the
+    // samples were the same.
+    int get_effective_bits(int channel) const;
+    // The largest sample magnitude relative to full scale, exact since it's taken before the
+    // samples are converted to floating point.
+    double get_peak(int channel) const;
+
+private:
+    struct Channel
+    {
+        uint32_t ored;
+        uint32_t anded;
+        int32_t min;
+        int32_t max;
+    };
+
+    int bits;
+    std::vector<Channel> channels;
+};
@@ -0,0 +1,145 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spek-fft.h"
+#include "spek-pipeline.h"
+
+#include "spek-columns.h"
+
+constexpr float ColumnStore::MIN_DB;
+constexpr float ColumnStore::MAX_DB;
+
+template<typename T> static T quantise(float value, float max)
+{
+    // NaN and -inf (silence) end up at the bottom too.
+    if (!(value > ColumnStore::MIN_DB)) {
+        return 0;
+    }
+    if (value >= ColumnStore::MAX_DB) {
+        return (T)max;
+    }
+    float range = ColumnStore::MAX_DB - ColumnStore::MIN_DB;
+    return (T)lrintf((value - ColumnStore::MIN_DB) * max / range);
+}
+
+template<typename T> static float dequantise(T value, float max)
+{
+    return ColumnStore::MIN_DB + value * (ColumnStore::MAX_DB - ColumnStore::MIN_DB) / max;
+}
+
+void ColumnStore::create(int samples, int bands, ColumnPrecision precision)
+{
+    this->samples = samples;
+    this->bands = bands;
+    this->precision = precision;
+
+    // Release the memory of the previous layout.
+    std::vector<float>().swap(this->floats);
+    std::vector<uint16_t>().swap(this->words);
+    std::vector<uint8_t>().swap(this->bytes);
+
+    size_t size = (size_t)samples * bands;
+    switch (precision) {
+    case ColumnPrecision::FLOAT:
+        this->floats.resize(size);
+        break;
+    case ColumnPrecision::BITS_16:
+        this->words.resize(size);
+        break;
+    case ColumnPrecision::BITS_8:
+        this->bytes.resize(size);
+        break;
+    }
+}
+
+void ColumnStore::set(int sample, const float *values)
+{
+    size_t offset = (size_t)sample * this->bands;
+    switch (this->precision) {
+    case ColumnPrecision::FLOAT:
+        memcpy(&this->floats[offset], values, this->bands * sizeof(float));
+        break;
+    case ColumnPrecision::BITS_16:
+        for (int i = 0; i < this->bands; i++) {
+            this->words[offset + i] = quantise<uint16_t>(values[i], UINT16_MAX);
+        }
+        break;
+    case ColumnPrecision::BITS_8:
+        for (int i = 0; i < this->bands; i++) {
+            this->bytes[offset + i] = quantise<uint8_t>(values[i], UINT8_MAX);
+        }
+        break;
+    }
+}
+
+void ColumnStore::get(int sample, float *values) const
+{
+    size_t offset = (size_t)sample * this->bands;
+    switch (this->precision) {
+    case ColumnPrecision::FLOAT:
+        memcpy(values, &this->floats[offset], this->bands * sizeof(float));
+        break;
+    case ColumnPrecision::BITS_16:
+        for (int i = 0; i < this->bands; i++) {
+            values[i] = dequantise(this->words[offset + i], UINT16_MAX);
+        }
+        break;
+    case ColumnPrecision::BITS_8:
+        for (int i = 0; i < this->bands; i++) {
+            values[i] = dequantise(this->bytes[offset + i], UINT8_MAX);
+        }
+        break;
+    }
+}
+
+size_t ColumnStore::get_bytes() const
+{
+    return
+        this->floats.size() * sizeof(float) +
+        this->words.size() * sizeof(uint16_t) +
+        this->bytes.size() * sizeof(uint8_t);
+}
+
+ColumnsRecorder::ColumnsRecorder(int fft_bits, int columns) :
+    fft_bits(fft_bits), bands((1 << (fft_bits - 1)) + 1), columns(columns)
+{
+    this->values.reserve((size_t)columns * this->bands);
+    this->levels.reserve((size_t)columns * 3);
+}
+
+void ColumnsRecorder::add_to(struct spek_pipeline *pipeline)
+{
+    FFT fft;
+    spek_pipeline_add_columns(
+        pipeline, fft.create(this->fft_bits), this->columns, columns_cb, this
+    );
+}
+
+bool ColumnsRecorder::save(const std::string& file_name) const
+{
+    FILE *file = fopen(file_name.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok =
+        fwrite(this->values.data(), sizeof(float), this->values.size(), file) ==
+            this->values.size() &&
+        fwrite(this->levels.data(), sizeof(float), this->levels.size(), file) ==
+            this->levels.size();
+    return fclose(file) == 0 && ok;
+}
+
+// On the worker thread of the transform, the columns in order.
+void ColumnsRecorder::columns_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data)
+{
+    ColumnsRecorder *recorder = (ColumnsRecorder *)cb_data;
+    if (sample < 0) {
+        return;
+    }
+    recorder->values.insert(recorder->values.end(), values, values + bands);
+    recorder->levels.insert(
+        recorder->levels.end(), { envelope->min, envelope->max, envelope->rms }
+    );
+}
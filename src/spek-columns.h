@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+struct spek_envelope;
+struct spek_pipeline;
+
+enum class ColumnPrecision
+{
+    FLOAT,
+    BITS_16,
+    BITS_8,
+};
+
+// Spectrogram columns of dB values kept for later display. The quantised precisions cover
+// MIN_DB to MAX_DB, which is wider than any range the palette can be set to, and clamp the
+// values outside of it; 8 bits give steps of about 0.6 dB, 16 bits of about 0.002 dB.
+class ColumnStore
+{
+public:
+    static constexpr float MIN_DB = -160.0f;
+    static constexpr float MAX_DB = 0.0f;
+
+    ColumnStore() : samples(0), bands(0), precision(ColumnPrecision::FLOAT) {}
+
+    void create(int samples, int bands, ColumnPrecision precision);
+    void clear() { this->create(0, 0, this->precision); }
+
+    void set(int sample, const float *values);
+    // Decodes the column into `values`, which must hold get_bands() values.
+    void get(int sample, float *values) const;
+
+    int get_samples() const { return this->samples; }
+    int get_bands() const { return this->bands; }
+    ColumnPrecision get_precision() const { return this->precision; }
+    bool empty() const { return !this->samples || !this->bands; }
+    size_t get_bytes() const;
+
+private:
+    int samples;
+    int bands;
+    ColumnPrecision precision;
+    std::vector<float> floats;
+    std::vector<uint16_t> words;
+    std::vector<uint8_t> bytes;
+};
+
+// The columns the C API passes on, see spek_read_columns_levels(), recorded in a pass over the
+// file made for something else, e.g. its image. They come from a transform of their own in that
+// pass, see spek_pipeline_add_columns(), so they are the same as those of spek_report_columns()
+// as long as the pass is neither decimated nor zoomed into a band.
+class ColumnsRecorder
+{
+public:
+    ColumnsRecorder(int fft_bits, int columns);
+
+    // Record the columns of `pipeline` too, before it's started.
+    void add_to(struct spek_pipeline *pipeline);
+
+    int get_bands() const { return this->bands; }
+    int get_columns() const { return this->levels.size() / 3; }
+    // The levels in dBFS, one column of bands after the other.
+    const std::vector<float>& get_values() const { return this->values; }
+    // The lowest, the highest and the RMS sample value of each column.
+    const std::vector<float>& get_levels() const { return this->levels; }
+    // Writes the columns then their levels as 32-bit floats, as spek_report_columns() does.
+    bool save(const std::string& file_name) const;
+
+private:
+    static void columns_cb(
+        int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data);
+
+    int fft_bits;
+    int bands;
+    int columns;
+    std::vector<float> values;
+    std::vector<float> levels;
+};
@@ -0,0 +1,175 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "spek-cutoff.h"
+
+enum
+{
+    MIN_STEP_BANDS = 4,
+};
+
+// The drop is measured between the average levels either side of a candidate, over this width.
+static const double STEP_WIDTH = 500.0;
+// How much the level has to drop to be a cutoff, lossy encoders leave little above theirs.
+static const double STEP_DB = 24.0;
+// Columns without a band at least this loud are too quiet to tell anything.
+static const double SILENCE_DB = -90.0;
+// No encoder cuts off lower than this, below it the drops are the music's.
+static const double MIN_CUTOFF = 5000.0;
+// The columns' cutoffs count as the same one if they are this close.
+static const double CUTOFF_SPREAD = 250.0;
+// The share of the columns with the same cutoff that makes for a verdict.
+static const double MIN_CONFIDENCE = 0.5;
+// Above this a lowpass may as well be the source's, e.g. a resampler's, so it takes more to put
+// it down to an encoder: this share of the columns, with the level staying down all the way up
+// like it does above an encoder's lowpass.
+static const double HIGH_CUTOFF = 20000.0;
+static const double HIGH_CONFIDENCE = 0.9;
+// Levels are clamped to this, silence is -inf.
+static const double FLOOR_DB = -160.0;
+
+// The usual lowpass of MP3 and AAC encoders by bit rate, roughly after LAME's presets, as the
+// highest cutoff still taken for each. Cutoffs above the last are those of the sources.
+static const struct {
+    double cutoff;
+    int bit_rate;
+} LOWPASSES[] = {
+    { 12500.0, 64 },
+    { 14500.0, 80 },
+    { 15400.0, 96 },
+    { 15800.0, 112 },
+    { 17200.0, 128 },
+    { 18000.0, 160 },
+    { 19200.0, 192 },
+    { 20200.0, 256 },
+    { 21000.0, 320 },
+};
+
+void CutoffAnalyzer::process_column(int sample, const float *values)
+{
+    if (sample >= (int)this->cutoffs.size()) {
+        this->cutoffs.resize(sample + 1, NAN);
+        this->shelves.resize(sample + 1, false);
+    }
+
+    int bands = this->format.bands;
+    if (bands < 2 * MIN_STEP_BANDS) {
+        return;
+    }
+    double spacing = (this->format.high - this->format.low) / (bands - 1);
+
+    // Running sums, so that every candidate costs the same whatever the width.
+    this->sums.resize(bands + 1);
+    this->sums[0] = 0.0;
+    double loudest = FLOOR_DB;
+    for (int i = 0; i < bands; i++) {
+        double value = values[i] > FLOOR_DB ? values[i] : FLOOR_DB;
+        loudest = fmax(loudest, value);
+        this->sums[i + 1] = this->sums[i] + value;
+    }
+    if (loudest < SILENCE_DB) {
+        return;
+    }
+
+    int width = std::max((int)MIN_STEP_BANDS, (int)lround(STEP_WIDTH / spacing));
+    int first = std::max(width, (int)ceil((MIN_CUTOFF - this->format.low) / spacing));
+    double step = 0.0;
+    double level = 0.0;
+    int band = -1;
+    for (int i = first; i + width <= bands; i++) {
+        double below = (this->sums[i] - this->sums[i - width]) / width;
+        double above = (this->sums[i + width] - this->sums[i]) / width;
+        if (below - above > step) {
+            step = below - above;
+            level = below;
+            band = i;
+        }
+    }
+    if (step < STEP_DB) {
+        this->cutoffs[sample] = 0.0f;
+        return;
+    }
+    this->cutoffs[sample] = this->format.low + band * spacing;
+    // Whether it stays down up to the last band rather than coming back.
+    bool shelf = true;
+    for (int i = band + width; i <= bands && shelf; i++) {
+        shelf = level - (this->sums[i] - this->sums[i - width]) / width >= STEP_DB;
+    }
+    this->shelves[sample] = shelf;
+}
+
+void CutoffAnalyzer::finish()
+{
+    std::vector<float> found;
+    int voiced = 0;
+    for (float value : this->cutoffs) {
+        if (!std::isnan(value)) {
+            voiced++;
+            if (value > 0.0f) {
+                found.push_back(value);
+            }
+        }
+    }
+    this->cutoff = 0.0;
+    this->confidence = 0.0;
+    this->bit_rate = 0;
+    if (found.empty()) {
+        return;
+    }
+
+    std::nth_element(found.begin(), found.begin() + found.size() / 2, found.end());
+    this->cutoff = found[found.size() / 2];
+    double spacing = (this->format.high - this->format.low) / (this->format.bands - 1);
+    double spread = fmax(CUTOFF_SPREAD, 2.0 * spacing);
+    int close = 0;
+    int shelved = 0;
+    for (size_t i = 0; i < this->cutoffs.size(); i++) {
+        if (this->cutoffs[i] > 0.0f && fabs(this->cutoffs[i] - this->cutoff) <= spread) {
+            close++;
+            shelved += this->shelves[i];
+        }
+    }
+    this->confidence = close / (double)voiced;
+
+    bool certain = this->cutoff <= HIGH_CUTOFF ||
+        (this->confidence >= HIGH_CONFIDENCE && shelved >= HIGH_CONFIDENCE * close);
+    if (this->confidence >= MIN_CONFIDENCE && certain) {
+        for (const auto& lowpass : LOWPASSES) {
+            if (this->cutoff <= lowpass.cutoff) {
+                this->bit_rate = lowpass.bit_rate;
+                break;
+            }
+        }
+    }
+}
+
+std::vector<AnalyzerResult> CutoffAnalyzer::get_results() const
+{
+    return {
+        { "cutoff", this->cutoff, "Hz" },
+        { "cutoff_confidence", this->confidence, "" },
+        { "transcoded_bit_rate", (double)this->bit_rate, "kbps" },
+    };
+}
+
+std::string CutoffAnalyzer::get_verdict() const
+{
+    char verdict[128];
+    if (this->bit_rate) {
+        snprintf(
+            verdict, sizeof(verdict), "likely transcoded from MP3/AAC at ~%d kbps",
+            this->bit_rate
+        );
+    } else if (this->confidence >= MIN_CONFIDENCE) {
+        snprintf(
+            verdict, sizeof(verdict), "cutoff at %.1f kHz, source unknown", this->cutoff / 1000.0
+        );
+    } else if (this->cutoffs.empty()) {
+        snprintf(verdict, sizeof(verdict), "not analysed");
+    } else {
+        snprintf(verdict, sizeof(verdict), "no lossy cutoff");
+    }
+    return verdict;
+}
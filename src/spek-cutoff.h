@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "spek-analyzer.h"
+
+// Looks for the hard lowpass cutoff lossy encoders leave in the spectrum, to spot files that
+// were decoded from MP3 or AAC and saved in a lossless format.
+//
+// Each column is checked for the frequency with the steepest drop in level over a few hundred
+// Hz, which counts as a cutoff if the drop is deep enough. Music has no such edge of its own,
+// an encoder's lowpass puts one at the same frequency in most of the columns that aren't silent.
+class CutoffAnalyzer : public Analyzer
+{
+public:
+    CutoffAnalyzer() : cutoff(0.0), confidence(0.0), bit_rate(0) {}
+
+    std::string get_name() const { return "cutoff"; }
+    bool wants_columns() const { return true; }
+
+    void process(const float *samples, int n) { (void)samples; (void)n; }
+    void process_column(int sample, const float *values);
+    void finish();
+    std::vector<AnalyzerResult> get_results() const;
+
+    // The cutoff of each column in Hz, 0 where there was none and NaN where it was too quiet to
+    // tell, for a picture of the cutoff over time.
+    const std::vector<float>& get_cutoffs() const { return this->cutoffs; }
+    // The median of the columns' cutoffs in Hz, 0 if none had one.
+    double get_cutoff() const { return this->cutoff; }
+    // How sure it is that there is a lossy cutoff at get_cutoff(), from 0 to 1: the share of the
+    // columns that have one within a couple of bands of it.
+    double get_confidence() const { return this->confidence; }
+    // The bit rate in kbps of the encoders that usually cut off there, 0 if it doesn't look like
+    // a lossy source. Cutoffs above 20 kHz also need most of the columns to have one, with the
+    // level staying down above it.
+    int get_bit_rate() const { return this->bit_rate; }
+    // One line for the report.
+    std::string get_verdict() const;
+
+private:
+    std::vector<float> cutoffs;
+    std::vector<bool> shelves; // Whether the level stays down above the column's cutoff.
+    std::vector<double> sums; // Scratch space for the running sums of the levels.
+    double cutoff;
+    double confidence;
+    int bit_rate;
+};
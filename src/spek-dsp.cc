@@ -0,0 +1,238 @@
+#include <math.h>
+
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "spek-dsp.h"
+
+enum
+{
+    // Filter taps per output. The complex decimator only keeps the middle half of its output
+    // and has room for a wide transition band, the real one keeps almost all of it.
+    TAPS_PER_PHASE = 16,
+    REAL_TAPS_PER_PHASE = 48,
+    // The interpolator's filter is as short as for the true peak of loudness meters.
+    INTERPOLATOR_TAPS_PER_PHASE = 12,
+};
+
+// Kaiser window shape for the 100 dB of attenuation the spectrogram can show.
+static const double KAISER_BETA = 10.0;
+
+// Modified Bessel function of the first kind, order 0, for the Kaiser window.
+static double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// The bulk of the decimators' and the interpolator's work, four taps at a time where available.
+static float dot_product(const float *a, const float *b, int n)
+{
+    int i = 0;
+    float result = 0.0f;
+#if defined(__SSE__)
+    __m128 sum = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float parts[4];
+    _mm_storeu_ps(parts, sum);
+    result = parts[0] + parts[1] + parts[2] + parts[3];
+#elif defined(__ARM_NEON)
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float parts[4];
+    vst1q_f32(parts, sum);
+    result = parts[0] + parts[1] + parts[2] + parts[3];
+#endif
+    for (; i < n; i++) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+std::vector<float> spek_lowpass(int taps, double cutoff)
+{
+    std::vector<float> coefs(taps);
+    double middle = (taps - 1) / 2.0;
+    double sum = 0.0;
+    std::vector<double> values(taps);
+    for (int k = 0; k < taps; k++) {
+        double t = k - middle;
+        double sinc = t == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        double r = taps > 1 ? 2.0 * k / (taps - 1) - 1.0 : 0.0;
+        values[k] = sinc * bessel_i0(KAISER_BETA * sqrt(1.0 - r * r)) / bessel_i0(KAISER_BETA);
+        sum += values[k];
+    }
+    // Unity gain at 0 Hz.
+    for (int k = 0; k < taps; k++) {
+        coefs[k] = (float)(values[k] / sum);
+    }
+    return coefs;
+}
+
+ComplexDecimator::ComplexDecimator(int factor, double center) :
+    factor(factor), center(center), taps(TAPS_PER_PHASE * factor + 1)
+{
+    // The output keeps a quarter of its rate either side of the center, the images that could
+    // fold into that must be outside of the pass band, so the cutoff is half-way there.
+    std::vector<float> lowpass = spek_lowpass(this->taps, 0.5 / factor);
+    this->coefs_re.resize(this->taps);
+    this->coefs_im.resize(this->taps);
+    for (int k = 0; k < this->taps; k++) {
+        double phase = 2.0 * M_PI * center * k;
+        this->coefs_re[this->taps - 1 - k] = (float)(lowpass[k] * cos(phase));
+        this->coefs_im[this->taps - 1 - k] = (float)(lowpass[k] * sin(phase));
+    }
+    this->history.resize(2 * this->taps);
+    this->reset();
+}
+
+int ComplexDecimator::get_delay() const
+{
+    return (this->taps - 1) / 2 / this->factor;
+}
+
+void ComplexDecimator::reset()
+{
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    this->pos = 0;
+    // The first output is the one for the first input once it's half-way through the filter.
+    this->countdown = (this->taps - 1) / 2;
+    this->rotation = fmod(this->center * this->countdown, 1.0);
+}
+
+int ComplexDecimator::process(const float *in, int n, float *re, float *im)
+{
+    int outputs = 0;
+    const float *coefs_re = this->coefs_re.data();
+    const float *coefs_im = this->coefs_im.data();
+    for (int i = 0; i < n; i++) {
+        this->history[this->pos] = in[i];
+        this->history[this->pos + this->taps] = in[i];
+        this->pos = (this->pos + 1) % this->taps;
+        if (this->countdown--) {
+            continue;
+        }
+        this->countdown = this->factor - 1;
+
+        // The oldest input first, the newest one last.
+        const float *x = &this->history[this->pos];
+        float sum_re = dot_product(coefs_re, x, this->taps);
+        float sum_im = dot_product(coefs_im, x, this->taps);
+
+        // Shift the band down, x[n] e^(-j 2 pi center n) once filtered.
+        double phase = 2.0 * M_PI * this->rotation;
+        float c = (float)cos(phase);
+        float s = (float)sin(phase);
+        re[outputs] = sum_re * c + sum_im * s;
+        im[outputs] = sum_im * c - sum_re * s;
+        outputs++;
+        this->rotation = fmod(this->rotation + this->center * this->factor, 1.0);
+    }
+    return outputs;
+}
+
+int ComplexDecimator::flush(float *re, float *im)
+{
+    std::vector<float> zeros((this->taps - 1) / 2);
+    return this->process(zeros.data(), zeros.size(), re, im);
+}
+
+Decimator::Decimator(int factor) :
+    factor(factor), taps(REAL_TAPS_PER_PHASE * factor + 1)
+{
+    // The transition band ends at the new Nyquist frequency, so what's above it is gone before
+    // it could fold back.
+    double transition = 3.7 / REAL_TAPS_PER_PHASE;
+    this->coefs = spek_lowpass(this->taps, (0.5 - transition / 2.0) / factor);
+    this->history.resize(2 * this->taps);
+    this->reset();
+}
+
+int Decimator::get_delay() const
+{
+    return (this->taps - 1) / 2 / this->factor;
+}
+
+void Decimator::reset()
+{
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    this->pos = 0;
+    this->countdown = (this->taps - 1) / 2;
+}
+
+int Decimator::process(const float *in, int n, float *out)
+{
+    int outputs = 0;
+    for (int i = 0; i < n; i++) {
+        this->history[this->pos] = in[i];
+        this->history[this->pos + this->taps] = in[i];
+        this->pos = (this->pos + 1) % this->taps;
+        if (this->countdown--) {
+            continue;
+        }
+        this->countdown = this->factor - 1;
+        // The filter is symmetric, no need to reverse it.
+        out[outputs++] = dot_product(this->coefs.data(), &this->history[this->pos], this->taps);
+    }
+    return outputs;
+}
+
+int Decimator::flush(float *out)
+{
+    std::vector<float> zeros((this->taps - 1) / 2);
+    return this->process(zeros.data(), zeros.size(), out);
+}
+
+Interpolator::Interpolator(int factor) :
+    factor(factor), taps(INTERPOLATOR_TAPS_PER_PHASE)
+{
+    // Cut off at the input's Nyquist frequency, the gain makes up for the zeros in between.
+    std::vector<float> lowpass = spek_lowpass(this->taps * factor, 0.5 / factor);
+    this->coefs.resize(this->taps * factor);
+    for (int phase = 0; phase < factor; phase++) {
+        for (int k = 0; k < this->taps; k++) {
+            this->coefs[phase * this->taps + this->taps - 1 - k] =
+                lowpass[phase + k * factor] * factor;
+        }
+    }
+    this->history.resize(2 * this->taps);
+    this->reset();
+}
+
+void Interpolator::reset()
+{
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    this->pos = 0;
+}
+
+void Interpolator::process(const float *in, int n, int stride, float *out)
+{
+    for (int i = 0; i < n; i++) {
+        float value = in[(size_t)i * stride];
+        this->history[this->pos] = value;
+        this->history[this->pos + this->taps] = value;
+        this->pos = (this->pos + 1) % this->taps;
+        // The oldest input first, the newest one last.
+        const float *x = &this->history[this->pos];
+        for (int phase = 0; phase < this->factor; phase++) {
+            *out++ = dot_product(&this->coefs[phase * this->taps], x, this->taps);
+        }
+    }
+}
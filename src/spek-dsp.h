@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+// Shifts the band of a real signal around `center` down to 0 Hz and decimates it by `factor`
+// as a complex signal, so that an FFT of the output looks at the band alone with `factor` times
+// finer bands. Only one in `factor` outputs of the anti-aliasing filter is computed and the
+// mix-down is folded into its taps, so the work per input sample doesn't grow with the factor.
+class ComplexDecimator
+{
+public:
+    // `center` is in cycles per input sample, i.e. the frequency divided by the sample rate.
+    // The output passes the frequencies within a quarter of the output rate of `center`.
+    ComplexDecimator(int factor, double center);
+
+    int get_factor() const { return this->factor; }
+
+    // Filter `n` input samples and write one complex output per `factor` of them into `re` and
+    // `im`, which must have room for n / factor + 1 values. Returns the number of outputs.
+    int process(const float *in, int n, float *re, float *im);
+    // Push the filter delay out after the last input, `re` and `im` must have room for
+    // get_delay() + 1 values. The outputs then line up with the inputs, one per `factor`.
+    int flush(float *re, float *im);
+    // The delay of the filter, in outputs.
+    int get_delay() const;
+    void reset();
+
+private:
+    int factor;
+    double center;
+    int taps;
+    std::vector<float> coefs_re; // The band-pass taps, reversed to run along the history.
+    std::vector<float> coefs_im;
+    std::vector<float> history; // The last `taps` inputs, twice so that they are contiguous.
+    int pos;
+    int countdown; // Inputs until the next output.
+    double rotation; // Phase of the mix-down at the next output, in cycles.
+};
+
+// Low-pass filters and decimates a real signal by `factor`, to skip the ultrasonic content of
+// high sample rates nobody looks at. The top of the new band rolls off from about 3/4 of its
+// Nyquist frequency so that nothing above it can fold back in.
+class Decimator
+{
+public:
+    Decimator(int factor);
+
+    int get_factor() const { return this->factor; }
+
+    // Same as ComplexDecimator::process() for a real output.
+    int process(const float *in, int n, float *out);
+    int flush(float *out);
+    int get_delay() const;
+    void reset();
+
+private:
+    int factor;
+    int taps;
+    std::vector<float> coefs;
+    std::vector<float> history;
+    int pos;
+    int countdown;
+};
+
+// Upsamples a real signal by `factor`, e.g. to find the peaks between its samples. The outputs
+// for each input are the phases of one low-pass filter, each a short branch of its taps run
+// along the same inputs, so the filter is never computed for the zeros stuffed in between.
+class Interpolator
+{
+public:
+    Interpolator(int factor);
+
+    int get_factor() const { return this->factor; }
+
+    // Filter `n` inputs `stride` values apart, e.g. one channel of interleaved samples, and
+    // write `factor` outputs per input into `out`. They lag about get_delay() inputs behind.
+    void process(const float *in, int n, int stride, float *out);
+    int get_delay() const { return this->taps / 2; }
+    void reset();
+
+private:
+    int factor;
+    int taps; // Per phase.
+    std::vector<float> coefs; // The phases one after another, each reversed.
+    std::vector<float> history; // The last `taps` inputs, twice so that they are contiguous.
+    int pos;
+};
+
+// The taps of a windowed-sinc low-pass filter, `cutoff` is in cycles per sample.
+std::vector<float> spek_lowpass(int taps, double cutoff);
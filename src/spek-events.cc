@@ -3,17 +3,38 @@
 //IMPLEMENT_DYNAMIC_CLASS(SpekHaveSampleEvent, wxEvent)
 DEFINE_EVENT_TYPE(SPEK_HAVE_SAMPLE)
 
-SpekHaveSampleEvent::SpekHaveSampleEvent(int bands, int sample, float *values, bool free_values)
-    : wxEvent(), bands(bands), sample(sample), values(values), free_values(free_values)
+SpekHaveSampleEvent::SpekHaveSampleEvent(
+    int view, int bands, int sample, float *values, bool free_values, bool approximate,
+    const uint8_t *pixels, int colors, const spek_envelope *envelope
+) :
+    wxEvent(), view(view), bands(bands), sample(sample), values(values), free_values(free_values),
+    approximate(approximate), pixels((uint8_t *)pixels), free_pixels(false), colors(colors),
+    envelope(), has_envelope(envelope != NULL)
 {
     SetEventType(SPEK_HAVE_SAMPLE);
+    if (envelope) {
+        this->envelope = *envelope;
+    }
 }
 
 SpekHaveSampleEvent::SpekHaveSampleEvent(const SpekHaveSampleEvent& other) : wxEvent(other)
 {
     SetEventType(SPEK_HAVE_SAMPLE);
+    this->view = other.view;
     this->bands = other.bands;
     this->sample = other.sample;
+    this->approximate = other.approximate;
+    this->colors = other.colors;
+    this->envelope = other.envelope;
+    this->has_envelope = other.has_envelope;
+    if (other.pixels) {
+        this->pixels = (uint8_t *)malloc(3 * this->bands);
+        memcpy(this->pixels, other.pixels, 3 * this->bands);
+        this->free_pixels = true;
+    } else {
+        this->pixels = NULL;
+        this->free_pixels = false;
+    }
     if (other.values) {
         this->values = (float *)malloc(this->bands * sizeof(float));
         memcpy(this->values, other.values, this->bands * sizeof(float));
@@ -29,4 +50,7 @@ SpekHaveSampleEvent::~SpekHaveSampleEvent()
     if (this->free_values) {
         free(this->values);
     }
+    if (this->free_pixels) {
+        free(this->pixels);
+    }
 }
@@ -2,24 +2,45 @@
 
 #include <wx/wx.h>
 
+#include "spek-pipeline.h"
+
 class SpekHaveSampleEvent: public wxEvent
 {
 public:
-    SpekHaveSampleEvent(int bands, int sample, float *values, bool free_values);
+    SpekHaveSampleEvent(
+        int view, int bands, int sample, float *values, bool free_values, bool approximate,
+        const uint8_t *pixels = NULL, int colors = -1, const spek_envelope *envelope = NULL
+    );
     SpekHaveSampleEvent(const SpekHaveSampleEvent& other);
     ~SpekHaveSampleEvent();
 
+    int get_view() const { return this->view; }
     int get_bands() const { return this->bands; }
     int get_sample() const { return this->sample; }
     const float *get_values() const { return this->values; }
+    bool is_approximate() const { return this->approximate; }
+    // The column colourised by the map with the `colors` id, 3 bytes per value from the top.
+    const uint8_t *get_pixels() const { return this->pixels; }
+    int get_colors() const { return this->colors; }
+    // The waveform of the column's samples, NULL for previews.
+    const spek_envelope *get_envelope() const {
+        return this->has_envelope ? &this->envelope : NULL;
+    }
 
     wxEvent *Clone() const { return new SpekHaveSampleEvent(*this); }
 
 private:
+    int view;
     int bands;
     int sample;
     float *values;
     bool free_values;
+    bool approximate;
+    uint8_t *pixels;
+    bool free_pixels;
+    int colors;
+    spek_envelope envelope;
+    bool has_envelope;
 };
 
 typedef void (wxEvtHandler::*SpekHaveSampleEventFunction)(SpekHaveSampleEvent&);
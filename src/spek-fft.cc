@@ -19,11 +19,28 @@ private:
     struct RDFTContext *cx;
 };
 
+class ComplexFFTPlanImpl : public FFTPlan
+{
+public:
+    ComplexFFTPlanImpl(int nbits);
+    ~ComplexFFTPlanImpl() override;
+
+    void execute() override;
+
+private:
+    struct FFTContext *cx;
+};
+
 std::unique_ptr<FFTPlan> FFT::create(int nbits)
 {
     return std::unique_ptr<FFTPlan>(new FFTPlanImpl(nbits));
 }
 
+std::unique_ptr<FFTPlan> FFT::create_complex(int nbits)
+{
+    return std::unique_ptr<FFTPlan>(new ComplexFFTPlanImpl(nbits));
+}
+
 FFTPlanImpl::FFTPlanImpl(int nbits) : FFTPlan(nbits), cx(av_rdft_init(nbits, DFT_R2C))
 {
 }
@@ -48,3 +65,28 @@ void FFTPlanImpl::execute()
         this->set_output(i, 10.0f * log10f((re * re + im * im) / n2));
     }
 }
+
+ComplexFFTPlanImpl::ComplexFFTPlanImpl(int nbits) :
+    FFTPlan(nbits, true), cx(av_fft_init(nbits, 0))
+{
+}
+
+ComplexFFTPlanImpl::~ComplexFFTPlanImpl()
+{
+    av_fft_end(this->cx);
+}
+
+void ComplexFFTPlanImpl::execute()
+{
+    FFTComplex *z = (FFTComplex*)this->get_input();
+    av_fft_permute(this->cx, z);
+    av_fft_calc(this->cx, z);
+
+    // Calculate magnitudes, the negative frequencies are in the upper half.
+    int n = this->get_input_size();
+    float n2 = n * n;
+    for (int i = 0; i < this->get_output_size(); i++) {
+        const FFTComplex& c = z[(i - n / 4 + n) % n];
+        this->set_output(i, 10.0f * log10f((c.re * c.re + c.im * c.im) / n2));
+    }
+}
@@ -15,18 +15,20 @@ class FFT
 public:
     FFT() {}
     std::unique_ptr<FFTPlan> create(int nbits);
+    // A transform of complex input, see FFTPlan::set_input(int, float, float).
+    std::unique_ptr<FFTPlan> create_complex(int nbits);
 };
 
 class FFTPlan
 {
 public:
-    FFTPlan(int nbits) :
-        input_size(1 << nbits), output_size((1 << (nbits - 1)) + 1),
+    FFTPlan(int nbits, bool complex = false) :
+        input_size(1 << nbits), output_size((1 << (nbits - 1)) + 1), complex(complex),
         output(output_size)
     {
         // FFmpeg uses various assembly optimizations which expect
         // input data to be aligned by up to 32 bytes (e.g. AVX)
-        this->input = (float*) av_malloc(sizeof(float) * input_size);
+        this->input = (float*) av_malloc(sizeof(float) * input_size * (complex ? 2 : 1));
     }
 
     virtual ~FFTPlan()
@@ -38,6 +40,14 @@ public:
     int get_output_size() const { return this->output_size; }
     float get_input(int i) const { return this->input[i]; }
     void set_input(int i, float v) { this->input[i] = v; }
+    // Complex plans take `input_size` complex values and give the same number of bands as the
+    // real ones, for the middle half of the spectrum: from -1/4 to 1/4 of the sample rate.
+    bool is_complex() const { return this->complex; }
+    void set_input(int i, float re, float im)
+    {
+        this->input[2 * i] = re;
+        this->input[2 * i + 1] = im;
+    }
     float get_output(int i) const { return this->output[i]; }
     void set_output(int i, float v) { this->output[i] = v; }
 
@@ -49,6 +59,7 @@ protected:
 private:
     int input_size;
     int output_size;
+    bool complex;
     float *input;
     std::vector<float> output;
 };
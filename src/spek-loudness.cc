@@ -0,0 +1,255 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "spek-dsp.h"
+
+#include "spek-loudness.h"
+
+enum
+{
+    MOMENTARY_BLOCKS = 4, // 100 ms blocks per gating block.
+    SHORT_TERM_BLOCKS = 30, // Per short-term block of the loudness range.
+    TRUE_PEAK_RATE = 192000, // At least, for the true peak.
+    MAX_TRUE_PEAK_FACTOR = 4,
+};
+
+// LUFS, the blocks below it don't count at all.
+static const double ABSOLUTE_GATE = -70.0;
+// LU below the loudness of the blocks above the absolute gate, for the integrated loudness and
+// for the loudness range.
+static const double RELATIVE_GATE = -10.0;
+static const double RANGE_GATE = -20.0;
+// The percentiles of the short-term loudness the range goes between.
+static const double RANGE_LOW = 0.10;
+static const double RANGE_HIGH = 0.95;
+
+// Forward declarations.
+static double loudness(double power);
+static void biquad(const double *coefs, double *z, double *x);
+
+LoudnessAnalyzer::LoudnessAnalyzer() :
+    block_size(0), block_samples(0), block_sum(0.0), peak(0.0f),
+    integrated(-INFINITY), range(0.0)
+{}
+
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{}
+
+void LoudnessAnalyzer::start(const AnalyzerFormat& format)
+{
+    Analyzer::start(format);
+    double rate = format.sample_rate;
+
+    // The high shelf modelling the head, then the high-pass of the RLB weighting, with the
+    // parameters of the filters BS.1770 gives for 48 kHz.
+    double k = tan(M_PI * 1681.974450955533 / rate);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    this->coefs[0][0] = (vh + vb * k / q + k * k) / a0;
+    this->coefs[0][1] = 2.0 * (k * k - vh) / a0;
+    this->coefs[0][2] = (vh - vb * k / q + k * k) / a0;
+    this->coefs[0][3] = 2.0 * (k * k - 1.0) / a0;
+    this->coefs[0][4] = (1.0 - k / q + k * k) / a0;
+
+    k = tan(M_PI * 38.13547087602444 / rate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    this->coefs[1][0] = 1.0;
+    this->coefs[1][1] = -2.0;
+    this->coefs[1][2] = 1.0;
+    this->coefs[1][3] = 2.0 * (k * k - 1.0) / a0;
+    this->coefs[1][4] = (1.0 - k / q + k * k) / a0;
+
+    int factor = 1;
+    while (factor < MAX_TRUE_PEAK_FACTOR && rate * factor < TRUE_PEAK_RATE) {
+        factor *= 2;
+    }
+    this->channels.clear();
+    this->channels.resize(format.channels);
+    for (int c = 0; c < format.channels; c++) {
+        Channel& channel = this->channels[c];
+        // The surround channels of 5.0 and 5.1 count more, the LFE not at all, the others the
+        // same whatever they are.
+        channel.weight = 1.0;
+        if ((format.channels == 5 && c >= 3) || (format.channels == 6 && c >= 4)) {
+            channel.weight = 1.41;
+        } else if (format.channels == 6 && c == 3) {
+            channel.weight = 0.0;
+        }
+        std::fill(channel.z, channel.z + 4, 0.0);
+        channel.interpolator.reset(new Interpolator(factor));
+    }
+
+    this->block_size = (int)lround(rate / 10.0);
+    this->block_samples = 0;
+    this->block_sum = 0.0;
+    this->blocks.clear();
+    this->peak = 0.0f;
+    this->integrated = -INFINITY;
+    this->range = 0.0;
+}
+
+void LoudnessAnalyzer::process_channels(const float *samples, int n)
+{
+    int count = this->channels.size();
+    if (!count || this->block_size <= 0) {
+        return;
+    }
+    this->squares.assign(n, 0.0);
+    this->upsampled.resize((size_t)n * MAX_TRUE_PEAK_FACTOR);
+    for (int c = 0; c < count; c++) {
+        Channel& channel = this->channels[c];
+        if (channel.weight > 0.0) {
+            for (int i = 0; i < n; i++) {
+                double x = samples[(size_t)i * count + c];
+                biquad(this->coefs[0], channel.z, &x);
+                biquad(this->coefs[1], channel.z + 2, &x);
+                this->squares[i] += channel.weight * x * x;
+            }
+        }
+
+        int outputs = n * channel.interpolator->get_factor();
+        channel.interpolator->process(samples + c, n, count, this->upsampled.data());
+        for (int i = 0; i < outputs; i++) {
+            this->peak = fmaxf(this->peak, fabsf(this->upsampled[i]));
+        }
+        // The filter rounds off the peaks that are on the samples.
+        for (int i = 0; i < n; i++) {
+            this->peak = fmaxf(this->peak, fabsf(samples[(size_t)i * count + c]));
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        this->block_sum += this->squares[i];
+        if (++this->block_samples == this->block_size) {
+            this->blocks.push_back(this->block_sum / this->block_size);
+            this->block_samples = 0;
+            this->block_sum = 0.0;
+        }
+    }
+}
+
+void LoudnessAnalyzer::finish()
+{
+    // The gating blocks overlap by 75%, one per 100 ms block.
+    std::vector<double> momentary;
+    double sum = 0.0;
+    for (size_t i = 0; i < this->blocks.size(); i++) {
+        sum += this->blocks[i];
+        if (i >= MOMENTARY_BLOCKS) {
+            sum -= this->blocks[i - MOMENTARY_BLOCKS];
+        }
+        if (i + 1 >= MOMENTARY_BLOCKS) {
+            momentary.push_back(sum / MOMENTARY_BLOCKS);
+        }
+    }
+    std::vector<double> short_term;
+    sum = 0.0;
+    for (size_t i = 0; i < this->blocks.size(); i++) {
+        sum += this->blocks[i];
+        if (i >= SHORT_TERM_BLOCKS) {
+            sum -= this->blocks[i - SHORT_TERM_BLOCKS];
+        }
+        if (i + 1 >= SHORT_TERM_BLOCKS) {
+            short_term.push_back(sum / SHORT_TERM_BLOCKS);
+        }
+    }
+
+    // The mean power of the blocks above the absolute gate, then of those above the relative
+    // gate below that.
+    double gated = 0.0;
+    int gated_count = 0;
+    for (double power : momentary) {
+        if (loudness(power) > ABSOLUTE_GATE) {
+            gated += power;
+            gated_count++;
+        }
+    }
+    if (gated_count) {
+        double threshold = loudness(gated / gated_count) + RELATIVE_GATE;
+        gated = 0.0;
+        gated_count = 0;
+        for (double power : momentary) {
+            if (loudness(power) > ABSOLUTE_GATE && loudness(power) > threshold) {
+                gated += power;
+                gated_count++;
+            }
+        }
+        this->integrated = gated_count ? loudness(gated / gated_count) : -INFINITY;
+    }
+
+    // The spread of the short-term loudness, without the quiet parts.
+    gated = 0.0;
+    gated_count = 0;
+    for (double power : short_term) {
+        if (loudness(power) > ABSOLUTE_GATE) {
+            gated += power;
+            gated_count++;
+        }
+    }
+    this->range = 0.0;
+    if (gated_count) {
+        double threshold = loudness(gated / gated_count) + RANGE_GATE;
+        std::vector<double> levels;
+        for (double power : short_term) {
+            double level = loudness(power);
+            if (level > ABSOLUTE_GATE && level > threshold) {
+                levels.push_back(level);
+            }
+        }
+        if (!levels.empty()) {
+            std::sort(levels.begin(), levels.end());
+            size_t last = levels.size() - 1;
+            double high = levels[(size_t)lround(RANGE_HIGH * last)];
+            double low = levels[(size_t)lround(RANGE_LOW * last)];
+            this->range = high - low;
+        }
+    }
+}
+
+double LoudnessAnalyzer::get_true_peak() const
+{
+    return spek_analyzer_db(this->peak);
+}
+
+std::vector<AnalyzerResult> LoudnessAnalyzer::get_results() const
+{
+    return {
+        { "integrated_loudness", this->integrated, "LUFS" },
+        { "loudness_range", this->range, "LU" },
+        { "true_peak", this->get_true_peak(), "dBTP" },
+    };
+}
+
+std::string LoudnessAnalyzer::get_summary() const
+{
+    if (std::isinf(this->integrated)) {
+        return std::string();
+    }
+    char s[64];
+    snprintf(
+        s, sizeof(s), "%.1f LUFS, LRA %.1f LU, %.1f dBTP",
+        this->integrated, this->range, this->get_true_peak()
+    );
+    return s;
+}
+
+// The loudness in LUFS of a weighted mean square.
+static double loudness(double power)
+{
+    return power > 0.0 ? -0.691 + 10.0 * log10(power) : -INFINITY;
+}
+
+// One sample through a biquad in the transposed direct form II.
+static void biquad(const double *coefs, double *z, double *x)
+{
+    double in = *x;
+    double out = coefs[0] * in + z[0];
+    z[0] = coefs[1] * in - coefs[3] * out + z[1];
+    z[1] = coefs[2] * in - coefs[4] * out;
+    *x = out;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "spek-analyzer.h"
+
+class Interpolator;
+
+// Loudness as broadcasters measure it, after ITU-R BS.1770 and EBU R 128: the integrated
+// loudness in LUFS, the loudness range in LU and the true peak in dBTP, of all the channels.
+//
+// The samples go through the K-weighting filters and their mean square is kept per 100 ms, the
+// 400 ms gating blocks and the 3 s short-term blocks of the loudness range are then put
+// together from those at the end. The true peak is the largest sample once upsampled to at
+// least 192 kHz, which catches the peaks a DAC reconstructs between the samples.
+class LoudnessAnalyzer : public Analyzer
+{
+public:
+    LoudnessAnalyzer();
+    ~LoudnessAnalyzer();
+
+    std::string get_name() const { return "loudness"; }
+    bool wants_all_channels() const { return true; }
+
+    void start(const AnalyzerFormat& format);
+    void process(const float *samples, int n) { (void)samples; (void)n; }
+    void process_channels(const float *samples, int n);
+    void finish();
+    std::vector<AnalyzerResult> get_results() const;
+    std::string get_summary() const;
+
+    // -inf for silence or files shorter than a gating block.
+    double get_integrated() const { return this->integrated; }
+    double get_range() const { return this->range; }
+    double get_true_peak() const;
+
+private:
+    // The state of the two K-weighting biquads of a channel.
+    struct Channel
+    {
+        double weight;
+        double z[4];
+        std::unique_ptr<Interpolator> interpolator;
+    };
+
+    double coefs[2][5]; // b0, b1, b2, a1, a2 of the shelving and the high-pass filter.
+    std::vector<Channel> channels;
+    int block_size; // Samples per 100 ms.
+    int block_samples; // Added to the current block so far.
+    double block_sum;
+    std::vector<double> blocks; // The weighted mean squares of the complete 100 ms blocks.
+    std::vector<double> squares; // Scratch space, the weighted squares of a run of samples.
+    std::vector<float> upsampled;
+    float peak;
+    double integrated;
+    double range;
+};
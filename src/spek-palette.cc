@@ -1,8 +1,16 @@
 #include <assert.h>
 #include <math.h>
 
+#include <atomic>
+
 #include "spek-palette.h"
 
+enum
+{
+    // Levels in the colour table, well beyond what the dynamic range can tell apart.
+    LEVELS = 4096,
+};
+
 // Modified version of Dan Bruton's algorithm:
 // http://www.physics.sfasu.edu/astro/color/spectra.html
 static uint32_t spectrum(double level)
@@ -95,3 +103,37 @@ uint32_t spek_palette(enum palette palette, double level) {
         return 0;
     }
 }
+
+ColorMap::ColorMap(enum palette palette, int lrange, int urange) :
+    palette(palette), lrange(lrange), urange(urange), table(3 * LEVELS)
+{
+    static std::atomic<int> next_id(0);
+    this->id = next_id++;
+    for (int i = 0; i < LEVELS; i++) {
+        uint32_t color = spek_palette(palette, i / (double)(LEVELS - 1));
+        this->table[3 * i] = color >> 16;
+        this->table[3 * i + 1] = (color >> 8) & 0xFF;
+        this->table[3 * i + 2] = color & 0xFF;
+    }
+}
+
+void ColorMap::apply(const float *values, int n, uint8_t *pixels) const
+{
+    float low = (float)this->lrange;
+    float high = (float)this->urange;
+    float scale = (LEVELS - 1) / (high - low);
+    for (int i = 0; i < n; i++) {
+        float value = values[n - i - 1];
+        // NaN and -inf (silence) end up at the bottom too.
+        int level = 0;
+        if (value >= high) {
+            level = LEVELS - 1;
+        } else if (value > low) {
+            level = (int)lrintf((value - low) * scale);
+        }
+        const uint8_t *color = &this->table[3 * level];
+        pixels[3 * i] = color[0];
+        pixels[3 * i + 1] = color[1];
+        pixels[3 * i + 2] = color[2];
+    }
+}
@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 enum palette {
     PALETTE_SPECTRUM,
     PALETTE_SOX,
@@ -11,3 +13,28 @@ enum palette {
 };
 
 uint32_t spek_palette(enum palette palette, double level);
+
+// The colours of a palette for the levels from `lrange` to `urange` dB, looked up in a table so
+// that whole columns can be colourised off the UI thread with a few operations per value.
+class ColorMap
+{
+public:
+    ColorMap(enum palette palette, int lrange, int urange);
+
+    // Unique to every map, to tell which one colourised a column.
+    int get_id() const { return this->id; }
+    enum palette get_palette() const { return this->palette; }
+    int get_lrange() const { return this->lrange; }
+    int get_urange() const { return this->urange; }
+
+    // Write the colours of `n` values into `pixels`, 3 bytes each, the last value first so that
+    // a column reads from the top of the image down.
+    void apply(const float *values, int n, uint8_t *pixels) const;
+
+private:
+    int id;
+    enum palette palette;
+    int lrange;
+    int urange;
+    std::vector<uint8_t> table; // RGB of evenly spaced levels.
+};
@@ -1,43 +1,152 @@
-#include <wx/intl.h>
-
 #include <assert.h>
+#include <errno.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <deque>
 #include <vector>
 
+#include "spek-analyzer.h"
 #include "spek-audio.h"
+#include "spek-dsp.h"
 #include "spek-fft.h"
+#include "spek-palette.h"
+#include "spek-trace.h"
+#include "spek-utils.h"
 
 #include "spek-pipeline.h"
 
-#define ngettext wxPLURAL
+// The messages for xgettext, translated by the program, see spek_set_translate(). The
+// strings only live until the end of the expression.
+#define _(s) spek_translate(s).c_str()
+#define ngettext(s, p, n) spek_translate(s, p, n).c_str()
 
 enum
 {
-    NFFT = 64 // Number of FFTs to pre-fetch.
+    NFFT = 64, // Number of FFTs to pre-fetch.
+    MAX_ZOOM = 256, // Largest decimation factor for a band, i.e. the narrowest band.
+    BACKGROUND_NICE = 19, // Of the threads in the background.
+    MAX_QUEUED = 16 << 20, // Bytes queued per analyzer before the reader waits for it to catch up.
+};
+
+struct spek_pipeline;
+
+// The columns the stream is split into, with the envelope of each. The pipeline's own, and
+// those of each spek_pipeline_add_columns() with another number of them.
+struct spek_intervals
+{
+    int samples;
+    // The columns in decoded frames, for the envelopes.
+    int64_t frames_per_interval;
+    int64_t error_per_interval;
+    int64_t error_base;
+    // The columns in input frames, which are fewer than the decoded ones if decimated.
+    int64_t input_frames_per_interval;
+    int64_t input_error_per_interval;
+    int64_t input_error_base;
+
+    // The envelope of each column, filled in by the reader from the decoded samples ahead of
+    // the workers, which pass it on with the column.
+    std::vector<spek_envelope> envelopes;
+    int envelope_sample; // The column being accumulated.
+    int64_t envelope_frames;
+    int64_t envelope_error;
+    float envelope_min;
+    float envelope_max;
+    double envelope_power;
+};
+
+// One FFT size fed from the shared input ring, with its own worker thread.
+struct spek_transform
+{
+    struct spek_pipeline *pipeline;
+    std::unique_ptr<FFTPlan> fft;
+    struct spek_intervals *intervals; // Owned by the pipeline.
+    spek_pipeline_cb cb; // Only for spek_pipeline_add_columns(), the pipeline's otherwise.
+    void *cb_data;
+
+    float *coss; // Pre-computed cos table.
+    int nfft; // Size of the FFT transform.
+    float *output;
+    float *reduced; // The output reduced to `rows` values.
+    ScaleKernel kernel; // From the output to the rows of a non-linear frequency axis.
+    uint8_t *pixels; // The colours of the rows, if colourised.
+
+    pthread_t thread;
+    bool has_thread;
+};
+
+// Decoded samples, or a column if `sample` isn't -1. Shared by all the stages, never changed.
+struct spek_block
+{
+    int sample;
+    std::shared_ptr<const std::vector<float>> values;
+};
+
+// An analyzer with its own thread, fed by the reader and the first worker through a queue.
+struct spek_stage
+{
+    struct spek_pipeline *pipeline;
+    std::shared_ptr<Analyzer> analyzer;
+    std::deque<spek_block> queue;
+    size_t queued; // Bytes in the queue.
+    bool closed; // Nothing more will be queued.
+
+    pthread_t thread;
+    bool has_thread;
+    pthread_mutex_t mutex;
+    bool has_mutex;
+    pthread_cond_t cond;
+    bool has_cond;
 };
 
 struct spek_pipeline
 {
     std::unique_ptr<AudioFile> file;
-    std::unique_ptr<FFTPlan> fft;
+    std::vector<std::unique_ptr<spek_transform>> transforms;
+    std::vector<std::unique_ptr<spek_stage>> stages;
     int stream;
     int channel;
     enum window_function window_function;
     int samples;
+    std::atomic<bool> background; // Followed by the threads as they go, see update_priority().
+    int rows;
+    enum reduce_function reduce_function;
+    enum frequency_scale scale;
     spek_pipeline_cb cb;
-    void *cb_data;
+    spek_pipeline_cb preview_cb;
+    spek_pipeline_pixels_cb pixels_cb;
+    std::shared_ptr<const ColorMap> colors; // Swapped by the client, guarded by the mutex.
+    pthread_mutex_t colors_mutex;
+    bool has_colors_mutex;
 
-    float *coss; // Pre-computed cos table.
-    int nfft; // Size of the FFT transform.
+    int nfft; // Size of the largest FFT transform.
     int input_size;
     int input_pos;
     float *input;
-    float *output;
+    float *input_im; // The imaginary parts of the input when zoomed into a band.
+
+    // Set when the sample rate is above the maximum, the decoded samples are decimated first.
+    std::unique_ptr<Decimator> rate_decimator;
+    std::vector<float> resampled;
+    // Set when zoomed into a band, which is then shifted down and decimated before the FFTs.
+    std::unique_ptr<ComplexDecimator> decimator;
+    std::vector<float> decimated_re;
+    std::vector<float> decimated_im;
+    double band_low;
+    double band_high;
+    std::vector<std::unique_ptr<spek_intervals>> intervals; // The pipeline's own first.
 
     pthread_t reader_thread;
     bool has_reader_thread;
@@ -45,20 +154,40 @@ struct spek_pipeline
     bool has_reader_mutex;
     pthread_cond_t reader_cond;
     bool has_reader_cond;
-    pthread_t worker_thread;
-    bool has_worker_thread;
     pthread_mutex_t worker_mutex;
     bool has_worker_mutex;
     pthread_cond_t worker_cond;
     bool has_worker_cond;
-    bool worker_done;
-    volatile bool quit;
+    int workers;
+    int workers_done;
+    std::atomic<bool> quit;
+    bool finished; // The whole file was read, set before the client is notified.
 };
 
 // Forward declarations.
 static void * reader_func(void *);
 static void * worker_func(void *);
+static void * stage_func(void *);
+static spek_block make_block(int sample, const float *values, int n);
+static void stage_push(struct spek_stage *s, const spek_block& block);
+static void reader_envelope(
+    struct spek_intervals *in, const float *buffer, int len, bool flush);
+static void stage_close(struct spek_stage *s);
 static void reader_sync(struct spek_pipeline *p, int pos);
+static void reader_feed(
+    struct spek_pipeline *p, const float *buffer, int len, int *pos, int *prev_pos);
+static void reader_push(
+    struct spek_pipeline *p, const float *re, const float *im, int len, int *pos, int *prev_pos);
+static struct spek_transform * transform_create(
+    struct spek_pipeline *p, std::unique_ptr<FFTPlan> fft, int samples, void *cb_data);
+static void transform_free(struct spek_transform *t);
+static void intervals_start(struct spek_pipeline *p, struct spek_intervals *in, int factor);
+static void update_priority(struct spek_pipeline *p, bool *lowered);
+static void preview(struct spek_pipeline *p);
+static int transform_rows(const struct spek_pipeline *p, const struct spek_transform *t);
+static int reduce(struct spek_pipeline *p, struct spek_transform *t, float **values);
+static void pass_on(struct spek_pipeline *p, struct spek_transform *t, int sample);
+static float get_window(enum window_function f, int i, float *coss, int n);
 
 struct spek_pipeline * spek_pipeline_open(
     std::unique_ptr<AudioFile> file,
@@ -71,56 +200,267 @@ struct spek_pipeline * spek_pipeline_open(
     void *cb_data
 )
 {
+    spek_trace_init();
+
     spek_pipeline *p = new spek_pipeline();
     p->file = std::move(file);
-    p->fft = std::move(fft);
     p->stream = stream;
     p->channel = channel;
     p->window_function = window_function;
     p->samples = samples;
+    p->background = false;
+    p->rows = 0;
+    p->reduce_function = REDUCE_MAX;
+    p->scale = SCALE_LINEAR;
     p->cb = cb;
-    p->cb_data = cb_data;
+    p->preview_cb = NULL;
+    p->pixels_cb = NULL;
+    // Unlike the others the map can be changed before the threads are started.
+    p->has_colors_mutex = !pthread_mutex_init(&p->colors_mutex, NULL);
 
-    p->coss = NULL;
+    p->nfft = 0;
     p->input = NULL;
-    p->output = NULL;
+    p->input_im = NULL;
+    p->band_low = 0.0;
+    p->band_high = p->file->get_sample_rate() / 2.0;
     p->has_reader_thread = false;
     p->has_reader_mutex = false;
     p->has_reader_cond = false;
-    p->has_worker_thread = false;
     p->has_worker_mutex = false;
     p->has_worker_cond = false;
 
+    spek_pipeline_add_fft(p, std::move(fft), cb_data);
+
     if (!p->file->get_error()) {
-        p->nfft = p->fft->get_input_size();
-        p->coss = (float*)malloc(p->nfft * sizeof(float));
-        float cf = 2.0f * (float)M_PI / (p->nfft - 1.0f);
-        for (int i = 0; i < p->nfft; ++i) {
-            p->coss[i] = cosf(cf * i);
-        }
-        p->input_size = p->nfft * (NFFT * 2 + 1);
-        p->input = (float*)malloc(p->input_size * sizeof(float));
-        p->output = (float*)malloc(p->fft->get_output_size() * sizeof(float));
         p->file->start(channel, samples);
     }
 
     return p;
 }
 
+void spek_pipeline_add_fft(struct spek_pipeline *p, std::unique_ptr<FFTPlan> fft, void *cb_data)
+{
+    transform_create(p, std::move(fft), p->samples, cb_data);
+}
+
+void spek_pipeline_add_columns(
+    struct spek_pipeline *p, std::unique_ptr<FFTPlan> fft, int samples,
+    spek_pipeline_cb cb, void *cb_data)
+{
+    spek_transform *t = transform_create(p, std::move(fft), samples, cb_data);
+    t->cb = cb;
+}
+
+// Add a transform counting in `samples` columns, with the same intervals as the others that do.
+static struct spek_transform * transform_create(
+    struct spek_pipeline *p, std::unique_ptr<FFTPlan> fft, int samples, void *cb_data)
+{
+    spek_transform *t = new spek_transform();
+    t->pipeline = p;
+    t->fft = std::move(fft);
+    t->intervals = NULL;
+    for (auto& in : p->intervals) {
+        if (in->samples == samples) {
+            t->intervals = in.get();
+        }
+    }
+    if (!t->intervals) {
+        t->intervals = new spek_intervals();
+        t->intervals->samples = samples;
+        p->intervals.push_back(std::unique_ptr<spek_intervals>(t->intervals));
+    }
+    t->cb = NULL;
+    t->cb_data = cb_data;
+    t->coss = NULL;
+    t->output = NULL;
+    t->reduced = NULL;
+    t->pixels = NULL;
+    t->has_thread = false;
+
+    if (!p->file->get_error()) {
+        t->nfft = t->fft->get_input_size();
+        t->coss = (float*)malloc(t->nfft * sizeof(float));
+        float cf = 2.0f * (float)M_PI / (t->nfft - 1.0f);
+        for (int i = 0; i < t->nfft; ++i) {
+            t->coss[i] = cosf(cf * i);
+        }
+        t->output = (float*)malloc(t->fft->get_output_size() * sizeof(float));
+        p->nfft = spek_max(p->nfft, t->nfft);
+    } else {
+        t->nfft = 0;
+    }
+
+    p->transforms.push_back(std::unique_ptr<spek_transform>(t));
+    return t;
+}
+
+void spek_pipeline_set_background(struct spek_pipeline *p, bool background)
+{
+    // The running threads pick it up before their next batch of work.
+    p->background = background;
+}
+
+bool spek_pipeline_can_restore_priority()
+{
+#ifdef __linux__
+    // Raising the nice value back is only allowed down to 20 - RLIMIT_NICE, and the limit is 0
+    // by default. CAP_SYS_NICE would allow it too, but isn't looked for.
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NICE, &limit) != 0) {
+        return false;
+    }
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, syscall(SYS_gettid));
+    if (errno) {
+        return false;
+    }
+    return limit.rlim_cur == RLIM_INFINITY || (rlim_t)(20 - nice) <= limit.rlim_cur;
+#else
+    return true;
+#endif
+}
+
+void spek_pipeline_set_preview(struct spek_pipeline *p, spek_pipeline_cb cb)
+{
+    p->preview_cb = cb;
+}
+
+void spek_pipeline_set_colors(struct spek_pipeline *p, spek_pipeline_pixels_cb cb)
+{
+    p->pixels_cb = cb;
+}
+
+void spek_pipeline_set_color_map(struct spek_pipeline *p, std::shared_ptr<const ColorMap> colors)
+{
+    if (!p->has_colors_mutex) {
+        return;
+    }
+    pthread_mutex_lock(&p->colors_mutex);
+    // The old map is released outside of the lock, the workers may still hold on to it.
+    p->colors.swap(colors);
+    pthread_mutex_unlock(&p->colors_mutex);
+}
+
+void spek_pipeline_add_analyzer(struct spek_pipeline *p, std::shared_ptr<Analyzer> analyzer)
+{
+    spek_stage *s = new spek_stage();
+    s->pipeline = p;
+    s->analyzer = analyzer;
+    s->closed = false;
+    s->queued = 0;
+    s->has_thread = false;
+    s->has_mutex = false;
+    s->has_cond = false;
+    p->stages.push_back(std::unique_ptr<spek_stage>(s));
+}
+
+void spek_pipeline_set_rows(struct spek_pipeline *p, int rows, enum reduce_function f)
+{
+    p->rows = rows > 0 ? rows : 0;
+    p->reduce_function = f;
+}
+
+void spek_pipeline_set_scale(struct spek_pipeline *p, enum frequency_scale scale)
+{
+    p->scale = scale;
+}
+
+void spek_pipeline_set_max_rate(struct spek_pipeline *p, int max_rate)
+{
+    int rate = p->file->get_sample_rate();
+    if (!!p->file->get_error() || max_rate <= 0 || rate <= max_rate) {
+        return;
+    }
+    p->rate_decimator.reset(new Decimator((rate + max_rate - 1) / max_rate));
+    p->band_high = rate / (double)p->rate_decimator->get_factor() / 2.0;
+}
+
+void spek_pipeline_set_band(struct spek_pipeline *p, double low, double high)
+{
+    double rate = p->file->get_sample_rate();
+    if (p->rate_decimator) {
+        rate /= p->rate_decimator->get_factor();
+    }
+    if (!!p->file->get_error() || !rate || high <= low) {
+        return;
+    }
+
+    // The complex FFTs show half of the decimated rate, so it has to be twice the band.
+    int factor = spek_min((int)(rate / (2.0 * (high - low))), MAX_ZOOM);
+    if (factor < 2) {
+        return;
+    }
+    double half = rate / factor / 4.0;
+    double center = fmin(fmax((low + high) / 2.0, half), rate / 2.0 - half);
+    p->band_low = center - half;
+    p->band_high = center + half;
+    p->decimator.reset(new ComplexDecimator(factor, center / rate));
+
+    for (auto& t : p->transforms) {
+        int nbits = 0;
+        while ((1 << nbits) < t->nfft) {
+            nbits++;
+        }
+        t->fft = FFT().create_complex(nbits);
+    }
+}
+
 void spek_pipeline_start(struct spek_pipeline *p)
 {
     if (!!p->file->get_error()) {
         return;
     }
 
+    double low, high;
+    spek_pipeline_band(p, &low, &high);
+    for (auto& t : p->transforms) {
+        if (t->cb) {
+            // Passed on whole.
+            continue;
+        }
+        int rows = transform_rows(p, t.get());
+        if (p->scale != SCALE_LINEAR) {
+            t->kernel.create(
+                p->scale, t->fft->get_output_size(), p->band_low, p->band_high, rows, low, high
+            );
+        }
+        if (p->scale != SCALE_LINEAR || rows < (int)t->fft->get_output_size()) {
+            t->reduced = (float*)malloc(rows * sizeof(float));
+        }
+        if (p->pixels_cb) {
+            t->pixels = (uint8_t*)malloc(3 * rows);
+        }
+    }
+
+    // All the workers consume the same chunks, so the ring is sized for the largest transform.
+    p->input_size = p->nfft * (NFFT * 2 + 1);
+    p->input = (float*)malloc(p->input_size * sizeof(float));
+    if (p->decimator) {
+        p->input_im = (float*)malloc(p->input_size * sizeof(float));
+    }
     p->input_pos = 0;
-    p->worker_done = false;
+    p->workers = 0;
+    p->workers_done = 0;
     p->quit = false;
+    p->finished = false;
+    int factor =
+        (p->rate_decimator ? p->rate_decimator->get_factor() : 1) *
+        (p->decimator ? p->decimator->get_factor() : 1);
+    // Decode as much as the workers consume per wake-up without decimating. The decimators then
+    // pass on fewer frames per read, the workers are woken up once there are enough.
+    p->file->set_batch_size(p->nfft * NFFT);
+    for (auto& in : p->intervals) {
+        intervals_start(p, in.get(), factor);
+    }
 
     p->has_reader_mutex = !pthread_mutex_init(&p->reader_mutex, NULL);
     p->has_reader_cond = !pthread_cond_init(&p->reader_cond, NULL);
     p->has_worker_mutex = !pthread_mutex_init(&p->worker_mutex, NULL);
     p->has_worker_cond = !pthread_cond_init(&p->worker_cond, NULL);
+    for (auto& s : p->stages) {
+        s->has_mutex = !pthread_mutex_init(&s->mutex, NULL);
+        s->has_cond = !pthread_cond_init(&s->cond, NULL);
+    }
 
     p->has_reader_thread = !pthread_create(&p->reader_thread, NULL, &reader_func, p);
     if (!p->has_reader_thread) {
@@ -129,9 +469,16 @@ void spek_pipeline_start(struct spek_pipeline *p)
 }
 
 void spek_pipeline_close(struct spek_pipeline *p)
+{
+    spek_pipeline_release(p);
+}
+
+std::unique_ptr<AudioFile> spek_pipeline_release(struct spek_pipeline *p)
 {
     if (p->has_reader_thread) {
+        // The reader may be deep inside the decoder, the workers check the flag between FFTs.
         p->quit = true;
+        p->file->interrupt();
         pthread_join(p->reader_thread, NULL);
         p->has_reader_thread = false;
     }
@@ -151,25 +498,86 @@ void spek_pipeline_close(struct spek_pipeline *p)
         pthread_mutex_destroy(&p->reader_mutex);
         p->has_reader_mutex = false;
     }
-    if (p->output) {
-        free(p->output);
-        p->output = NULL;
+    for (auto& s : p->stages) {
+        if (s->has_cond) {
+            pthread_cond_destroy(&s->cond);
+            s->has_cond = false;
+        }
+        if (s->has_mutex) {
+            pthread_mutex_destroy(&s->mutex);
+            s->has_mutex = false;
+        }
     }
+    p->stages.clear();
     if (p->input) {
         free(p->input);
         p->input = NULL;
     }
-    if (p->coss) {
-        free(p->coss);
-        p->coss = NULL;
+    if (p->input_im) {
+        free(p->input_im);
+        p->input_im = NULL;
     }
+    for (auto& t : p->transforms) {
+        transform_free(t.get());
+    }
+    p->transforms.clear();
 
-    p->file.reset();
+    std::unique_ptr<AudioFile> file = std::move(p->file);
+    if (p->has_colors_mutex) {
+        pthread_mutex_destroy(&p->colors_mutex);
+        p->has_colors_mutex = false;
+    }
 
     delete p;
+
+    spek_trace_flush();
+
+    return file;
+}
+
+// Count the frames of the columns the way the file does for the pipeline's own, and again after
+// the decimation, there are `factor` times fewer then.
+static void intervals_start(struct spek_pipeline *p, struct spek_intervals *in, int factor)
+{
+    // The file's base is the pipeline's columns times the denominator of its time base, and the
+    // total the frames times that denominator.
+    int64_t total = p->file->get_frames_per_interval() * p->file->get_error_base() +
+        p->file->get_error_per_interval();
+    in->error_base = p->file->get_error_base() / p->samples * in->samples;
+    in->frames_per_interval = total / in->error_base;
+    in->error_per_interval = total % in->error_base;
+    in->input_error_base = in->error_base * (int64_t)factor;
+    in->input_frames_per_interval = total / in->input_error_base;
+    in->input_error_per_interval = total % in->input_error_base;
+
+    in->envelopes.assign(in->samples, spek_envelope());
+    in->envelope_sample = 0;
+    in->envelope_frames = 0;
+    in->envelope_error = 0;
+}
+
+static void transform_free(struct spek_transform *t)
+{
+    if (t->reduced) {
+        free(t->reduced);
+        t->reduced = NULL;
+    }
+    if (t->pixels) {
+        free(t->pixels);
+        t->pixels = NULL;
+    }
+    if (t->output) {
+        free(t->output);
+        t->output = NULL;
+    }
+    if (t->coss) {
+        free(t->coss);
+        t->coss = NULL;
+    }
+    t->fft.reset();
 }
 
-std::string spek_pipeline_desc(const struct spek_pipeline *pipeline)
+std::string spek_pipeline_desc(const struct spek_pipeline *pipeline, int fft)
 {
     std::vector<std::string> items;
 
@@ -178,38 +586,68 @@ std::string spek_pipeline_desc(const struct spek_pipeline *pipeline)
     }
 
     if (pipeline->file->get_bit_rate()) {
-        items.push_back(std::string(
-            wxString::Format(_("%d kbps"), (pipeline->file->get_bit_rate() + 500) / 1000).utf8_str()
-        ));
+        items.push_back(
+            spek_format(_("%d kbps"), (pipeline->file->get_bit_rate() + 500) / 1000)
+        );
     }
 
     if (pipeline->file->get_sample_rate()) {
-        items.push_back(std::string(
-            wxString::Format(_("%d Hz"), pipeline->file->get_sample_rate()).utf8_str()
-        ));
+        items.push_back(spek_format(_("%d Hz"), pipeline->file->get_sample_rate()));
     }
 
     // Include bits per sample only if there is no bitrate.
     if (pipeline->file->get_bits_per_sample() && !pipeline->file->get_bit_rate()) {
-        items.push_back(std::string(
-            wxString::Format(
-                ngettext("%d bit", "%d bits", pipeline->file->get_bits_per_sample()),
-                pipeline->file->get_bits_per_sample()
-            ).utf8_str()
+        items.push_back(spek_format(
+            ngettext("%d bit", "%d bits", pipeline->file->get_bits_per_sample()),
+            pipeline->file->get_bits_per_sample()
         ));
     }
 
+    // Padded or upsampled recordings leave the low bits unused, which only shows once read.
+    const SampleBits *sample_bits = spek_pipeline_sample_bits(pipeline);
+    if (sample_bits && pipeline->channel < sample_bits->get_channels()) {
+        int bits = sample_bits->get_effective_bits(pipeline->channel);
+        int declared = pipeline->file->get_bits_per_sample();
+        if (bits && declared && bits < declared) {
+            items.push_back(spek_format(_("%d bits effective"), bits));
+        }
+    }
+
+    // Measurements of the whole file, such as its loudness.
+    if (pipeline->finished) {
+        for (const auto& s : pipeline->stages) {
+            std::string summary = s->analyzer->get_summary();
+            if (!summary.empty()) {
+                items.push_back(summary);
+            }
+        }
+    }
+
+    // An album or a cue sheet read as one.
+    int tracks = pipeline->file->get_track_starts().size() + 1;
+    if (tracks > 1) {
+        items.push_back(spek_format(ngettext("%d track", "%d tracks", tracks), tracks));
+    }
+
     if (pipeline->file->get_channels()) {
-        items.push_back(std::string(
-            wxString::Format(
-                // TRANSLATORS: first %d is the current channel, second %d is the total number.
-                "channel %d / %d", pipeline->channel + 1, pipeline->file->get_channels()
-            ).utf8_str()
+        items.push_back(spek_format(
+            // TRANSLATORS: first %d is the current channel, second %d is the total number.
+            "channel %d / %d", pipeline->channel + 1, pipeline->file->get_channels()
         ));
     }
 
     if (pipeline->file->get_error() == AudioError::OK) {
-        items.push_back(std::string(wxString::Format(wxT("W:%i"), pipeline->nfft).utf8_str()));
+        const spek_transform *t = pipeline->transforms[fft].get();
+        if (pipeline->transforms.size() > 1) {
+            // Let the user know what keeping the other sizes around costs.
+            items.push_back(spek_format(
+                "W:%i (%.1f MiB)",
+                t->nfft,
+                spek_pipeline_fft_memory(pipeline, fft) / (1024.0 * 1024.0)
+            ));
+        } else {
+            items.push_back(spek_format("W:%i", t->nfft));
+        }
 
         std::string window_function_name;
         switch (pipeline->window_function) {
@@ -238,58 +676,114 @@ std::string spek_pipeline_desc(const struct spek_pipeline *pipeline)
         desc.append(item);
     }
 
-    wxString error;
+    std::string error_string;
     switch (pipeline->file->get_error()) {
     case AudioError::CANNOT_OPEN_FILE:
-        error = _("Cannot open input file");
+        error_string = _("Cannot open input file");
         break;
     case AudioError::NO_STREAMS:
-        error = _("Cannot find stream info");
+        error_string = _("Cannot find stream info");
         break;
     case AudioError::NO_AUDIO:
-        error = _("The file contains no audio streams");
+        error_string = _("The file contains no audio streams");
         break;
     case AudioError::NO_DECODER:
-        error = _("Cannot find decoder");
+        error_string = _("Cannot find decoder");
         break;
     case AudioError::NO_DURATION:
-        error = _("Unknown duration");
+        error_string = _("Unknown duration");
         break;
     case AudioError::NO_CHANNELS:
-        error = _("No audio channels");
+        error_string = _("No audio channels");
         break;
     case AudioError::CANNOT_OPEN_DECODER:
-        error = _("Cannot open decoder");
+        error_string = _("Cannot open decoder");
         break;
     case AudioError::BAD_SAMPLE_FORMAT:
-        error = _("Unsupported sample format");
+        error_string = _("Unsupported sample format");
+        break;
+    case AudioError::MIXED_FORMATS:
+        error_string = _("The tracks have different sample rates or channels");
         break;
     case AudioError::OK:
         break;
     }
 
-    auto error_string = std::string(error.utf8_str());
     if (desc.empty()) {
         desc = error_string;
-    } else if (pipeline->stream < pipeline->file->get_streams()) {
-        desc = std::string(
-            wxString::Format(
-                // TRANSLATORS: first %d is the stream number, second %d is the
-                // total number of streams, %s is the stream description.
-                _("Stream %d / %d: %s"),
-                pipeline->stream + 1, pipeline->file->get_streams(), desc.c_str()
-            ).utf8_str()
+    } else if (pipeline->stream < pipeline->file->get_streams() && error_string.empty()) {
+        desc = spek_format(
+            // TRANSLATORS: first %d is the stream number, second %d is the
+            // total number of streams, %s is the stream description.
+            _("Stream %d / %d: %s"),
+            pipeline->stream + 1, pipeline->file->get_streams(), desc.c_str()
         );
     } else if (!error_string.empty()) {
-        desc = std::string(
-            // TRANSLATORS: first %s is the error message, second %s is stream description.
-            wxString::Format(_("%s: %s"), error_string.c_str(), desc.c_str()).utf8_str()
-        );
+        // TRANSLATORS: first %s is the error message, second %s is stream description.
+        desc = spek_format(_("%s: %s"), error_string.c_str(), desc.c_str());
     }
 
     return desc;
 }
 
+const SampleBits * spek_pipeline_sample_bits(const struct spek_pipeline *pipeline)
+{
+    if (!pipeline->finished || !pipeline->file->get_sample_bits().get_bits()) {
+        return NULL;
+    }
+    return &pipeline->file->get_sample_bits();
+}
+
+int spek_pipeline_ffts(const struct spek_pipeline *pipeline)
+{
+    return pipeline->transforms.size();
+}
+
+size_t spek_pipeline_fft_memory(const struct spek_pipeline *pipeline, int fft)
+{
+    const spek_transform *t = pipeline->transforms[fft].get();
+    if (!t->nfft) {
+        return 0;
+    }
+    size_t bands = t->fft->get_output_size();
+    size_t rows = transform_rows(pipeline, t);
+    bool reduced = pipeline->scale != SCALE_LINEAR || rows < bands;
+    // The plan's input and output, the cos table, the accumulator, the reduced column and the
+    // columns themselves.
+    return sizeof(float) * (
+        2 * t->nfft + 2 * bands + (reduced ? rows : 0) + (size_t)t->intervals->samples * rows
+    );
+}
+
+size_t spek_pipeline_memory(const struct spek_pipeline *pipeline)
+{
+    size_t size = sizeof(spek_pipeline);
+    for (const auto& in : pipeline->intervals) {
+        size += sizeof(spek_intervals) + in->envelopes.size() * sizeof(spek_envelope);
+    }
+    if (pipeline->input) {
+        size += pipeline->input_size * sizeof(float);
+    }
+    if (pipeline->input_im) {
+        size += pipeline->input_size * sizeof(float);
+    }
+    for (const auto& t : pipeline->transforms) {
+        if (!t->nfft) {
+            continue;
+        }
+        size_t bands = t->fft->get_output_size();
+        size_t rows = transform_rows(pipeline, t.get());
+        bool reduced = pipeline->scale != SCALE_LINEAR || rows < bands;
+        size += sizeof(spek_transform) + sizeof(float) * (
+            2 * t->nfft + 2 * bands + (reduced ? rows : 0)
+        );
+        if (t->pixels) {
+            size += 3 * rows;
+        }
+    }
+    return size;
+}
+
 int spek_pipeline_streams(const struct spek_pipeline *pipeline)
 {
     return pipeline->file->get_streams();
@@ -305,36 +799,143 @@ double spek_pipeline_duration(const struct spek_pipeline *pipeline)
     return pipeline->file->get_duration();
 }
 
+std::vector<double> spek_pipeline_track_starts(const struct spek_pipeline *pipeline)
+{
+    return pipeline->file->get_track_starts();
+}
+
 int spek_pipeline_sample_rate(const struct spek_pipeline *pipeline)
 {
-    return pipeline->file->get_sample_rate();
+    int rate = pipeline->file->get_sample_rate();
+    if (pipeline->rate_decimator) {
+        rate = (int)lround(rate / (double)pipeline->rate_decimator->get_factor());
+    }
+    return rate;
+}
+
+void spek_pipeline_band(const struct spek_pipeline *pipeline, double *low, double *high)
+{
+    *low = pipeline->band_low;
+    *high = pipeline->band_high;
+    if (pipeline->scale != SCALE_LINEAR) {
+        *low = fmin(fmax(*low, SCALE_MIN_FREQ), *high / 2.0);
+    }
 }
 
 static void * reader_func(void *pp)
 {
     struct spek_pipeline *p = (spek_pipeline*)pp;
+    spek_trace_thread_name("reader");
+    bool lowered = false;
+    update_priority(p, &lowered);
 
-    p->has_worker_thread = !pthread_create(&p->worker_thread, NULL, &worker_func, p);
-    if (!p->has_worker_thread) {
+    if (p->preview_cb && !p->decimator && !p->rate_decimator) {
+        preview(p);
+        if (p->quit) {
+            return NULL;
+        }
+        // Decode as much as the workers consume per wake-up again.
+        p->file->set_batch_size(p->nfft * NFFT);
+    }
+
+    p->workers = 0;
+    for (auto& t : p->transforms) {
+        t->has_thread = !pthread_create(&t->thread, NULL, &worker_func, t.get());
+        if (!t->has_thread) {
+            break;
+        }
+        p->workers++;
+    }
+    if (p->workers < (int)p->transforms.size()) {
+        // Let the ones already running quit.
+        if (p->workers) {
+            reader_sync(p, -1);
+        }
+        for (auto& t : p->transforms) {
+            if (t->has_thread) {
+                pthread_join(t->thread, NULL);
+            }
+        }
         return NULL;
     }
 
+    AnalyzerFormat format;
+    format.sample_rate = p->file->get_sample_rate();
+    format.bits_per_sample = p->file->get_bits_per_sample();
+    format.duration = p->file->get_duration();
+    format.bands = p->transforms.front()->fft->get_output_size();
+    format.low = p->band_low;
+    format.high = p->band_high;
+    format.channels = p->file->get_channels();
+    for (auto& s : p->stages) {
+        if (s->analyzer->wants_all_channels()) {
+            p->file->set_all_channels(true);
+        }
+    }
+    for (auto& s : p->stages) {
+        if (s->has_mutex && s->has_cond) {
+            s->analyzer->start(format);
+            s->has_thread = !pthread_create(&s->thread, NULL, &stage_func, s.get());
+        }
+    }
+
     int pos = 0, prev_pos = 0;
     int len;
-    while ((len = p->file->read()) > 0) {
+    while (true) {
+        update_priority(p, &lowered);
+        {
+            SpekTraceScope trace("read");
+            len = p->file->read();
+        }
+        if (len <= 0) break;
         if (p->quit) break;
 
         const float *buffer = p->file->get_buffer();
-        while (len-- > 0) {
-            p->input[pos] = *buffer++;
-            pos = (pos + 1) % p->input_size;
-
-            // Wake up the worker if we have enough data.
-            if ((pos > prev_pos ? pos : pos + p->input_size) - prev_pos == p->nfft * NFFT) {
-                reader_sync(p, prev_pos = pos);
+        spek_block frames, samples;
+        for (auto& s : p->stages) {
+            if (s->analyzer->wants_all_channels()) {
+                if (!frames.values) {
+                    frames = make_block(-1, p->file->get_frames(), len * format.channels);
+                }
+                stage_push(s.get(), frames);
+            } else {
+                if (!samples.values) {
+                    samples = make_block(-1, buffer, len);
+                }
+                stage_push(s.get(), samples);
             }
         }
-        assert(len == -1);
+        for (auto& in : p->intervals) {
+            reader_envelope(in.get(), buffer, len, false);
+        }
+        if (p->rate_decimator) {
+            SpekTraceScope trace("decimate");
+            p->resampled.resize(len / p->rate_decimator->get_factor() + 1);
+            len = p->rate_decimator->process(buffer, len, p->resampled.data());
+            buffer = p->resampled.data();
+        }
+        reader_feed(p, buffer, len, &pos, &prev_pos);
+    }
+
+    // A failure half way, e.g. a track of an album that can't be read, leaves the error set.
+    bool failed = len < 0;
+
+    // The file may end a little short of its duration.
+    for (auto& in : p->intervals) {
+        reader_envelope(in.get(), NULL, 0, true);
+    }
+
+    // The last inputs are still in the filters.
+    if (p->rate_decimator && !p->quit) {
+        p->resampled.resize(p->rate_decimator->get_delay() + 1);
+        len = p->rate_decimator->flush(p->resampled.data());
+        reader_feed(p, p->resampled.data(), len, &pos, &prev_pos);
+    }
+    if (p->decimator && !p->quit) {
+        p->decimated_re.resize(p->decimator->get_delay() + 1);
+        p->decimated_im.resize(p->decimated_re.size());
+        len = p->decimator->flush(p->decimated_re.data(), p->decimated_im.data());
+        reader_push(p, p->decimated_re.data(), p->decimated_im.data(), len, &pos, &prev_pos);
     }
 
     if (pos != prev_pos) {
@@ -342,30 +943,404 @@ static void * reader_func(void *pp)
         reader_sync(p, pos);
     }
 
-    // Force the worker to quit.
+    // Force the workers to quit.
     reader_sync(p, -1);
-    pthread_join(p->worker_thread, NULL);
+    for (auto& t : p->transforms) {
+        pthread_join(t->thread, NULL);
+    }
+
+    // The results are complete once the last queued blocks are processed.
+    for (auto& s : p->stages) {
+        stage_close(s.get());
+    }
+    for (auto& s : p->stages) {
+        if (s->has_thread) {
+            pthread_join(s->thread, NULL);
+            s->has_thread = false;
+        }
+    }
 
     // Notify the client.
-    p->cb(p->fft->get_output_size(), -1, NULL, p->cb_data);
+    p->finished = !p->quit && !failed;
+    for (auto& t : p->transforms) {
+        pass_on(p, t.get(), -1);
+    }
     return NULL;
 }
 
+// Accumulate the decoded samples into the envelopes of the columns, with the same intervals the
+// workers count their frames in, and store a short last one too if `flush` is set.
+static void reader_envelope(
+    struct spek_intervals *in, const float *buffer, int len, bool flush)
+{
+    for (int i = 0; i <= len && in->envelope_sample < in->samples; i++) {
+        if (i < len) {
+            float value = buffer[i];
+            if (!in->envelope_frames) {
+                in->envelope_min = value;
+                in->envelope_max = value;
+                in->envelope_power = 0.0;
+            } else {
+                in->envelope_min = fminf(in->envelope_min, value);
+                in->envelope_max = fmaxf(in->envelope_max, value);
+            }
+            in->envelope_power += value * value;
+            in->envelope_frames++;
+        } else if (!flush || !in->envelope_frames) {
+            break;
+        }
+
+        bool int_full =
+            in->envelope_error < in->error_base &&
+            in->envelope_frames == in->frames_per_interval;
+        bool int_over =
+            in->envelope_error >= in->error_base &&
+            in->envelope_frames == 1 + in->frames_per_interval;
+        if (i < len && !int_full && !int_over) {
+            continue;
+        }
+        if (int_over) {
+            in->envelope_error -= in->error_base;
+        } else {
+            in->envelope_error += in->error_per_interval;
+        }
+
+        spek_envelope& envelope = in->envelopes[in->envelope_sample++];
+        envelope.min = in->envelope_min;
+        envelope.max = in->envelope_max;
+        envelope.rms = (float)sqrt(in->envelope_power / in->envelope_frames);
+        in->envelope_frames = 0;
+    }
+}
+
+// Zoom into the band if one is set and append the result to the input ring.
+static void reader_feed(
+    struct spek_pipeline *p, const float *buffer, int len, int *pos, int *prev_pos)
+{
+    if (!p->decimator) {
+        reader_push(p, buffer, NULL, len, pos, prev_pos);
+        return;
+    }
+    {
+        SpekTraceScope trace("zoom");
+        p->decimated_re.resize(len / p->decimator->get_factor() + 1);
+        p->decimated_im.resize(p->decimated_re.size());
+        len = p->decimator->process(buffer, len, p->decimated_re.data(), p->decimated_im.data());
+    }
+    reader_push(p, p->decimated_re.data(), p->decimated_im.data(), len, pos, prev_pos);
+}
+
+// Append `len` frames to the input ring, `im` is only set when zoomed into a band.
+static void reader_push(
+    struct spek_pipeline *p, const float *re, const float *im, int len, int *pos, int *prev_pos)
+{
+    while (len-- > 0) {
+        p->input[*pos] = *re++;
+        if (im) {
+            p->input_im[*pos] = *im++;
+        }
+        *pos = (*pos + 1) % p->input_size;
+
+        // Wake up the workers if we have enough data.
+        if ((*pos > *prev_pos ? *pos : *pos + p->input_size) - *prev_pos == p->nfft * NFFT) {
+            reader_sync(p, *prev_pos = *pos);
+        }
+    }
+    assert(len == -1);
+}
+
 static void reader_sync(struct spek_pipeline *p, int pos)
 {
+    SpekTraceScope trace("reader_sync");
+
+    // Every worker has to be done with the previous chunk before the ring moves on.
     pthread_mutex_lock(&p->reader_mutex);
-    while (!p->worker_done) {
+    while (p->workers_done < p->workers) {
         pthread_cond_wait(&p->reader_cond, &p->reader_mutex);
     }
-    p->worker_done = false;
+    p->workers_done = 0;
     pthread_mutex_unlock(&p->reader_mutex);
 
     pthread_mutex_lock(&p->worker_mutex);
     p->input_pos = pos;
-    pthread_cond_signal(&p->worker_cond);
+    pthread_cond_broadcast(&p->worker_cond);
     pthread_mutex_unlock(&p->worker_mutex);
 }
 
+// Seek to the middle of each column and run a single FFT there, so that a long file can be
+// looked at long before the full decode is done. The workers aren't running yet, so the first
+// transform's plan is free to use.
+static void preview(struct spek_pipeline *p)
+{
+    SpekTraceScope trace("preview");
+
+    // Bail out early if the stream can't be seeked, then there is no way to go back either.
+    if (!p->file->rewind()) {
+        return;
+    }
+
+    spek_transform *t = p->transforms[0].get();
+    int bands = t->fft->get_output_size();
+    double duration = p->file->get_duration();
+    p->file->set_batch_size(t->nfft);
+    for (int sample = 0; sample < p->samples && !p->quit; sample++) {
+        if (!p->file->seek(duration * (sample + 0.5) / p->samples)) {
+            break;
+        }
+        int len = p->file->read();
+        if (len <= 0) {
+            continue;
+        }
+        const float *buffer = p->file->get_buffer();
+        for (int i = 0; i < t->nfft; i++) {
+            float val = i < len ? buffer[i] : 0.0f;
+            val *= get_window(p->window_function, i, t->coss, t->nfft);
+            t->fft->set_input(i, val);
+        }
+        t->fft->execute();
+        for (int i = 0; i < bands; i++) {
+            t->output[i] = t->fft->get_output(i);
+        }
+        float *values;
+        int rows = reduce(p, t, &values);
+        p->preview_cb(rows, sample, values, NULL, t->cb_data);
+    }
+
+    if (!p->quit) {
+        p->file->rewind();
+    }
+}
+
+// The number of values passed on per column, never more than the transform has bands unless
+// they are rows of a non-linear axis. All the bands for spek_pipeline_add_columns().
+static int transform_rows(const struct spek_pipeline *p, const struct spek_transform *t)
+{
+    int bands = t->fft->get_output_size();
+    if (t->cb) {
+        return bands;
+    }
+    if (p->scale != SCALE_LINEAR) {
+        return p->rows ? p->rows : bands;
+    }
+    return p->rows ? spek_min(p->rows, bands) : bands;
+}
+
+// Reduce the transform's output to the requested number of rows if needed, the values are dB so
+// the mean is that of the levels rather than of the power. Returns the number of values.
+static int reduce(struct spek_pipeline *p, struct spek_transform *t, float **values)
+{
+    int bands = t->fft->get_output_size();
+    int rows = transform_rows(p, t);
+    if (!t->kernel.empty()) {
+        t->kernel.apply(t->output, t->reduced);
+        *values = t->reduced;
+        return rows;
+    }
+    if (rows == bands) {
+        *values = t->output;
+        return bands;
+    }
+
+    for (int row = 0; row < rows; row++) {
+        int first = (int)((int64_t)row * bands / rows);
+        int last = (int)((int64_t)(row + 1) * bands / rows);
+        float value = t->output[first];
+        for (int i = first + 1; i < last; i++) {
+            if (p->reduce_function == REDUCE_MAX) {
+                value = fmaxf(value, t->output[i]);
+            } else {
+                value += t->output[i];
+            }
+        }
+        if (p->reduce_function == REDUCE_MEAN) {
+            value /= last - first;
+        }
+        t->reduced[row] = value;
+    }
+    *values = t->reduced;
+    return rows;
+}
+
+// Lower or restore the priority of the calling thread to follow spek_pipeline_set_background(),
+// `lowered` is whether it already is.
+static void update_priority(struct spek_pipeline *p, bool *lowered)
+{
+    bool background = p->background;
+    if (background == *lowered) {
+        return;
+    }
+#ifdef __linux__
+    // The nice value of this thread alone. Unlike with SCHED_IDLE, it still gets some CPU time on
+    // a busy machine. Raising it back may not be allowed, see
+    // spek_pipeline_can_restore_priority().
+    static thread_local int normal_nice = 0;
+    pid_t tid = syscall(SYS_gettid);
+    if (background) {
+        errno = 0;
+        int nice = getpriority(PRIO_PROCESS, tid);
+        if (errno) {
+            return;
+        }
+        normal_nice = nice;
+    }
+    if (setpriority(PRIO_PROCESS, tid, background ? BACKGROUND_NICE : normal_nice) != 0) {
+        // Tried again before the next batch.
+        return;
+    }
+#elif !defined(OS_WIN)
+    // The default priority is in the middle of the range.
+    int low = sched_get_priority_min(SCHED_OTHER);
+    struct sched_param param;
+    param.sched_priority = background ? low : (low + sched_get_priority_max(SCHED_OTHER)) / 2;
+    if (pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) != 0) {
+        return;
+    }
+#endif
+    *lowered = background;
+}
+
+// Queue a copy of the samples or the column for the analyzer, once there is room for it.
+static spek_block make_block(int sample, const float *values, int n)
+{
+    spek_block block;
+    block.sample = sample;
+    block.values = std::make_shared<const std::vector<float>>(values, values + n);
+    return block;
+}
+
+static void stage_push(struct spek_stage *s, const spek_block& block)
+{
+    if (!s->has_thread) {
+        return;
+    }
+    size_t size = block.values->size() * sizeof(float);
+
+    pthread_mutex_lock(&s->mutex);
+    // A block larger than the limit still goes into an empty queue.
+    while (!s->queue.empty() && s->queued + size > MAX_QUEUED && !s->pipeline->quit) {
+        pthread_cond_wait(&s->cond, &s->mutex);
+    }
+    s->queue.push_back(block);
+    s->queued += size;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void stage_close(struct spek_stage *s)
+{
+    if (!s->has_thread) {
+        return;
+    }
+    pthread_mutex_lock(&s->mutex);
+    s->closed = true;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void * stage_func(void *ss)
+{
+    struct spek_stage *s = (spek_stage*)ss;
+    struct spek_pipeline *p = s->pipeline;
+    spek_trace_thread_name("analyzer");
+    bool lowered = false;
+
+    while (true) {
+        update_priority(p, &lowered);
+        pthread_mutex_lock(&s->mutex);
+        while (s->queue.empty() && !s->closed) {
+            pthread_cond_wait(&s->cond, &s->mutex);
+        }
+        if (s->queue.empty()) {
+            pthread_mutex_unlock(&s->mutex);
+            break;
+        }
+        spek_block block = std::move(s->queue.front());
+        s->queue.pop_front();
+        s->queued -= block.values->size() * sizeof(float);
+        // Let the reader go on.
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+
+        if (p->quit) {
+            // Drain the queue without looking at it.
+            continue;
+        }
+        SpekTraceScope trace("analyze");
+        const std::vector<float>& values = *block.values;
+        if (block.sample < 0 && s->analyzer->wants_all_channels()) {
+            int channels = spek_max(p->file->get_channels(), 1);
+            s->analyzer->process_channels(values.data(), values.size() / channels);
+        } else if (block.sample < 0) {
+            s->analyzer->process(values.data(), values.size());
+        } else {
+            s->analyzer->process_column(block.sample, values.data());
+        }
+    }
+
+    if (!p->quit) {
+        s->analyzer->finish();
+    }
+    return NULL;
+}
+
+// Reduce the output to a column, colourise it if asked to and pass it on, or the end of the
+// analysis if the `sample` is -1.
+static void pass_on(struct spek_pipeline *p, struct spek_transform *t, int sample)
+{
+    // Complete by now, the reader decodes the samples of a column before the workers see them.
+    const spek_envelope *envelope = sample < 0 ? NULL : &t->intervals->envelopes[sample];
+    if (t->cb) {
+        t->cb(t->fft->get_output_size(), sample, sample < 0 ? NULL : t->output, envelope,
+            t->cb_data);
+        return;
+    }
+    if (sample < 0) {
+        int rows = transform_rows(p, t);
+        if (p->pixels_cb) {
+            p->pixels_cb(rows, -1, NULL, NULL, NULL, -1, t->cb_data);
+        } else {
+            p->cb(rows, -1, NULL, NULL, t->cb_data);
+        }
+        return;
+    }
+
+    if (t == p->transforms.front().get()) {
+        spek_block column;
+        for (auto& s : p->stages) {
+            if (s->analyzer->wants_columns()) {
+                if (!column.values) {
+                    column = make_block(sample, t->output, t->fft->get_output_size());
+                }
+                stage_push(s.get(), column);
+            }
+        }
+    }
+
+    float *values;
+    int rows = reduce(p, t, &values);
+    if (!p->pixels_cb) {
+        p->cb(rows, sample, values, envelope, t->cb_data);
+        return;
+    }
+
+    // Hold on to the map, the client may swap it in the meantime.
+    std::shared_ptr<const ColorMap> colors;
+    if (p->has_colors_mutex) {
+        pthread_mutex_lock(&p->colors_mutex);
+        colors = p->colors;
+        pthread_mutex_unlock(&p->colors_mutex);
+    }
+    if (!colors) {
+        p->pixels_cb(rows, sample, values, envelope, NULL, -1, t->cb_data);
+        return;
+    }
+    {
+        SpekTraceScope trace("colorize");
+        colors->apply(values, rows, t->pixels);
+    }
+    p->pixels_cb(rows, sample, values, envelope, t->pixels, colors->get_id(), t->cb_data);
+}
+
 static float get_window(enum window_function f, int i, float *coss, int n) {
     switch (f) {
     case WINDOW_HANN:
@@ -382,7 +1357,11 @@ static float get_window(enum window_function f, int i, float *coss, int n) {
 
 static void * worker_func(void *pp)
 {
-    struct spek_pipeline *p = (spek_pipeline*)pp;
+    struct spek_transform *t = (spek_transform*)pp;
+    struct spek_pipeline *p = t->pipeline;
+    const struct spek_intervals *in = t->intervals;
+    spek_trace_thread_name("worker");
+    bool lowered = false;
 
     int sample = 0;
     int64_t frames = 0;
@@ -391,11 +1370,11 @@ static void * worker_func(void *pp)
     int head = 0, tail = 0;
     int prev_head = 0;
 
-    memset(p->output, 0, sizeof(float) * p->fft->get_output_size());
+    memset(t->output, 0, sizeof(float) * t->fft->get_output_size());
 
     while (true) {
         pthread_mutex_lock(&p->reader_mutex);
-        p->worker_done = true;
+        p->workers_done++;
         pthread_cond_signal(&p->reader_cond);
         pthread_mutex_unlock(&p->reader_mutex);
 
@@ -410,7 +1389,9 @@ static void * worker_func(void *pp)
             return NULL;
         }
 
-        while (true) {
+        update_priority(p, &lowered);
+        SpekTraceScope trace("fft");
+        while (!p->quit) {
             head = (head + 1) % p->input_size;
             if (head == tail) {
                 head = prev_head;
@@ -421,42 +1402,46 @@ static void * worker_func(void *pp)
             // If we have enough frames for an FFT or we have
             // all frames required for the interval run and FFT.
             bool int_full =
-                acc_error < p->file->get_error_base() &&
-                frames == p->file->get_frames_per_interval();
+                acc_error < in->input_error_base &&
+                frames == in->input_frames_per_interval;
             bool int_over =
-                acc_error >= p->file->get_error_base() &&
-                frames == 1 + p->file->get_frames_per_interval();
+                acc_error >= in->input_error_base &&
+                frames == 1 + in->input_frames_per_interval;
 
-            if (frames % p->nfft == 0 || ((int_full || int_over) && num_fft == 0)) {
+            if (frames % t->nfft == 0 || ((int_full || int_over) && num_fft == 0)) {
                 prev_head = head;
-                for (int i = 0; i < p->nfft; i++) {
-                    float val = p->input[(p->input_size + head - p->nfft + i) % p->input_size];
-                    val *= get_window(p->window_function, i, p->coss, p->nfft);
-                    p->fft->set_input(i, val);
+                for (int i = 0; i < t->nfft; i++) {
+                    int pos = (p->input_size + head - t->nfft + i) % p->input_size;
+                    float window = get_window(p->window_function, i, t->coss, t->nfft);
+                    if (p->input_im) {
+                        t->fft->set_input(i, p->input[pos] * window, p->input_im[pos] * window);
+                    } else {
+                        t->fft->set_input(i, p->input[pos] * window);
+                    }
                 }
-                p->fft->execute();
+                t->fft->execute();
                 num_fft++;
-                for (int i = 0; i < p->fft->get_output_size(); i++) {
-                    p->output[i] += p->fft->get_output(i);
+                for (int i = 0; i < t->fft->get_output_size(); i++) {
+                    t->output[i] += t->fft->get_output(i);
                 }
             }
 
             // Do we have the FFTs for one interval?
             if (int_full || int_over) {
                 if (int_over) {
-                    acc_error -= p->file->get_error_base();
+                    acc_error -= in->input_error_base;
                 } else {
-                    acc_error += p->file->get_error_per_interval();
+                    acc_error += in->input_error_per_interval;
                 }
 
-                for (int i = 0; i < p->fft->get_output_size(); i++) {
-                    p->output[i] /= num_fft;
+                for (int i = 0; i < t->fft->get_output_size(); i++) {
+                    t->output[i] /= num_fft;
                 }
 
-                if (sample == p->samples) break;
-                p->cb(p->fft->get_output_size(), sample++, p->output, p->cb_data);
+                if (sample == in->samples) break;
+                pass_on(p, t, sample++);
 
-                memset(p->output, 0, sizeof(float) * p->fft->get_output_size());
+                memset(t->output, 0, sizeof(float) * t->fft->get_output_size());
                 frames = 0;
                 num_fft = 0;
             }
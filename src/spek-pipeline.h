@@ -1,10 +1,19 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "spek-scale.h"
 
+class Analyzer;
 class AudioFile;
+class ColorMap;
 class FFTPlan;
+class SampleBits;
 struct spek_pipeline;
 
 enum window_function {
@@ -15,7 +24,28 @@ enum window_function {
     WINDOW_DEFAULT = WINDOW_HANN,
 };
 
-typedef void (*spek_pipeline_cb)(int bands, int sample, float *values, void *cb_data);
+enum reduce_function {
+    REDUCE_MAX,
+    REDUCE_MEAN,
+};
+
+// The decoded samples of one column, e.g. for a waveform drawn along the spectrogram. They are
+// taken before any decimation, so the peaks are those of the file.
+struct spek_envelope
+{
+    float min;
+    float max;
+    float rms;
+};
+
+// The columns come with the envelope of the same samples, which is NULL for the preview and at
+// the end of the analysis.
+typedef void (*spek_pipeline_cb)(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data);
+// Also gets the colourised column, see spek_pipeline_set_colors().
+typedef void (*spek_pipeline_pixels_cb)(
+    int bands, int sample, float *values, const spek_envelope *envelope,
+    const uint8_t *pixels, int colors, void *cb_data);
 
 struct spek_pipeline * spek_pipeline_open(
     std::unique_ptr<AudioFile> file,
@@ -28,11 +58,92 @@ struct spek_pipeline * spek_pipeline_open(
     void *cb_data
 );
 
+// Feed the same decoded samples to another FFT size, results come with `cb_data` and are told
+// apart by the number of bands. Must be called before spek_pipeline_start().
+void spek_pipeline_add_fft(
+    struct spek_pipeline *pipeline, std::unique_ptr<FFTPlan> fft, void *cb_data
+);
+// Same as spek_pipeline_add_fft(), but split into `samples` columns of its own, counted the same
+// way as a pipeline opened with that many. They go to `cb` with all the bands, neither reduced
+// to rows nor colourised.
+void spek_pipeline_add_columns(
+    struct spek_pipeline *pipeline, std::unique_ptr<FFTPlan> fft, int samples,
+    spek_pipeline_cb cb, void *cb_data
+);
+
+// Run the threads at the lowest scheduling priority so that they mostly use otherwise idle cores.
+// Can be called while the pipeline is running, to let it have a normal priority again.
+void spek_pipeline_set_background(struct spek_pipeline *pipeline, bool background);
+// Whether threads started by the calling thread can get their normal priority back after
+// running in the background. If not, they stay at the lowest one.
+bool spek_pipeline_can_restore_priority();
+
+// Before the full analysis, quickly fill all the columns of the first FFT size with one FFT
+// each, taken at evenly spaced points of the stream. These approximate columns are passed to
+// `cb`, the exact ones replace them later. Must be called before spek_pipeline_start().
+void spek_pipeline_set_preview(struct spek_pipeline *pipeline, spek_pipeline_cb cb);
+
+// Take another measurement in the same pass over the file: `analyzer` gets the decoded samples
+// and, if it wants them, the columns of the first FFT size before they are reduced. It runs on
+// its own thread, fed through a queue, and its results are ready once the pipeline passed on
+// the end of the analysis. Must be called before spek_pipeline_start().
+void spek_pipeline_add_analyzer(
+    struct spek_pipeline *pipeline, std::shared_ptr<Analyzer> analyzer);
+
+// Reduce the bands of each column to `rows` values before passing it on, e.g. to the number of
+// pixel rows it's displayed at. Transforms with fewer bands are passed on as they are.
+// Must be called before spek_pipeline_start().
+void spek_pipeline_set_rows(struct spek_pipeline *pipeline, int rows, enum reduce_function f);
+
+// Pass on the rows of a non-linear frequency axis instead of the bands, computed from them for
+// the number of rows set with spek_pipeline_set_rows(), or as many as there are bands. The
+// axis starts at SCALE_MIN_FREQ or the low end of the band, see spek_pipeline_band().
+// Must be called before spek_pipeline_start().
+void spek_pipeline_set_scale(struct spek_pipeline *pipeline, enum frequency_scale scale);
+
+// Colourise the columns on the worker threads as well, and pass them to `cb` instead of the
+// callback given to spek_pipeline_open(), with the pixels written by ColorMap::apply(). Until a
+// map is set the pixels are NULL and the id is -1. Must be called before spek_pipeline_start().
+void spek_pipeline_set_colors(struct spek_pipeline *pipeline, spek_pipeline_pixels_cb cb);
+// Change the colours, e.g. after the palette or the dynamic range changed. Can be called while
+// the analysis is running, the following columns come with the new map's id.
+void spek_pipeline_set_color_map(
+    struct spek_pipeline *pipeline, std::shared_ptr<const ColorMap> colors);
+
+// Decimate files with a higher sample rate than `max_rate` before the analysis, e.g. DSD and
+// 352.8 kHz PCM, so that the FFTs don't spend most of their time on ultrasonic content. The
+// rate used is an integer fraction of the file's, spek_pipeline_sample_rate() returns it and
+// there is no preview when decimating. Must be called before spek_pipeline_set_band().
+void spek_pipeline_set_max_rate(struct spek_pipeline *pipeline, int max_rate);
+
+// Only look at the frequencies from `low` to `high` Hz. The band is shifted down and decimated
+// ahead of the FFTs, so the same transforms give finer bands for it and the narrower it is, the
+// less there is to transform. The bands actually covered are given by spek_pipeline_band(),
+// there is no preview when zoomed. Must be called after the FFTs are added and before
+// spek_pipeline_start(), does nothing if the band is too wide to gain anything.
+void spek_pipeline_set_band(struct spek_pipeline *pipeline, double low, double high);
+
 void spek_pipeline_start(struct spek_pipeline *pipeline);
 void spek_pipeline_close(struct spek_pipeline *pipeline);
+// Same as spek_pipeline_close() but hands the file back, so that it can be rewound and
+// analysed again without reopening it.
+std::unique_ptr<AudioFile> spek_pipeline_release(struct spek_pipeline *pipeline);
 
-std::string spek_pipeline_desc(const struct spek_pipeline *pipeline);
+std::string spek_pipeline_desc(const struct spek_pipeline *pipeline, int fft = 0);
+// The bits used by the integer samples of each channel, NULL until the whole file is read or if
+// the samples aren't integers.
+const SampleBits * spek_pipeline_sample_bits(const struct spek_pipeline *pipeline);
+int spek_pipeline_ffts(const struct spek_pipeline *pipeline);
+size_t spek_pipeline_fft_memory(const struct spek_pipeline *pipeline, int fft);
+// Bytes held by the pipeline, not counting the columns already passed to the client.
+size_t spek_pipeline_memory(const struct spek_pipeline *pipeline);
 int spek_pipeline_streams(const struct spek_pipeline *pipeline);
 int spek_pipeline_channels(const struct spek_pipeline *pipeline);
 double spek_pipeline_duration(const struct spek_pipeline *pipeline);
+// Where the tracks after the first one start, in seconds, if the file is an album.
+std::vector<double> spek_pipeline_track_starts(const struct spek_pipeline *pipeline);
+// The sample rate the analysis runs at, lower than the file's if decimated.
 int spek_pipeline_sample_rate(const struct spek_pipeline *pipeline);
+// The frequencies of the first and the last band, from 0 Hz to half the sample rate unless
+// zoomed into a band or on a non-linear scale.
+void spek_pipeline_band(const struct spek_pipeline *pipeline, double *low, double *high);
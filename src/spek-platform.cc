@@ -39,6 +39,26 @@ wxString spek_platform_config_path(const wxString& app_name)
     return file_name.GetFullPath();
 }
 
+wxString spek_platform_cache_path(const wxString& app_name)
+{
+#ifdef OS_WIN
+    wxFileName file_name(wxStandardPaths::Get().GetUserLocalDataDir(), wxEmptyString);
+    file_name.AppendDir("cache");
+#else
+    wxFileName file_name;
+    wxString xdg_cache_home;
+    if (wxGetEnv("XDG_CACHE_HOME", &xdg_cache_home) && !xdg_cache_home.IsEmpty()) {
+        file_name = wxFileName(xdg_cache_home, wxEmptyString);
+    } else {
+        file_name = wxFileName(wxGetHomeDir(), wxEmptyString);
+        file_name.AppendDir(".cache");
+    }
+    file_name.AppendDir(app_name);
+#endif
+    file_name.Mkdir(0755, wxPATH_MKDIR_FULL);
+    return file_name.GetPath();
+}
+
 bool spek_platform_can_change_language()
 {
 #ifdef OS_UNIX
@@ -7,6 +7,8 @@ void spek_platform_init();
 
 // Not quite XDG-compatible, but close enough.
 wxString spek_platform_config_path(const wxString& app_name);
+// A directory for files that can be made again, created if it doesn't exist.
+wxString spek_platform_cache_path(const wxString& app_name);
 
 // Setting non-default locale under GTK+ is tricky (see e.g. how FileZilla does it). We will
 // just disable the language setting for GTK+ users and will always use the system locale.
@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include <zlib.h>
+
+#include "spek-png.h"
+
+enum
+{
+    CHUNK_SIZE = 64 * 1024, // Compressed bytes per IDAT chunk.
+};
+
+static void put_uint32(uint8_t *data, uint32_t value)
+{
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+PngWriter::PngWriter() :
+    file(NULL), stream(NULL), width(0), height(0), rows(0), failed(false)
+{
+}
+
+PngWriter::~PngWriter()
+{
+    if (this->stream) {
+        deflateEnd(this->stream);
+        delete this->stream;
+    }
+    if (this->file) {
+        fclose(this->file);
+    }
+}
+
+bool PngWriter::open(const std::string& file_name, int width, int height)
+{
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    this->file = fopen(file_name.c_str(), "wb");
+    if (!this->file) {
+        return false;
+    }
+    this->width = width;
+    this->height = height;
+    this->rows = 0;
+    this->failed = false;
+
+    this->stream = new z_stream();
+    if (deflateInit(this->stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        delete this->stream;
+        this->stream = NULL;
+        return false;
+    }
+    this->filtered.resize(1 + 3 * (size_t)width);
+    this->compressed.resize(CHUNK_SIZE);
+    this->stream->next_out = this->compressed.data();
+    this->stream->avail_out = this->compressed.size();
+
+    static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (fwrite(signature, sizeof(signature), 1, this->file) != 1) {
+        return false;
+    }
+
+    uint8_t header[13];
+    put_uint32(header, width);
+    put_uint32(header + 4, height);
+    header[8] = 8; // Bit depth.
+    header[9] = 2; // Truecolour.
+    header[10] = 0; // Deflate.
+    header[11] = 0; // Adaptive filtering.
+    header[12] = 0; // No interlacing.
+    return this->write_chunk("IHDR", header, sizeof(header));
+}
+
+bool PngWriter::write_row(const uint8_t *rgb)
+{
+    if (!this->stream || this->rows >= this->height) {
+        return false;
+    }
+
+    // The Sub filter, neighbouring pixels of a spectrogram are alike and compress much better
+    // as differences.
+    uint8_t *out = this->filtered.data();
+    size_t len = 3 * (size_t)this->width;
+    out[0] = 1;
+    memcpy(out + 1, rgb, 3);
+    for (size_t i = 3; i < len; i++) {
+        out[1 + i] = rgb[i] - rgb[i - 3];
+    }
+
+    this->rows++;
+    return this->compress(out, len + 1, false);
+}
+
+bool PngWriter::close()
+{
+    if (!this->stream) {
+        return false;
+    }
+    bool result = this->rows == this->height && this->compress(NULL, 0, true);
+    result = result && this->write_chunk("IEND", NULL, 0);
+    deflateEnd(this->stream);
+    delete this->stream;
+    this->stream = NULL;
+    result = fclose(this->file) == 0 && result;
+    this->file = NULL;
+    return result && !this->failed;
+}
+
+// Feed `data` to the compressor and write out an IDAT chunk whenever the buffer fills up.
+bool PngWriter::compress(const uint8_t *data, size_t len, bool finish)
+{
+    this->stream->next_in = const_cast<Bytef*>(data);
+    this->stream->avail_in = len;
+    while (true) {
+        int ret = deflate(this->stream, finish ? Z_FINISH : Z_NO_FLUSH);
+        if (ret == Z_STREAM_ERROR) {
+            this->failed = true;
+            return false;
+        }
+        bool end = finish && ret == Z_STREAM_END;
+        if (!this->stream->avail_out || end) {
+            size_t pending = this->compressed.size() - this->stream->avail_out;
+            if (pending && !this->write_chunk("IDAT", this->compressed.data(), pending)) {
+                return false;
+            }
+            this->stream->next_out = this->compressed.data();
+            this->stream->avail_out = this->compressed.size();
+        }
+        if (end || (!finish && !this->stream->avail_in)) {
+            return true;
+        }
+    }
+}
+
+bool PngWriter::write_chunk(const char *type, const uint8_t *data, size_t len)
+{
+    uint8_t header[8];
+    put_uint32(header, len);
+    memcpy(header + 4, type, 4);
+    uLong crc = crc32(0, header + 4, 4);
+    if (len) {
+        crc = crc32(crc, data, len);
+    }
+    uint8_t footer[4];
+    put_uint32(footer, crc);
+
+    bool ok =
+        fwrite(header, sizeof(header), 1, this->file) == 1 &&
+        (!len || fwrite(data, len, 1, this->file) == 1) &&
+        fwrite(footer, sizeof(footer), 1, this->file) == 1;
+    if (!ok) {
+        this->failed = true;
+    }
+    return ok;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+// Writes an 8-bit RGB PNG one row at a time. Rows are compressed as they come in, so the
+// whole image never has to be kept in memory.
+class PngWriter
+{
+public:
+    PngWriter();
+    ~PngWriter();
+
+    bool open(const std::string& file_name, int width, int height);
+    // `rgb` holds 3 * width bytes, rows go from the top to the bottom.
+    bool write_row(const uint8_t *rgb);
+    // Must be called after the last row, returns false if anything failed along the way.
+    bool close();
+
+private:
+    bool compress(const uint8_t *data, size_t len, bool finish);
+    bool write_chunk(const char *type, const uint8_t *data, size_t len);
+
+    FILE *file;
+    z_stream_s *stream;
+    int width;
+    int height;
+    int rows;
+    bool failed;
+    std::vector<uint8_t> filtered;
+    std::vector<uint8_t> compressed;
+};
@@ -48,10 +48,23 @@ static const char *available_languages[] =
 
 #define ID_LANGUAGE (wxID_HIGHEST + 1)
 #define ID_CHECK (wxID_HIGHEST + 2)
+#define ID_ALL_STREAMS (wxID_HIGHEST + 3)
+#define ID_ALL_FFT_SIZES (wxID_HIGHEST + 4)
+#define ID_REDUCE_ROWS (wxID_HIGHEST + 5)
+#define ID_COLUMN_PRECISION (wxID_HIGHEST + 6)
+#define ID_MAX_SAMPLE_RATE (wxID_HIGHEST + 7)
+
+// Choices for the highest sample rate to analyse at, 0 for no limit.
+static const int max_sample_rates[] = {0, 48000, 96000, 192000};
 
 BEGIN_EVENT_TABLE(SpekPreferencesDialog, wxDialog)
     EVT_CHOICE(ID_LANGUAGE, SpekPreferencesDialog::on_language)
     EVT_CHECKBOX(ID_CHECK, SpekPreferencesDialog::on_check)
+    EVT_CHECKBOX(ID_ALL_STREAMS, SpekPreferencesDialog::on_all_streams)
+    EVT_CHECKBOX(ID_ALL_FFT_SIZES, SpekPreferencesDialog::on_all_fft_sizes)
+    EVT_CHECKBOX(ID_REDUCE_ROWS, SpekPreferencesDialog::on_reduce_rows)
+    EVT_CHOICE(ID_COLUMN_PRECISION, SpekPreferencesDialog::on_column_precision)
+    EVT_CHOICE(ID_MAX_SAMPLE_RATE, SpekPreferencesDialog::on_max_sample_rate)
 END_EVENT_TABLE()
 
 SpekPreferencesDialog::SpekPreferencesDialog(wxWindow *parent) :
@@ -96,6 +109,51 @@ SpekPreferencesDialog::SpekPreferencesDialog(wxWindow *parent) :
     inner_sizer->Add(check_update, 0 ,wxLEFT | wxTOP, 12);
     check_update->SetValue(SpekPreferences::get().get_check_update());
 
+    wxCheckBox *all_streams = new wxCheckBox(
+        this, ID_ALL_STREAMS, _("Analyse all audio &streams at once"));
+    inner_sizer->Add(all_streams, 0 ,wxLEFT | wxTOP, 12);
+    all_streams->SetValue(SpekPreferences::get().get_all_streams());
+
+    wxCheckBox *all_fft_sizes = new wxCheckBox(
+        this, ID_ALL_FFT_SIZES, _("Analyse all &FFT sizes at once"));
+    inner_sizer->Add(all_fft_sizes, 0 ,wxLEFT | wxTOP, 12);
+    all_fft_sizes->SetValue(SpekPreferences::get().get_all_fft_sizes());
+
+    wxCheckBox *reduce_rows = new wxCheckBox(
+        this, ID_REDUCE_ROWS, _("&Reduce the frequency bands to the window height"));
+    inner_sizer->Add(reduce_rows, 0 ,wxLEFT | wxTOP, 12);
+    reduce_rows->SetValue(SpekPreferences::get().get_reduce_rows());
+
+    wxSizer *precision_sizer = new wxBoxSizer(wxHORIZONTAL);
+    inner_sizer->Add(precision_sizer, 0, wxLEFT | wxTOP, 12);
+    wxStaticText *precision_label = new wxStaticText(this, -1, _("Analysis precision:"));
+    precision_sizer->Add(precision_label, 0, wxALIGN_CENTER_VERTICAL);
+    wxChoice *precision_choice = new wxChoice(this, ID_COLUMN_PRECISION);
+    precision_sizer->Add(precision_choice, 0, wxALIGN_CENTER_VERTICAL | wxLEFT, 12);
+    // In the order of ColumnPrecision.
+    precision_choice->Append(_("Full"));
+    precision_choice->Append(_("16 bits"));
+    precision_choice->Append(_("8 bits"));
+    precision_choice->SetSelection((int)SpekPreferences::get().get_column_precision());
+
+    wxSizer *rate_sizer = new wxBoxSizer(wxHORIZONTAL);
+    inner_sizer->Add(rate_sizer, 0, wxLEFT | wxTOP, 12);
+    wxStaticText *rate_label = new wxStaticText(this, -1, _("Highest sample rate to analyse:"));
+    rate_sizer->Add(rate_label, 0, wxALIGN_CENTER_VERTICAL);
+    wxChoice *rate_choice = new wxChoice(this, ID_MAX_SAMPLE_RATE);
+    rate_sizer->Add(rate_choice, 0, wxALIGN_CENTER_VERTICAL | wxLEFT, 12);
+    int max_sample_rate = SpekPreferences::get().get_max_sample_rate();
+    for (size_t i = 0; i < sizeof(max_sample_rates) / sizeof(max_sample_rates[0]); i++) {
+        if (max_sample_rates[i]) {
+            rate_choice->Append(wxString::Format(_("%d kHz"), max_sample_rates[i] / 1000));
+        } else {
+            rate_choice->Append(_("No limit"));
+        }
+        if (max_sample_rates[i] == max_sample_rate) {
+            rate_choice->SetSelection(i);
+        }
+    }
+
     sizer->Add(CreateButtonSizer(wxOK), 0, wxALIGN_RIGHT | wxBOTTOM | wxRIGHT, 12);
     sizer->SetSizeHints(this);
     SetSizer(sizer);
@@ -110,3 +168,28 @@ void SpekPreferencesDialog::on_check(wxCommandEvent& event)
 {
     SpekPreferences::get().set_check_update(event.IsChecked());
 }
+
+void SpekPreferencesDialog::on_all_streams(wxCommandEvent& event)
+{
+    SpekPreferences::get().set_all_streams(event.IsChecked());
+}
+
+void SpekPreferencesDialog::on_all_fft_sizes(wxCommandEvent& event)
+{
+    SpekPreferences::get().set_all_fft_sizes(event.IsChecked());
+}
+
+void SpekPreferencesDialog::on_reduce_rows(wxCommandEvent& event)
+{
+    SpekPreferences::get().set_reduce_rows(event.IsChecked());
+}
+
+void SpekPreferencesDialog::on_column_precision(wxCommandEvent& event)
+{
+    SpekPreferences::get().set_column_precision((ColumnPrecision)event.GetSelection());
+}
+
+void SpekPreferencesDialog::on_max_sample_rate(wxCommandEvent& event)
+{
+    SpekPreferences::get().set_max_sample_rate(max_sample_rates[event.GetSelection()]);
+}
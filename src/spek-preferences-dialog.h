@@ -10,6 +10,11 @@ public:
 private:
     void on_language(wxCommandEvent& event);
     void on_check(wxCommandEvent& event);
+    void on_all_streams(wxCommandEvent& event);
+    void on_all_fft_sizes(wxCommandEvent& event);
+    void on_reduce_rows(wxCommandEvent& event);
+    void on_column_precision(wxCommandEvent& event);
+    void on_max_sample_rate(wxCommandEvent& event);
 
     wxArrayString languages;
 
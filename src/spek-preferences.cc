@@ -80,3 +80,72 @@ void SpekPreferences::set_language(const wxString& value)
     this->config->Write("/general/language", value);
     this->config->Flush();
 }
+
+bool SpekPreferences::get_all_streams()
+{
+    bool result = false;
+    this->config->Read("/general/all_streams", &result);
+    return result;
+}
+
+void SpekPreferences::set_all_streams(bool value)
+{
+    this->config->Write("/general/all_streams", value);
+    this->config->Flush();
+}
+
+bool SpekPreferences::get_all_fft_sizes()
+{
+    bool result = false;
+    this->config->Read("/general/all_fft_sizes", &result);
+    return result;
+}
+
+void SpekPreferences::set_all_fft_sizes(bool value)
+{
+    this->config->Write("/general/all_fft_sizes", value);
+    this->config->Flush();
+}
+
+bool SpekPreferences::get_reduce_rows()
+{
+    bool result = false;
+    this->config->Read("/general/reduce_rows", &result);
+    return result;
+}
+
+void SpekPreferences::set_reduce_rows(bool value)
+{
+    this->config->Write("/general/reduce_rows", value);
+    this->config->Flush();
+}
+
+ColumnPrecision SpekPreferences::get_column_precision()
+{
+    int result = (int)ColumnPrecision::FLOAT;
+    this->config->Read("/general/column_precision", &result);
+    if (result < (int)ColumnPrecision::FLOAT || result > (int)ColumnPrecision::BITS_8) {
+        return ColumnPrecision::FLOAT;
+    }
+    return (ColumnPrecision)result;
+}
+
+void SpekPreferences::set_column_precision(ColumnPrecision value)
+{
+    this->config->Write("/general/column_precision", (int)value);
+    this->config->Flush();
+}
+
+// 0 to analyse files at their own sample rate, however high.
+int SpekPreferences::get_max_sample_rate()
+{
+    int result = 0;
+    this->config->Read("/general/max_sample_rate", &result);
+    return result > 0 ? result : 0;
+}
+
+void SpekPreferences::set_max_sample_rate(int value)
+{
+    this->config->Write("/general/max_sample_rate", value);
+    this->config->Flush();
+}
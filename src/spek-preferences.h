@@ -3,6 +3,8 @@
 #include <wx/fileconf.h>
 #include <wx/intl.h>
 
+#include "spek-columns.h"
+
 class SpekPreferences
 {
 public:
@@ -15,6 +17,16 @@ public:
     void set_last_update(long value);
     wxString get_language();
     void set_language(const wxString& value);
+    bool get_all_streams();
+    void set_all_streams(bool value);
+    bool get_all_fft_sizes();
+    void set_all_fft_sizes(bool value);
+    bool get_reduce_rows();
+    void set_reduce_rows(bool value);
+    ColumnPrecision get_column_precision();
+    void set_column_precision(ColumnPrecision value);
+    int get_max_sample_rate();
+    void set_max_sample_rate(int value);
 
 private:
     SpekPreferences();
@@ -0,0 +1,405 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <memory>
+#include <vector>
+
+#include "spek-analyzer.h"
+#include "spek-api.h"
+#include "spek-audio.h"
+#include "spek-bits.h"
+#include "spek-columns.h"
+#include "spek-cutoff.h"
+#include "spek-fft.h"
+#include "spek-pipeline.h"
+#include "spek-spectrum.h"
+#include "spek-utils.h"
+
+#include "spek-report.h"
+
+enum
+{
+    // Fine enough bands to place a cutoff within 20 Hz, and columns to tell whether it holds
+    // through the whole file.
+    REPORT_FFT_BITS = 12,
+    REPORT_COLUMNS = 256,
+    // Shorter columns for the spectrum, the percentiles are of the levels over them.
+    SPECTRUM_COLUMNS = 2048,
+    LOW_PERCENTILE = 10,
+    HIGH_PERCENTILE = 90,
+    COLUMNS_BLOCK = 16, // Columns read at once, cancelling takes effect between blocks.
+};
+
+// The files of a report, shared by its threads.
+struct spek_batch
+{
+    const std::vector<std::string> *paths;
+    std::ostream *out;
+    std::vector<std::string> lines; // Of the files done but not written out yet.
+    std::vector<bool> done;
+    size_t next; // The next file to analyse.
+    size_t written; // The files written out so far, in order.
+    int failed;
+    const std::atomic<bool> *cancelled;
+    pthread_mutex_t mutex;
+};
+
+// The end of one file's analysis.
+struct spek_report_job
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool done;
+    const std::atomic<bool> *cancelled;
+};
+
+// Forward declarations.
+static void * report_func(void *);
+static bool report_file(
+    const std::string& path, std::string& line, const std::atomic<bool> *cancelled);
+static bool is_cancelled(const std::atomic<bool> *cancelled);
+static spek_pipeline * report_open(
+    const std::string& path, int columns, spek_report_job *job, bool *failed);
+static void report_run(spek_pipeline *pipeline, spek_report_job *job);
+static void report_close(spek_pipeline *pipeline, spek_report_job *job);
+static std::string format_value(double value);
+static std::string format_bits(const SampleBits *bits);
+
+int spek_report(
+    const std::vector<std::string>& paths, int jobs, std::ostream& out,
+    const std::atomic<bool> *cancelled)
+{
+    out << spek_report_header() << std::endl;
+
+    spek_batch report;
+    report.paths = &paths;
+    report.out = &out;
+    report.lines.resize(paths.size());
+    report.done.resize(paths.size());
+    report.next = 0;
+    report.written = 0;
+    report.failed = 0;
+    report.cancelled = cancelled;
+    pthread_mutex_init(&report.mutex, NULL);
+
+    std::vector<pthread_t> threads;
+    jobs = spek_max(1, spek_min(jobs, (int)paths.size()));
+    for (int i = 0; i < jobs; i++) {
+        pthread_t thread;
+        if (!pthread_create(&thread, NULL, &report_func, &report)) {
+            threads.push_back(thread);
+        }
+    }
+    if (threads.empty()) {
+        // Do the work here then.
+        report_func(&report);
+    }
+    for (pthread_t thread : threads) {
+        pthread_join(thread, NULL);
+    }
+
+    pthread_mutex_destroy(&report.mutex);
+    return report.failed;
+}
+
+static void * report_func(void *pp)
+{
+    struct spek_batch *report = (spek_batch*)pp;
+    while (true) {
+        pthread_mutex_lock(&report->mutex);
+        size_t index = report->next++;
+        pthread_mutex_unlock(&report->mutex);
+        if (index >= report->paths->size()) {
+            break;
+        }
+
+        std::string line;
+        bool ok = report_file((*report->paths)[index], line, report->cancelled);
+
+        pthread_mutex_lock(&report->mutex);
+        report->lines[index] = line;
+        report->done[index] = true;
+        if (!ok) {
+            report->failed++;
+        }
+        // Keep the output in order without holding on to all of it.
+        while (report->written < report->done.size() && report->done[report->written]) {
+            *report->out << report->lines[report->written] << std::endl;
+            std::string().swap(report->lines[report->written]);
+            report->written++;
+        }
+        pthread_mutex_unlock(&report->mutex);
+    }
+    return NULL;
+}
+
+static void report_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data)
+{
+    (void)bands;
+    (void)values;
+    (void)envelope;
+    spek_report_job *job = (spek_report_job *)cb_data;
+    // Stop waiting for the rest once cancelled, the pipeline is closed right away.
+    if (sample == -1 || is_cancelled(job->cancelled)) {
+        pthread_mutex_lock(&job->mutex);
+        job->done = true;
+        pthread_cond_signal(&job->cond);
+        pthread_mutex_unlock(&job->mutex);
+    }
+}
+
+static bool report_file(
+    const std::string& path, std::string& line, const std::atomic<bool> *cancelled)
+{
+    std::vector<std::shared_ptr<Analyzer>> analyzers = spek_report_analyzers();
+    // The reason goes in place of the verdict and the rest of the fields are left empty.
+    auto fail = [&] (const std::string& reason) {
+        line = path + "\t" + reason + "\t\t";
+        for (const auto& analyzer : analyzers) {
+            line.append(analyzer->get_results().size(), '\t');
+        }
+        return false;
+    };
+    if (is_cancelled(cancelled)) {
+        return fail("cancelled");
+    }
+
+    spek_report_job job;
+    job.cancelled = cancelled;
+    bool failed;
+    spek_pipeline *pipeline = report_open(path, REPORT_COLUMNS, &job, &failed);
+    if (failed) {
+        // The description ends with the error message.
+        std::string desc = spek_pipeline_desc(pipeline);
+        report_close(pipeline, &job);
+        return fail(desc);
+    }
+
+    for (const auto& analyzer : analyzers) {
+        spek_pipeline_add_analyzer(pipeline, analyzer);
+    }
+    report_run(pipeline, &job);
+    line = spek_report_line(path, analyzers, spek_pipeline_sample_bits(pipeline));
+    report_close(pipeline, &job);
+    if (is_cancelled(cancelled)) {
+        return fail("cancelled");
+    }
+    return true;
+}
+
+// The cutoff detection first, its verdict is the one in the report.
+std::vector<std::shared_ptr<Analyzer>> spek_report_analyzers()
+{
+    std::vector<std::shared_ptr<Analyzer>> analyzers;
+    analyzers.push_back(std::make_shared<CutoffAnalyzer>());
+    for (const auto& name : spek_analyzer_names()) {
+        analyzers.push_back(std::shared_ptr<Analyzer>(spek_analyzer_create(name)));
+    }
+    return analyzers;
+}
+
+std::string spek_report_header()
+{
+    // The names of the results don't depend on the file.
+    std::string header = "path\tverdict\teffective_bits\tsample_peak (dBFS)";
+    for (const auto& analyzer : spek_report_analyzers()) {
+        for (const auto& result : analyzer->get_results()) {
+            header += "\t" + result.name;
+            if (!result.unit.empty()) {
+                header += " (" + result.unit + ")";
+            }
+        }
+    }
+    return header;
+}
+
+std::string spek_report_line(
+    const std::string& path, const std::vector<std::shared_ptr<Analyzer>>& analyzers,
+    const SampleBits *bits)
+{
+    const CutoffAnalyzer *cutoff = (const CutoffAnalyzer *)analyzers.front().get();
+    std::string line = path + "\t" + cutoff->get_verdict() + "\t" + format_bits(bits);
+    for (const auto& analyzer : analyzers) {
+        for (const auto& result : analyzer->get_results()) {
+            line += "\t" + format_value(result.value);
+        }
+    }
+    return line;
+}
+
+bool spek_report_analyse(
+    const std::string& path, const std::vector<std::shared_ptr<Analyzer>>& analyzers,
+    ColumnsRecorder *columns, SampleBits *bits, const std::atomic<bool> *cancelled)
+{
+    if (is_cancelled(cancelled)) {
+        return false;
+    }
+    spek_report_job job;
+    job.cancelled = cancelled;
+    bool failed;
+    spek_pipeline *pipeline = report_open(path, REPORT_COLUMNS, &job, &failed);
+    if (failed) {
+        report_close(pipeline, &job);
+        return false;
+    }
+
+    for (const auto& analyzer : analyzers) {
+        spek_pipeline_add_analyzer(pipeline, analyzer);
+    }
+    if (columns) {
+        columns->add_to(pipeline);
+    }
+    report_run(pipeline, &job);
+    const SampleBits *sample_bits = spek_pipeline_sample_bits(pipeline);
+    if (sample_bits) {
+        *bits = *sample_bits;
+    }
+    report_close(pipeline, &job);
+    return !is_cancelled(cancelled);
+}
+
+int spek_report_spectrum(const std::string& path, std::ostream& out, std::ostream& err)
+{
+    spek_report_job job;
+    job.cancelled = nullptr;
+    bool failed;
+    spek_pipeline *pipeline = report_open(path, SPECTRUM_COLUMNS, &job, &failed);
+    if (failed) {
+        err << path << ": " << spek_pipeline_desc(pipeline) << std::endl;
+        report_close(pipeline, &job);
+        return 1;
+    }
+
+    auto analyzer = std::make_shared<SpectrumAnalyzer>();
+    spek_pipeline_add_analyzer(pipeline, analyzer);
+    report_run(pipeline, &job);
+    report_close(pipeline, &job);
+
+    const SpectrumStats& stats = analyzer->get_stats();
+    out << "frequency (Hz)\tmean (dB)\tp" << LOW_PERCENTILE << " (dB)\tp" << HIGH_PERCENTILE
+        << " (dB)" << std::endl;
+    for (int band = 0; band < stats.get_bands(); band++) {
+        out << format_value(analyzer->get_freq(band)) << "\t"
+            << format_value(stats.get_mean(band)) << "\t"
+            << format_value(stats.get_quantile(band, LOW_PERCENTILE / 100.0)) << "\t"
+            << format_value(stats.get_quantile(band, HIGH_PERCENTILE / 100.0)) << std::endl;
+    }
+    return 0;
+}
+
+bool spek_report_columns(
+    const std::string& path, int channel, int fft_bits, int columns, const std::string& out_path,
+    const std::atomic<bool> *cancelled)
+{
+    spek_analysis *analysis = spek_open_file(path.c_str(), 0, NULL);
+    if (!analysis) {
+        return false;
+    }
+    bool ok =
+        spek_set_channel(analysis, channel) == SPEK_OK &&
+        spek_set_fft_bits(analysis, fft_bits) == SPEK_OK &&
+        spek_set_columns(analysis, columns) == SPEK_OK &&
+        spek_start(analysis) == SPEK_OK;
+    FILE *file = ok ? fopen(out_path.c_str(), "wb") : NULL;
+    if (file) {
+        int bands = (1 << (fft_bits - 1)) + 1;
+        std::vector<float> buffer((size_t)bands * COLUMNS_BLOCK);
+        spek_levels block[COLUMNS_BLOCK];
+        // Written after the columns, three floats each.
+        std::vector<float> levels;
+        int count;
+        while ((count = spek_read_columns_levels(
+                analysis, buffer.data(), block, COLUMNS_BLOCK)) > 0) {
+            if (is_cancelled(cancelled) ||
+                fwrite(buffer.data(), sizeof(float) * bands, count, file) != (size_t)count) {
+                count = -1;
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                levels.insert(levels.end(), { block[i].min, block[i].max, block[i].rms });
+            }
+        }
+        ok = count == 0 &&
+            fwrite(levels.data(), sizeof(float), levels.size(), file) == levels.size();
+        ok = fclose(file) == 0 && ok;
+    }
+    spek_close(analysis);
+    return file && ok;
+}
+
+// Open `path` to be analysed in `columns`, the pipeline tells `job` when it's done and both are
+// closed with report_close(). If the file can't be analysed `failed` is set, the pipeline is
+// there for its description then.
+static spek_pipeline * report_open(
+    const std::string& path, int columns, spek_report_job *job, bool *failed)
+{
+    Audio audio;
+    FFT fft;
+    job->done = false;
+    pthread_mutex_init(&job->mutex, NULL);
+    pthread_cond_init(&job->cond, NULL);
+
+    std::unique_ptr<AudioFile> file = audio.open(path, 0);
+    *failed = !!file->get_error();
+    return spek_pipeline_open(
+        std::move(file), fft.create(REPORT_FFT_BITS), 0, 0, WINDOW_DEFAULT, columns,
+        report_cb, job
+    );
+}
+
+// Run the analysis and wait for the end of it.
+static void report_run(spek_pipeline *pipeline, spek_report_job *job)
+{
+    spek_pipeline_start(pipeline);
+    pthread_mutex_lock(&job->mutex);
+    while (!job->done) {
+        pthread_cond_wait(&job->cond, &job->mutex);
+    }
+    pthread_mutex_unlock(&job->mutex);
+}
+
+// Only then is the job left alone, a cancelled pipeline may still be passing columns on.
+static void report_close(spek_pipeline *pipeline, spek_report_job *job)
+{
+    spek_pipeline_close(pipeline);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->mutex);
+}
+
+static bool is_cancelled(const std::atomic<bool> *cancelled)
+{
+    return cancelled && cancelled->load(std::memory_order_relaxed);
+}
+
+static std::string format_value(double value)
+{
+    char s[32];
+    if (std::isinf(value)) {
+        snprintf(s, sizeof(s), value < 0.0 ? "-inf" : "inf");
+    } else if (value == floor(value) && fabs(value) < 1e15) {
+        snprintf(s, sizeof(s), "%.0f", value);
+    } else {
+        snprintf(s, sizeof(s), "%.2f", value);
+    }
+    return s;
+}
+
+// The effective bits of each channel separated by commas, then the sample peak of them all.
+static std::string format_bits(const SampleBits *bits)
+{
+    if (!bits) {
+        return "\t";
+    }
+    std::string channels;
+    double peak = 0.0;
+    for (int channel = 0; channel < bits->get_channels(); channel++) {
+        if (!channels.empty()) {
+            channels += ",";
+        }
+        channels += std::to_string(bits->get_effective_bits(channel));
+        peak = fmax(peak, bits->get_peak(channel));
+    }
+    return channels + "\t" + format_value(spek_analyzer_db(peak));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Analyzer;
+class ColumnsRecorder;
+class SampleBits;
+
+// Analyses each of `paths` without drawing anything, up to `jobs` files at a time, running the
+// cutoff detection and the built-in analyzers in one pass over each. Writes a header and then a
+// tab-separated line of results per file to `out`, in the order of `paths` and as soon as the
+// files before it are done. Returns the number of files that couldn't be analysed. Once
+// `cancelled` is set the analyses stop soon and the files left fail with "cancelled".
+int spek_report(
+    const std::vector<std::string>& paths, int jobs, std::ostream& out,
+    const std::atomic<bool> *cancelled = nullptr);
+
+// The analyzers behind a line of the report, so that they can go along with a pass over the file
+// made anyway, e.g. for its image, see spek_report_line().
+std::vector<std::shared_ptr<Analyzer>> spek_report_analyzers();
+// The first line of the report, without the end of the line.
+std::string spek_report_header();
+// The line of `path` once `analyzers` from spek_report_analyzers() went through the whole file,
+// with `bits` from spek_pipeline_sample_bits() of the same pass. Without the end of the line.
+std::string spek_report_line(
+    const std::string& path, const std::vector<std::shared_ptr<Analyzer>>& analyzers,
+    const SampleBits *bits);
+// Feeds `path` to `analyzers` in one pass without drawing anything, records its columns in
+// `columns` if set, and copies the bits of its samples to `bits` if they are integers. Returns
+// false if it couldn't, or if `cancelled` was set in the meantime.
+bool spek_report_analyse(
+    const std::string& path, const std::vector<std::shared_ptr<Analyzer>>& analyzers,
+    ColumnsRecorder *columns, SampleBits *bits, const std::atomic<bool> *cancelled = nullptr);
+
+// Analyses `path` in short columns and writes its long-term average spectrum to `out`, a
+// tab-separated line per band with the mean level and the 10th and 90th percentiles of the
+// levels over the columns. Returns 1 after writing the error to `err` if it couldn't.
+int spek_report_spectrum(const std::string& path, std::ostream& out, std::ostream& err);
+
+// Writes the `columns` of `channel` in `path`, with 2^`fft_bits` samples per DFT, to `out_path`
+// as 32-bit floats in dBFS, one column of bands after the other, through the C API. They are
+// followed by the lowest, the highest and the RMS sample value of each column, also 32-bit
+// floats. Returns false if it couldn't, or if `cancelled` was set in the meantime.
+bool spek_report_columns(
+    const std::string& path, int channel, int fft_bits, int columns, const std::string& out_path,
+    const std::atomic<bool> *cancelled = nullptr);
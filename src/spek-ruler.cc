@@ -9,7 +9,7 @@ SpekRuler::SpekRuler(
     :
     x(x), y(y), pos(pos), sample_label(sample_label),
     factors(factors), min_units(min_units), max_units(max_units), spacing(spacing),
-    scale(scale), offset(offset), formatter(formatter)
+    scale(scale), offset(offset), formatter(formatter), logarithmic(false)
 {
 }
 
@@ -32,8 +32,41 @@ void SpekRuler::draw(wxDC& dc)
     this->draw_tick(dc, min_units);
     this->draw_tick(dc, max_units);
 
+    if (this->logarithmic) {
+        // 1, 2 and 5 times the powers of ten if there is room for them, the powers alone if not.
+        static const int all_steps[] = {1, 2, 5, 0};
+        static const int power_steps[] = {1, 0};
+        const int *steps = NULL;
+        if (fabs(this->scale * log(2.0)) >= this->spacing * len) {
+            steps = all_steps;
+        } else if (fabs(this->scale * log(10.0)) >= this->spacing * len) {
+            steps = power_steps;
+        }
+        double prev = this->position(min_units);
+        for (int power = 1; steps && power <= max_units; power *= 10) {
+            for (int i = 0; steps[i]; i++) {
+                int tick = steps[i] * power;
+                if (tick <= min_units) {
+                    continue;
+                }
+                if (tick >= max_units ||
+                    fabs(this->position(max_units) - this->position(tick)) < len * 1.2) {
+                    return;
+                }
+                if (fabs(this->position(tick) - prev) < len * 1.2) {
+                    continue;
+                }
+                this->draw_tick(dc, tick);
+                prev = this->position(tick);
+            }
+        }
+        return;
+    }
+
     if (factor > 0) {
-        for (int tick = min_units + factor; tick < max_units; tick += factor) {
+        // Round numbers even if the range doesn't start at one, e.g. when zoomed in.
+        int first = min_units - ((min_units % factor) + factor) % factor + factor;
+        for (int tick = first; tick < max_units; tick += factor) {
             if (fabs(this->scale * (max_units - tick)) < len * 1.2) {
                 break;
             }
@@ -48,9 +81,7 @@ void SpekRuler::draw_tick(wxDC& dc, int tick)
     double TICK_LEN = 4;
 
     wxString label = this->formatter(tick);
-    int value = this->pos == TOP || this->pos == BOTTOM ?
-        tick : this->max_units + this->min_units - tick;
-    double p = this->offset + this->scale * (value - min_units);
+    double p = this->position(tick);
     wxSize size = dc.GetTextExtent(label);
     int w = size.GetWidth();
     int h = size.GetHeight();
@@ -75,3 +106,17 @@ void SpekRuler::draw_tick(wxDC& dc, int tick)
         dc.DrawLine(this->x, this->y + p, this->x - TICK_LEN, this->y + p);
     }
 }
+
+// Pixels from the start of the ruler, the vertical ones go from the bottom up.
+double SpekRuler::position(int tick) const
+{
+    auto along = [this] (int units) {
+        if (this->logarithmic) {
+            return this->scale * log((double)units / this->min_units);
+        }
+        return this->scale * (units - this->min_units);
+    };
+    double p = this->pos == TOP || this->pos == BOTTOM ?
+        along(tick) : along(this->max_units) - along(tick);
+    return this->offset + p;
+}
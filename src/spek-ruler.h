@@ -22,10 +22,15 @@ public:
         double scale, double offset, formatter_cb formatter
     );
 
+    // Space the ticks logarithmically, `scale` is then in pixels per e-fold of the units and
+    // the labels go on 1, 2 and 5 times the powers of ten.
+    void set_logarithmic(bool logarithmic) { this->logarithmic = logarithmic; }
+
     void draw(wxDC& dc);
 
 protected:
     void draw_tick(wxDC& dc, int tick);
+    double position(int tick) const;
 
     int x;
     int y;
@@ -38,4 +43,5 @@ protected:
     double scale;
     double offset;
     formatter_cb formatter;
+    bool logarithmic;
 };
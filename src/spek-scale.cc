@@ -0,0 +1,106 @@
+#include <math.h>
+
+#include "spek-scale.h"
+
+double spek_scale_position(enum frequency_scale scale, double freq, double low, double high)
+{
+    if (scale == SCALE_LINEAR) {
+        return (freq - low) / (high - low);
+    }
+    return log(freq / low) / log(high / low);
+}
+
+double spek_scale_freq(enum frequency_scale scale, double position, double low, double high)
+{
+    if (scale == SCALE_LINEAR) {
+        return low + position * (high - low);
+    }
+    return low * pow(high / low, position);
+}
+
+void ScaleKernel::create(
+    enum frequency_scale scale, int bands, double band_low, double band_high,
+    int rows, double low, double high)
+{
+    this->rows = rows;
+    this->first_band = bands;
+    this->last_band = -1;
+    this->row_begin.assign(1, 0);
+    this->row_bands.clear();
+    this->weights.clear();
+    this->power.assign(bands, 0.0f);
+
+    // Positions are in bands from here on, each band covers half a band either side.
+    double spacing = (band_high - band_low) / (bands - 1);
+    auto add = [&] (int band, double weight) {
+        if (band < 0 || band >= bands || weight <= 0.0) {
+            return;
+        }
+        this->row_bands.push_back(band);
+        this->weights.push_back((float)weight);
+        this->first_band = band < this->first_band ? band : this->first_band;
+        this->last_band = band > this->last_band ? band : this->last_band;
+    };
+    // Rows narrower than the bands are interpolated between the two nearest ones.
+    auto interpolate = [&] (double position) {
+        int band = (int)floor(position);
+        double t = position - band;
+        add(band, 1.0 - t);
+        add(band + 1, t);
+    };
+
+    for (int row = 0; row < rows; row++) {
+        size_t begin = this->weights.size();
+        if (scale == SCALE_LOG) {
+            double first = (spek_scale_freq(scale, row / (double)rows, low, high) - band_low)
+                / spacing;
+            double last = (spek_scale_freq(scale, (row + 1) / (double)rows, low, high) - band_low)
+                / spacing;
+            if (last - first < 1.0) {
+                interpolate((first + last) / 2.0);
+            } else {
+                for (int band = (int)ceil(first - 0.5); band <= (int)floor(last + 0.5); band++) {
+                    add(band, fmin(last, band + 0.5) - fmax(first, band - 0.5));
+                }
+            }
+        } else {
+            double center = spek_scale_freq(scale, (row + 0.5) / rows, low, high);
+            double ratio = pow(high / low, 1.0 / rows);
+            double first = (center / ratio - band_low) / spacing;
+            double last = (center * ratio - band_low) / spacing;
+            for (int band = (int)ceil(first); band <= (int)floor(last); band++) {
+                double freq = band_low + band * spacing;
+                double x = freq > 0.0 ? log(freq / center) / log(ratio) : -1.0;
+                add(band, 0.5 + 0.5 * cos(M_PI * x));
+            }
+            if (this->weights.size() == begin) {
+                interpolate((center - band_low) / spacing);
+            }
+        }
+
+        // Unity gain, a flat spectrum gives the same level in every row.
+        double sum = 0.0;
+        for (size_t i = begin; i < this->weights.size(); i++) {
+            sum += this->weights[i];
+        }
+        for (size_t i = begin; i < this->weights.size() && sum > 0.0; i++) {
+            this->weights[i] /= sum;
+        }
+        this->row_begin.push_back(this->weights.size());
+    }
+}
+
+void ScaleKernel::apply(const float *bands, float *rows)
+{
+    // From dB back to power, 10^(x/10).
+    for (int band = this->first_band; band <= this->last_band; band++) {
+        this->power[band] = expf(bands[band] * 0.230258509f);
+    }
+    for (int row = 0; row < this->rows; row++) {
+        float sum = 0.0f;
+        for (int i = this->row_begin[row]; i < this->row_begin[row + 1]; i++) {
+            sum += this->weights[i] * this->power[this->row_bands[i]];
+        }
+        rows[row] = 10.0f * log10f(sum);
+    }
+}
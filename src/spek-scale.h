@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+enum frequency_scale {
+    SCALE_LINEAR,
+    SCALE_LOG,
+    SCALE_CQT,
+    SCALE_COUNT,
+};
+
+// The lowest frequency shown by the non-linear scales, there is little to see below it.
+static const double SCALE_MIN_FREQ = 20.0;
+
+// Where `freq` is on the axis from `low` to `high`, from 0 at the bottom to 1 at the top, and
+// the other way around.
+double spek_scale_position(enum frequency_scale scale, double freq, double low, double high);
+double spek_scale_freq(enum frequency_scale scale, double position, double low, double high);
+
+// Computes the rows of a non-linear frequency axis from the bands of a linear spectrum. Each
+// row is a weighted sum of the power of the few bands around it, the weights are kept as a
+// sparse matrix so that the work is proportional to the bands and rows actually used.
+//
+// SCALE_LOG rows average the bands between their edges, SCALE_CQT rows have a window a row wide
+// either side of their centre, so that their bandwidth is a constant fraction of it.
+class ScaleKernel
+{
+public:
+    ScaleKernel() : rows(0) {}
+
+    // The `bands` go linearly from `band_low` to `band_high` Hz, the rows from `low` to `high`.
+    void create(
+        enum frequency_scale scale, int bands, double band_low, double band_high,
+        int rows, double low, double high);
+    bool empty() const { return !this->rows; }
+    int get_rows() const { return this->rows; }
+
+    // Both the bands and the rows are in dB.
+    void apply(const float *bands, float *rows);
+
+private:
+    int rows;
+    int first_band; // The range of bands used by any row.
+    int last_band;
+    std::vector<int> row_begin; // Where each row's weights start, plus one past the last.
+    std::vector<int> row_bands;
+    std::vector<float> weights;
+    std::vector<float> power; // Scratch space for the bands as power.
+};
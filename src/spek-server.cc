@@ -0,0 +1,806 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OS_WIN
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "spek-report.h"
+#include "spek-utils.h"
+
+#include "spek-server.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+enum
+{
+    CACHE_ENTRIES = 1024, // Results kept on disk, the least recently used go first.
+    DEFAULT_WIDTH = 1024,
+    DEFAULT_HEIGHT = 512,
+    DATA_FFT_BITS = 11,
+    MAX_LINE = 64 * 1024, // Longer requests are dropped along with the client.
+    RESULTS_VERSION = 2, // Part of the cache keys, raised when the results change.
+};
+
+#ifndef OS_WIN
+
+// A client, shared by its threads and the jobs it's waiting for. The responses are queued and
+// sent by a thread of its own, so that a client slow to read them holds up nobody else.
+struct spek_connection
+{
+    explicit spek_connection(int fd) : fd(fd), closed(false)
+    {
+        pthread_mutex_init(&this->mutex, NULL);
+        pthread_cond_init(&this->cond, NULL);
+    }
+    ~spek_connection()
+    {
+        close(this->fd);
+        pthread_cond_destroy(&this->cond);
+        pthread_mutex_destroy(&this->mutex);
+    }
+
+    int fd;
+    pthread_mutex_t mutex; // Guards the output and the flag.
+    pthread_cond_t cond;
+    std::deque<std::string> output; // Whole lines, in order.
+    bool closed; // Nothing more is sent once the client is gone.
+};
+
+// A request waiting for the result of a job.
+struct spek_waiter
+{
+    std::shared_ptr<spek_connection> connection;
+    std::string id;
+};
+
+struct spek_job
+{
+    // Of the first client, the others asked for the same result. The priority is the highest
+    // of them while the job is queued.
+    spek_request request;
+    std::string key;
+    std::string path; // Of the result in the cache.
+    std::vector<spek_waiter> waiters;
+    std::atomic<bool> cancelled;
+    bool running;
+    uint64_t sequence; // First come, first served among the same priority.
+};
+
+struct spek_server
+{
+    std::string socket_path;
+    std::string cache_dir;
+    spek_server_render_cb render_cb;
+    int listen_fd;
+    int wake_fds[2]; // Written to by spek_server_stop().
+    std::vector<pthread_t> workers;
+
+    pthread_mutex_t mutex; // Guards everything below.
+    pthread_cond_t cond;
+    std::vector<std::shared_ptr<spek_job>> queue; // A heap, see job_less().
+    std::map<std::string, std::shared_ptr<spek_job>> jobs; // Queued or running, by key.
+    std::list<std::string> cached; // Keys of the results, the most recently used first.
+    std::map<std::string, std::list<std::string>::iterator> cache_index;
+    std::set<spek_connection*> connections;
+    int connection_threads;
+    int running;
+    uint64_t sequence;
+    int64_t hits;
+    int64_t misses;
+    int64_t failures;
+    bool quit;
+};
+
+struct spek_client
+{
+    spek_server *server;
+    std::shared_ptr<spek_connection> connection;
+};
+
+// Forward declarations.
+static void * worker_func(void *);
+static void * client_func(void *);
+static void * writer_func(void *);
+static void handle_line(spek_server *s, const std::shared_ptr<spek_connection>& c,
+    const std::string& line);
+static void handle_request(spek_server *s, const std::shared_ptr<spek_connection>& c,
+    const spek_request& request);
+static void handle_cancel(spek_server *s, const std::shared_ptr<spek_connection>& c,
+    const std::string& id);
+static bool parse_request(const std::vector<std::string>& fields, spek_request& request,
+    std::string& error);
+static void drop_waiters(spek_server *s, spek_connection *c);
+static void cancel_job(spek_server *s, const std::shared_ptr<spek_job>& job);
+static void cache_add(spek_server *s, const std::string& key);
+static bool job_less(const std::shared_ptr<spek_job>& a, const std::shared_ptr<spek_job>& b);
+static void send_line(spek_connection *c, const std::string& line);
+static std::vector<std::string> split(const std::string& s, char separator);
+static std::string result_key(const spek_request& request, const struct stat& st);
+
+struct spek_server * spek_server_open(
+    const std::string& socket_path, const std::string& cache_dir, int jobs,
+    spek_server_render_cb render_cb, std::string *error
+)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        *error = "The socket path is empty or too long";
+        return NULL;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+
+    // A socket left behind by a server that's gone can be taken over, a live one can't. Anything
+    // else at the path is left alone.
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            *error = socket_path + " exists and isn't a socket";
+            return NULL;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            *error = strerror(errno);
+            return NULL;
+        }
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            close(fd);
+            *error = "Another server is listening on " + socket_path;
+            return NULL;
+        }
+        close(fd);
+        unlink(socket_path.c_str());
+    } else if (errno != ENOENT) {
+        *error = strerror(errno);
+        return NULL;
+    }
+
+    // Only for the user's own clients: nobody can connect before listen(), and the mode is
+    // set by then.
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool bound = false;
+    if (fd < 0 ||
+        !(bound = bind(fd, (struct sockaddr *)&address, sizeof(address)) == 0) ||
+        chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        *error = strerror(errno);
+        if (bound) {
+            unlink(socket_path.c_str());
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    spek_server *s = new spek_server();
+    s->socket_path = socket_path;
+    s->cache_dir = cache_dir;
+    s->render_cb = render_cb;
+    s->listen_fd = fd;
+    if (pipe(s->wake_fds) != 0) {
+        *error = strerror(errno);
+        close(fd);
+        unlink(socket_path.c_str());
+        delete s;
+        return NULL;
+    }
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->connection_threads = 0;
+    s->running = 0;
+    s->sequence = 0;
+    s->hits = 0;
+    s->misses = 0;
+    s->failures = 0;
+    s->quit = false;
+
+    for (int i = 0; i < spek_max(1, jobs); i++) {
+        pthread_t thread;
+        if (!pthread_create(&thread, NULL, &worker_func, s)) {
+            s->workers.push_back(thread);
+        }
+    }
+    if (s->workers.empty()) {
+        *error = "Cannot start the workers";
+        spek_server_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+void spek_server_run(struct spek_server *s)
+{
+    while (true) {
+        struct pollfd fds[2];
+        fds[0].fd = s->listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = s->wake_fds[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        spek_client *client = new spek_client();
+        client->server = s;
+        client->connection = std::make_shared<spek_connection>(fd);
+
+        pthread_mutex_lock(&s->mutex);
+        s->connections.insert(client->connection.get());
+        s->connection_threads++;
+        pthread_mutex_unlock(&s->mutex);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, &client_func, client)) {
+            pthread_mutex_lock(&s->mutex);
+            s->connections.erase(client->connection.get());
+            s->connection_threads--;
+            pthread_mutex_unlock(&s->mutex);
+            delete client;
+        }
+        pthread_attr_destroy(&attr);
+    }
+}
+
+void spek_server_stop(struct spek_server *s)
+{
+    char c = 0;
+    ssize_t ret = write(s->wake_fds[1], &c, 1);
+    (void)ret;
+}
+
+void spek_server_close(struct spek_server *s)
+{
+    pthread_mutex_lock(&s->mutex);
+    s->quit = true;
+    for (auto& item : s->jobs) {
+        item.second->cancelled = true;
+    }
+    // The clients' threads see the end of their input and go.
+    for (spek_connection *c : s->connections) {
+        shutdown(c->fd, SHUT_RDWR);
+    }
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+
+    for (pthread_t thread : s->workers) {
+        pthread_join(thread, NULL);
+    }
+    pthread_mutex_lock(&s->mutex);
+    while (s->connection_threads) {
+        pthread_cond_wait(&s->cond, &s->mutex);
+    }
+    pthread_mutex_unlock(&s->mutex);
+
+    close(s->listen_fd);
+    unlink(s->socket_path.c_str());
+    close(s->wake_fds[0]);
+    close(s->wake_fds[1]);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    delete s;
+}
+
+static void * worker_func(void *pp)
+{
+    spek_server *s = (spek_server *)pp;
+    while (true) {
+        pthread_mutex_lock(&s->mutex);
+        while (s->queue.empty() && !s->quit) {
+            pthread_cond_wait(&s->cond, &s->mutex);
+        }
+        if (s->quit) {
+            pthread_mutex_unlock(&s->mutex);
+            break;
+        }
+        std::pop_heap(s->queue.begin(), s->queue.end(), job_less);
+        std::shared_ptr<spek_job> job = s->queue.back();
+        s->queue.pop_back();
+        if (job->cancelled) {
+            // Nobody is waiting for it any more.
+            pthread_mutex_unlock(&s->mutex);
+            continue;
+        }
+        job->running = true;
+        s->running++;
+        pthread_mutex_unlock(&s->mutex);
+
+        // Written next to the result and renamed, so that it's never seen half done.
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%llu.tmp", (unsigned long long)job->sequence);
+        std::string tmp_path = job->path + suffix;
+        bool ok;
+        if (job->request.type == REQUEST_DATA) {
+            ok = spek_report_columns(
+                job->request.path, job->request.channel, job->request.fft_bits,
+                job->request.width, tmp_path, &job->cancelled
+            );
+        } else {
+            ok = s->render_cb && s->render_cb(&job->request, tmp_path, &job->cancelled);
+        }
+        ok = ok && rename(tmp_path.c_str(), job->path.c_str()) == 0;
+        if (!ok) {
+            unlink(tmp_path.c_str());
+        }
+
+        pthread_mutex_lock(&s->mutex);
+        s->running--;
+        auto current = s->jobs.find(job->key);
+        if (current != s->jobs.end() && current->second == job) {
+            s->jobs.erase(current);
+        }
+        if (ok) {
+            cache_add(s, job->key);
+        } else if (!job->cancelled) {
+            s->failures++;
+        }
+        std::vector<spek_waiter> waiters;
+        waiters.swap(job->waiters);
+        pthread_mutex_unlock(&s->mutex);
+
+        for (const auto& waiter : waiters) {
+            send_line(
+                waiter.connection.get(),
+                ok ? "ok\t" + waiter.id + "\t" + job->path + "\tmiss" :
+                    "error\t" + waiter.id + "\tCannot analyse the file"
+            );
+        }
+    }
+    return NULL;
+}
+
+static void * client_func(void *pp)
+{
+    spek_client *client = (spek_client *)pp;
+    spek_server *s = client->server;
+    std::shared_ptr<spek_connection> c = client->connection;
+    delete client;
+
+    pthread_t writer;
+    bool has_writer = !pthread_create(&writer, NULL, &writer_func, c.get());
+
+    std::string input;
+    char buffer[4096];
+    while (has_writer) {
+        ssize_t len = read(c->fd, buffer, sizeof(buffer));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            break;
+        }
+        input.append(buffer, len);
+        size_t start = 0, end;
+        while ((end = input.find('\n', start)) != std::string::npos) {
+            std::string line = input.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                handle_line(s, c, line);
+            }
+            start = end + 1;
+        }
+        input.erase(0, start);
+        if (input.size() > MAX_LINE) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    c->closed = true;
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+    if (has_writer) {
+        // Its send() fails if it's stuck on a client that stopped reading.
+        shutdown(c->fd, SHUT_WR);
+        pthread_join(writer, NULL);
+    }
+    drop_waiters(s, c.get());
+
+    pthread_mutex_lock(&s->mutex);
+    s->connections.erase(c.get());
+    // The jobs still running may hold on to the connection, it's closed after the last of them.
+    c.reset();
+    s->connection_threads--;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static void handle_line(spek_server *s, const std::shared_ptr<spek_connection>& c,
+    const std::string& line)
+{
+    std::vector<std::string> fields = split(line, '\t');
+    const std::string& command = fields[0];
+    if (command == "cancel" && fields.size() == 2) {
+        handle_cancel(s, c, fields[1]);
+    } else if (command == "stats") {
+        pthread_mutex_lock(&s->mutex);
+        int queued = 0;
+        for (const auto& item : s->jobs) {
+            queued += !item.second->running;
+        }
+        char stats[256];
+        snprintf(
+            stats, sizeof(stats),
+            "stats\tqueued=%d\trunning=%d\tcached=%d\thits=%lld\tmisses=%lld\tfailures=%lld",
+            queued, s->running, (int)s->cached.size(),
+            (long long)s->hits, (long long)s->misses, (long long)s->failures
+        );
+        pthread_mutex_unlock(&s->mutex);
+        send_line(c.get(), stats);
+    } else {
+        spek_request request;
+        std::string error;
+        if (parse_request(fields, request, error)) {
+            handle_request(s, c, request);
+        } else {
+            send_line(c.get(), "error\t" + (fields.size() > 1 ? fields[1] : "") + "\t" + error);
+        }
+    }
+}
+
+static void handle_request(spek_server *s, const std::shared_ptr<spek_connection>& c,
+    const spek_request& request)
+{
+    struct stat st;
+    if (stat(request.path.c_str(), &st) != 0) {
+        send_line(c.get(), "error\t" + request.id + "\t" + strerror(errno));
+        return;
+    }
+    std::string key = result_key(request, st);
+    std::string path = s->cache_dir + "/" + key +
+        (request.type == REQUEST_RENDER ? ".png" : ".f32");
+
+    pthread_mutex_lock(&s->mutex);
+    // Results of a previous run are taken in as well.
+    if (access(path.c_str(), F_OK) == 0) {
+        cache_add(s, key);
+        s->hits++;
+        pthread_mutex_unlock(&s->mutex);
+        send_line(c.get(), "ok\t" + request.id + "\t" + path + "\thit");
+        return;
+    }
+    auto cached = s->cache_index.find(key);
+    if (cached != s->cache_index.end()) {
+        // Removed behind our back.
+        s->cached.erase(cached->second);
+        s->cache_index.erase(cached);
+    }
+    s->misses++;
+
+    spek_waiter waiter;
+    waiter.connection = c;
+    waiter.id = request.id;
+    auto running = s->jobs.find(key);
+    if (running != s->jobs.end()) {
+        spek_job *job = running->second.get();
+        job->waiters.push_back(waiter);
+        if (!job->running && request.priority > job->request.priority) {
+            // Served as soon as the most urgent of its requests.
+            job->request.priority = request.priority;
+            std::make_heap(s->queue.begin(), s->queue.end(), job_less);
+        }
+        pthread_mutex_unlock(&s->mutex);
+        return;
+    }
+    auto job = std::make_shared<spek_job>();
+    job->request = request;
+    job->key = key;
+    job->path = path;
+    job->waiters.push_back(waiter);
+    job->cancelled = false;
+    job->running = false;
+    job->sequence = s->sequence++;
+    s->jobs[key] = job;
+    s->queue.push_back(job);
+    std::push_heap(s->queue.begin(), s->queue.end(), job_less);
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+static void handle_cancel(spek_server *s, const std::shared_ptr<spek_connection>& c,
+    const std::string& id)
+{
+    bool found = false;
+    pthread_mutex_lock(&s->mutex);
+    for (auto& item : s->jobs) {
+        auto& waiters = item.second->waiters;
+        for (size_t i = 0; i < waiters.size(); i++) {
+            if (waiters[i].connection == c && waiters[i].id == id) {
+                waiters.erase(waiters.begin() + i);
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            // The others still want it.
+            if (waiters.empty()) {
+                cancel_job(s, item.second);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s->mutex);
+    send_line(c.get(), "error\t" + id + "\t" + (found ? "Cancelled" : "Unknown request"));
+}
+
+static bool parse_request(const std::vector<std::string>& fields, spek_request& request,
+    std::string& error)
+{
+    if (fields[0] == "render") {
+        request.type = REQUEST_RENDER;
+    } else if (fields[0] == "data") {
+        request.type = REQUEST_DATA;
+    } else {
+        error = "Unknown command";
+        return false;
+    }
+    if (fields.size() < 3 || fields[1].empty() || fields[2].empty()) {
+        error = "Missing ID or path";
+        return false;
+    }
+    request.id = fields[1];
+    request.path = fields[2];
+    request.width = DEFAULT_WIDTH;
+    request.height = DEFAULT_HEIGHT;
+    request.channel = 0;
+    request.fft_bits = request.type == REQUEST_DATA ? DATA_FFT_BITS : 0;
+    request.palette = PALETTE_DEFAULT;
+    request.priority = 0;
+
+    static const char *palettes[] = { "spectrum", "sox", "mono" };
+    for (size_t i = 3; i < fields.size(); i++) {
+        size_t equals = fields[i].find('=');
+        std::string name = fields[i].substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : fields[i].substr(equals + 1);
+        char *end = NULL;
+        long number = strtol(value.c_str(), &end, 10);
+        bool is_number = !value.empty() && !*end;
+        if (name == "palette") {
+            int palette = 0;
+            while (palette < PALETTE_COUNT && value != palettes[palette]) {
+                palette++;
+            }
+            if (palette == PALETTE_COUNT) {
+                error = "Unknown palette " + value;
+                return false;
+            }
+            request.palette = (enum palette)palette;
+        } else if (!is_number) {
+            error = "Bad value of " + name;
+            return false;
+        } else if (name == "width" && number > 0 && number <= 65536) {
+            request.width = number;
+        } else if (name == "height" && number > 0 && number <= 65536) {
+            request.height = number;
+        } else if (name == "channel" && number >= 0) {
+            request.channel = number;
+        } else if (name == "fft" && number >= 8 && number <= 16) {
+            request.fft_bits = number;
+        } else if (name == "priority") {
+            request.priority = number;
+        } else {
+            error = "Bad parameter " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Forget the requests of a client that's gone, and the jobs nobody else is waiting for.
+static void drop_waiters(spek_server *s, spek_connection *c)
+{
+    pthread_mutex_lock(&s->mutex);
+    std::vector<std::shared_ptr<spek_job>> abandoned;
+    for (auto& item : s->jobs) {
+        auto& waiters = item.second->waiters;
+        size_t before = waiters.size();
+        waiters.erase(
+            std::remove_if(waiters.begin(), waiters.end(), [c](const spek_waiter& waiter) {
+                return waiter.connection.get() == c;
+            }),
+            waiters.end()
+        );
+        if (before && waiters.empty()) {
+            abandoned.push_back(item.second);
+        }
+    }
+    for (const auto& job : abandoned) {
+        cancel_job(s, job);
+    }
+    pthread_mutex_unlock(&s->mutex);
+}
+
+// Let the job go, a new request for the same result starts another one. Called with the mutex
+// held.
+static void cancel_job(spek_server *s, const std::shared_ptr<spek_job>& job)
+{
+    job->cancelled = true;
+    s->jobs.erase(job->key);
+}
+
+// Mark the result as the most recently used and remove the least recently used ones beyond
+// the limit. Called with the mutex held.
+static void cache_add(spek_server *s, const std::string& key)
+{
+    auto cached = s->cache_index.find(key);
+    if (cached != s->cache_index.end()) {
+        s->cached.erase(cached->second);
+    }
+    s->cached.push_front(key);
+    s->cache_index[key] = s->cached.begin();
+    while (s->cached.size() > CACHE_ENTRIES) {
+        const std::string& last = s->cached.back();
+        // The other type of result may have the same key, removing a missing file is harmless.
+        unlink((s->cache_dir + "/" + last + ".png").c_str());
+        unlink((s->cache_dir + "/" + last + ".f32").c_str());
+        s->cache_index.erase(last);
+        s->cached.pop_back();
+    }
+}
+
+// The heap puts the highest priority on top, then the oldest request.
+static bool job_less(const std::shared_ptr<spek_job>& a, const std::shared_ptr<spek_job>& b)
+{
+    if (a->request.priority != b->request.priority) {
+        return a->request.priority < b->request.priority;
+    }
+    return a->sequence > b->sequence;
+}
+
+// Queue the line for the writer of the connection, doesn't wait for it to be sent.
+static void send_line(spek_connection *c, const std::string& line)
+{
+    pthread_mutex_lock(&c->mutex);
+    if (!c->closed) {
+        c->output.push_back(line + "\n");
+        pthread_cond_signal(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+}
+
+// Send the queued lines until the client is gone, the queue isn't locked while sending.
+static void * writer_func(void *pp)
+{
+    spek_connection *c = (spek_connection *)pp;
+    pthread_mutex_lock(&c->mutex);
+    while (true) {
+        while (c->output.empty() && !c->closed) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+        }
+        if (c->closed) {
+            break;
+        }
+        std::string data = std::move(c->output.front());
+        c->output.pop_front();
+        pthread_mutex_unlock(&c->mutex);
+
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t len = send(c->fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            if (len <= 0) {
+                break;
+            }
+            sent += len;
+        }
+
+        pthread_mutex_lock(&c->mutex);
+        if (sent < data.size()) {
+            c->closed = true;
+        }
+    }
+    c->output.clear();
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+static std::vector<std::string> split(const std::string& s, char separator)
+{
+    std::vector<std::string> fields;
+    size_t start = 0, end;
+    while ((end = s.find(separator, start)) != std::string::npos) {
+        fields.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    fields.push_back(s.substr(start));
+    return fields;
+}
+
+// 64-bit FNV-1a of everything the result depends on, the same from one run to the next. The
+// device and the inode tell apart a file replaced by another with the same size and time.
+static std::string result_key(const spek_request& request, const struct stat& st)
+{
+    // The data doesn't depend on the height and the palette of the image.
+    bool image = request.type == REQUEST_RENDER;
+    char params[256];
+    snprintf(
+        params, sizeof(params), "\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%lld\t%lld\t%llu\t%llu",
+        RESULTS_VERSION, request.type, request.width, image ? request.height : 0,
+        request.channel, request.fft_bits, image ? request.palette : 0, (long long)st.st_size,
+        spek_mtime_ns(st), (unsigned long long)st.st_dev, (unsigned long long)st.st_ino
+    );
+    std::string data = request.path + params;
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return key;
+}
+
+#else
+
+struct spek_server * spek_server_open(
+    const std::string& socket_path, const std::string& cache_dir, int jobs,
+    spek_server_render_cb render_cb, std::string *error
+)
+{
+    (void)socket_path;
+    (void)cache_dir;
+    (void)jobs;
+    (void)render_cb;
+    *error = "Not supported on this platform";
+    return NULL;
+}
+
+void spek_server_run(struct spek_server *server)
+{
+    (void)server;
+}
+
+void spek_server_stop(struct spek_server *server)
+{
+    (void)server;
+}
+
+void spek_server_close(struct spek_server *server)
+{
+    (void)server;
+}
+
+#endif
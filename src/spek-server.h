@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "spek-palette.h"
+
+struct spek_server;
+
+enum request_type {
+    REQUEST_RENDER, // A PNG image of the spectrogram.
+    REQUEST_DATA, // The columns and their sample levels, see spek_report_columns().
+};
+
+// One request of a client, see spek_server_open() for the protocol.
+struct spek_request
+{
+    enum request_type type;
+    std::string id;
+    std::string path;
+    int width; // Of the image, or the number of columns for the data.
+    int height;
+    int channel;
+    int fft_bits; // 0 for the size that suits the height of the image.
+    enum palette palette;
+    int priority; // The higher, the sooner.
+};
+
+// Saves the image of a render request to `out_path`, on a worker thread of the server. Returns
+// false if it can't, or if `cancelled` was set in the meantime.
+typedef bool (*spek_server_render_cb)(
+    const spek_request *request, const std::string& out_path,
+    const std::atomic<bool> *cancelled);
+
+// Listen on the Unix domain socket at `socket_path`, results are kept in `cache_dir` and made
+// by `jobs` worker threads. Returns NULL with the reason in `error` if it can't listen there.
+//
+// Clients send one request per line, tab-separated, and get one line back per render or data
+// request once it's done, in the order they're done:
+//
+//     render <TAB> ID <TAB> PATH [<TAB> KEY=VALUE ...]
+//     data <TAB> ID <TAB> PATH [<TAB> KEY=VALUE ...]
+//     cancel <TAB> ID
+//     stats
+//
+//     ok <TAB> ID <TAB> RESULT PATH <TAB> hit|miss
+//     error <TAB> ID <TAB> MESSAGE
+//     stats <TAB> KEY=VALUE ...
+//
+// The keys are width, height, channel, fft, palette (spectrum, sox or mono) and priority. The
+// ID is the client's and only has to be unique among its own requests in progress. Results
+// are cached by the request and the size and modification time of the file, requests for a
+// result already being made wait for the same job, and a job is cancelled once all of its
+// requests are. Not available on Windows.
+struct spek_server * spek_server_open(
+    const std::string& socket_path, const std::string& cache_dir, int jobs,
+    spek_server_render_cb render_cb, std::string *error
+);
+// Accept the clients until spek_server_stop() is called.
+void spek_server_run(struct spek_server *server);
+// Make spek_server_run() return. Safe to call from any thread and from signal handlers.
+void spek_server_stop(struct spek_server *server);
+// Cancel the jobs, disconnect the clients and remove the socket.
+void spek_server_close(struct spek_server *server);
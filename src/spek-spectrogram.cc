@@ -1,12 +1,24 @@
 #include <cmath>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
 
 #include <wx/dcbuffer.h>
 
 #include "spek-audio.h"
+#include "spek-bits.h"
+#include "spek-columns.h"
 #include "spek-events.h"
 #include "spek-fft.h"
+#include "spek-loudness.h"
 #include "spek-platform.h"
+#include "spek-png.h"
+#include "spek-preferences.h"
 #include "spek-ruler.h"
+#include "spek-trace.h"
 #include "spek-utils.h"
 
 #include "spek-spectrogram.h"
@@ -15,7 +27,11 @@ BEGIN_EVENT_TABLE(SpekSpectrogram, wxWindow)
     EVT_CHAR(SpekSpectrogram::on_char)
     EVT_PAINT(SpekSpectrogram::on_paint)
     EVT_SIZE(SpekSpectrogram::on_size)
+    EVT_LEFT_DOWN(SpekSpectrogram::on_left_down)
+    EVT_MOTION(SpekSpectrogram::on_motion)
+    EVT_LEFT_UP(SpekSpectrogram::on_left_up)
     SPEK_EVT_HAVE_SAMPLE(SpekSpectrogram::on_have_sample)
+    EVT_TIMER(-1, SpekSpectrogram::on_restart)
 END_EVENT_TABLE()
 
 enum
@@ -28,14 +44,117 @@ enum
     MIN_FFT_BITS = 8,
     MAX_FFT_BITS = 14,
     LPAD = 60,
-    TPAD = 60,
+    TPAD = 100,
     RPAD = 90,
     BPAD = 40,
     GAP = 10,
     RULER = 10,
+    LANE = 30, // Height of the waveform above the spectrogram.
+    MARK = 3, // Thickness of the line over the columns that are still approximate.
+    DASH = 4, // Length of the dashes marking where the tracks of an album start.
+    MIN_DRAG = 3, // Pixels to drag over before it selects a band rather than being a click.
+    RESTART_DELAY = 150, // Milliseconds without changes before starting a new analysis.
+    PREVIEW_DURATION = 60, // Seconds, shorter files are decoded fast enough without a preview.
+};
+
+// Limit on the memory taken by the analysis results of views not currently displayed.
+static const size_t VIEWS_SIZE = 256 * 1024 * 1024;
+
+// Limits on the memory taken by the image export: the colour levels of one decoding pass, and
+// the bitmap the rulers and labels are drawn into before being written out.
+static const size_t EXPORT_LEVELS_SIZE = 128 * 1024 * 1024;
+static const size_t EXPORT_STRIP_SIZE = 16 * 1024 * 1024;
+static pthread_mutex_t export_draw_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Leave at least half of the cores alone when computing views nobody asked for yet.
+static const int SPECULATIVE_JOBS = spek_max(1, (int)std::thread::hardware_concurrency() / 4);
+
+// Analysis results for one combination of settings. Views are kept after the analysis is done
+// so that switching back to them, e.g. with `s`/`S`, doesn't require decoding the file again.
+struct SpekView
+{
+    SpekSpectrogram *spectrogram;
+    int id;
+    int stream;
+    int channel;
+    enum window_function window_function;
+    int fft_bits;
+    int samples;
+    int rows; // Values per column, fewer than the bands if they are reduced to the pixel rows.
+    double band_low; // The band asked for, both 0 for the full range.
+    double band_high;
+    int max_rate; // The highest sample rate to analyse at, 0 for any.
+    enum frequency_scale scale;
+    spek_pipeline *pipeline; // Not null while the analysis is running.
+    int fft; // The index of its FFT size in the pipeline.
+    bool done;
+    bool speculative; // Started in the background in case the user asks for it next.
+    int columns; // Columns received so far.
+    int previewed; // Columns filled in by the preview pass.
+    std::vector<bool> approximate; // Columns that only have a preview.
+    ColumnStore values; // `samples` columns of `rows` values each.
+    std::vector<spek_envelope> envelopes; // The waveform of the exact columns.
+    wxString desc;
+    int streams;
+    int channels;
+    double duration;
+    std::vector<double> tracks;
+    int sample_rate;
+    double min_freq; // Of the first and the last band.
+    double max_freq;
+};
+
+// Everything drawn around the spectrogram, the same for the window and the exported images.
+struct SpekFrame
+{
+    int width;
+    int height;
+    wxString path;
+    wxString desc;
+    double duration;
+    std::vector<double> tracks; // Where the tracks after the first one start, in seconds.
+    double min_freq;
+    double max_freq;
+    enum frequency_scale scale;
+    int urange;
+    int lrange;
+    const wxImage *palette_image;
+    bool titles; // The file name and properties, the time and frequency rulers.
+    // The waveform above the spectrogram, of the first `columns` of its `samples`.
+    const spek_envelope *envelopes;
+    int samples;
+    int columns;
+};
+
+// The columns of one export pass, for the spectrogram rows from `first_row` to `last_row`.
+struct SpekExport
+{
+    int samples;
+    int rows;
+    int first_row;
+    int last_row;
+    int urange;
+    int lrange;
+    std::vector<uint8_t> levels; // Row by row, `samples` levels each.
+    std::vector<spek_envelope> envelopes; // The same for every pass.
+    int channel;
+    const std::atomic<bool> *cancelled;
+    // Only for the first pass.
+    std::vector<std::shared_ptr<Analyzer>> analyzers;
+    SampleBits *sample_bits;
+    ColumnsRecorder *columns;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool done;
 };
 
 // Forward declarations.
+static bool export_pass(Audio& audio, std::unique_ptr<AudioFile>& file, FFT& fft,
+    const std::string& path, int fft_bits, SpekExport& job);
+static void draw_frame(wxDC& dc, const SpekFrame& frame);
+static void draw_waveform(wxDC& dc, const SpekFrame& frame);
+static void draw_tracks(wxDC& dc, const SpekFrame& frame);
+static int track_x(const SpekFrame& frame, double start, int width);
 static wxString trim(wxDC& dc, const wxString& s, int length, bool trim_end);
 static int bits_to_bands(int bits);
 
@@ -46,7 +165,9 @@ SpekSpectrogram::SpekSpectrogram(wxFrame *parent) :
     ),
     audio(new Audio()), // TODO: refactor
     fft(new FFT()),
-    pipeline(NULL),
+    restart_timer(this),
+    view(NULL),
+    next_view_id(0),
     streams(0),
     stream(0),
     channels(0),
@@ -54,16 +175,27 @@ SpekSpectrogram::SpekSpectrogram(wxFrame *parent) :
     window_function(WINDOW_DEFAULT),
     duration(0.0),
     sample_rate(0),
+    min_freq(0.0),
+    max_freq(0.0),
+    band_low(0.0),
+    band_high(0.0),
+    scale(SCALE_LINEAR),
+    drag_start(-1),
+    drag_end(-1),
     palette(PALETTE_DEFAULT),
     palette_image(),
     image(1, 1),
     prev_width(-1),
+    prev_height(-1),
     fft_bits(FFT_BITS),
     urange(URANGE),
     lrange(LRANGE)
 {
     this->create_palette();
 
+    spek_trace_init();
+    spek_trace_thread_name("ui");
+
     SetBackgroundStyle(wxBG_STYLE_CUSTOM);
     SetFocus();
 }
@@ -75,6 +207,12 @@ SpekSpectrogram::~SpekSpectrogram()
 
 void SpekSpectrogram::open(const wxString& path)
 {
+    this->restart_timer.Stop();
+    this->stop();
+    this->views.clear();
+    this->view = NULL;
+    this->spare_file.reset();
+
     this->path = path;
     this->stream = 0;
     this->channel = 0;
@@ -91,6 +229,251 @@ void SpekSpectrogram::save(const wxString& path)
     bitmap.SaveFile(path, wxBITMAP_TYPE_PNG);
 }
 
+bool SpekSpectrogram::export_image(
+    const wxString& path, const wxString& image_path, int width, int height,
+    const SpekExportOptions& options
+)
+{
+    // Scale the paddings, fonts and rulers along with the image.
+    double scale = fmax(1.0, fmin(width, height) / 600.0);
+    int x0 = (int)round(LPAD * scale);
+    int y0 = (int)round(TPAD * scale);
+    int x1 = width - (int)round(RPAD * scale);
+    int y1 = height - (int)round(BPAD * scale);
+    if (x1 - x0 < 2 || y1 - y0 < 2) {
+        return false;
+    }
+
+    Audio audio;
+    FFT fft;
+    std::string file_name(path.utf8_str());
+    std::unique_ptr<AudioFile> file = audio.open(file_name, 0);
+    if (!!file->get_error() || options.channel < 0 || options.channel >= file->get_channels()) {
+        return false;
+    }
+
+    SpekExport job;
+    job.samples = x1 - x0;
+    job.rows = y1 - y0;
+    job.first_row = 0;
+    job.last_row = 0;
+    job.urange = URANGE;
+    job.lrange = LRANGE;
+    job.envelopes.assign(job.samples, spek_envelope());
+    job.channel = options.channel;
+    job.cancelled = options.cancelled;
+    job.analyzers = options.analyzers;
+    job.sample_bits = options.sample_bits;
+    job.columns = options.columns;
+
+    // The smallest FFT that gives every row a band of its own.
+    int fft_bits = MIN_FFT_BITS;
+    while (fft_bits < MAX_FFT_BITS && bits_to_bands(fft_bits) < job.rows) {
+        fft_bits++;
+    }
+    if (options.fft_bits) {
+        fft_bits = spek_min(spek_max(options.fft_bits, MIN_FFT_BITS), MAX_FFT_BITS);
+    }
+
+    SpekFrame frame;
+    frame.width = (int)round(width / scale);
+    frame.height = (int)round(height / scale);
+    frame.path = path;
+    frame.duration = file->get_duration();
+    frame.tracks = file->get_track_starts();
+    frame.min_freq = 0.0;
+    frame.max_freq = file->get_sample_rate() / 2.0;
+    frame.scale = SCALE_LINEAR;
+    frame.urange = job.urange;
+    frame.lrange = job.lrange;
+    frame.titles = true;
+    frame.envelopes = job.envelopes.data();
+    frame.samples = job.samples;
+    frame.columns = job.samples;
+    {
+        // Only the description is needed, the pipeline is never started.
+        spek_pipeline *pipeline = spek_pipeline_open(
+            std::move(file), fft.create(fft_bits), 0, job.channel, WINDOW_DEFAULT, job.samples,
+            NULL, NULL
+        );
+        frame.desc = wxString::FromUTF8(spek_pipeline_desc(pipeline).c_str());
+        file = spek_pipeline_release(pipeline);
+    }
+    wxImage palette_image(RULER, bits_to_bands(fft_bits));
+    for (int y = 0; y < palette_image.GetHeight(); y++) {
+        uint32_t color = spek_palette(options.palette, y / (double)palette_image.GetHeight());
+        palette_image.SetRGB(
+            wxRect(0, palette_image.GetHeight() - y - 1, RULER, 1),
+            color >> 16, (color >> 8) & 0xFF, color & 0xFF
+        );
+    }
+    frame.palette_image = &palette_image;
+
+    uint32_t colors[256];
+    for (int i = 0; i < 256; i++) {
+        colors[i] = spek_palette(options.palette, i / 255.0);
+    }
+
+    PngWriter writer;
+    if (!writer.open(std::string(image_path.utf8_str()), width, height)) {
+        return false;
+    }
+    // The waveform is drawn with the frame, above the first rows of the spectrogram.
+    if (!export_pass(audio, file, fft, file_name, fft_bits, job)) {
+        return false;
+    }
+
+    // Draw the frame in horizontal strips, filling in the spectrogram rows as they come.
+    int strip_rows = spek_max(1, (int)(EXPORT_STRIP_SIZE / (4 * (size_t)width)));
+    std::vector<int> track_columns;
+    for (double start : frame.tracks) {
+        track_columns.push_back(track_x(frame, start, job.samples));
+    }
+    for (int top = 0; top < height; top += strip_rows) {
+        int bottom = spek_min(top + strip_rows, height);
+        wxImage image;
+        {
+            // Exports may run on several threads at once, e.g. for the server, but the wx
+            // drawing isn't thread-safe so they take turns. The analysis doesn't wait.
+            pthread_mutex_lock(&export_draw_mutex);
+            wxBitmap bitmap(width, bottom - top, 24);
+            {
+                wxMemoryDC dc(bitmap);
+                dc.SetUserScale(scale, scale);
+                dc.SetDeviceOrigin(0, -top);
+                draw_frame(dc, frame);
+            }
+            image = bitmap.ConvertToImage();
+            pthread_mutex_unlock(&export_draw_mutex);
+        }
+        uint8_t *data = image.GetData();
+
+        for (int y = top; y < bottom; y++) {
+            uint8_t *row = data + 3 * (size_t)width * (y - top);
+            int spectrogram_row = y - y0;
+            if (spectrogram_row >= 0 && spectrogram_row < job.rows) {
+                if (spectrogram_row >= job.last_row &&
+                    !export_pass(audio, file, fft, file_name, fft_bits, job)) {
+                    return false;
+                }
+                const uint8_t *levels =
+                    &job.levels[(size_t)(spectrogram_row - job.first_row) * job.samples];
+                for (int x = 0; x < job.samples; x++) {
+                    uint32_t color = colors[levels[x]];
+                    uint8_t *pixel = row + 3 * (x0 + x);
+                    pixel[0] = color >> 16;
+                    pixel[1] = (color >> 8) & 0xFF;
+                    pixel[2] = color & 0xFF;
+                }
+                // Dashed lines where the tracks start, as in the window.
+                if ((spectrogram_row / (int)round(DASH * scale)) % 2 == 0) {
+                    for (int x : track_columns) {
+                        memset(row + 3 * (x0 + x), 0xC0, 3);
+                    }
+                }
+            }
+            // Border around the spectrogram, just outside of it so that it covers no columns.
+            if (spectrogram_row == -1 || spectrogram_row == job.rows) {
+                memset(row + 3 * (x0 - 1), 0xFF, 3 * (job.samples + 2));
+            } else if (spectrogram_row >= 0 && spectrogram_row < job.rows) {
+                memset(row + 3 * (x0 - 1), 0xFF, 3);
+                memset(row + 3 * (x0 + job.samples), 0xFF, 3);
+            }
+            if (!writer.write_row(row)) {
+                return false;
+            }
+        }
+    }
+    return writer.close();
+}
+
+static void export_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data)
+{
+    SpekExport *job = (SpekExport *)cb_data;
+    if (sample == -1) {
+        pthread_mutex_lock(&job->mutex);
+        job->done = true;
+        pthread_cond_signal(&job->cond);
+        pthread_mutex_unlock(&job->mutex);
+        return;
+    }
+    if (job->cancelled && job->cancelled->load(std::memory_order_relaxed)) {
+        // Stop waiting for the rest, the pipeline is closed right away.
+        pthread_mutex_lock(&job->mutex);
+        job->done = true;
+        pthread_cond_signal(&job->cond);
+        pthread_mutex_unlock(&job->mutex);
+        return;
+    }
+    if (sample < job->samples) {
+        job->envelopes[sample] = *envelope;
+    }
+
+    double range = job->urange - job->lrange;
+    for (int row = job->first_row; row < job->last_row; row++) {
+        // The top row is the highest frequency.
+        int band = job->rows > 1 ?
+            (int)round((job->rows - 1 - row) * (bands - 1) / (double)(job->rows - 1)) : 0;
+        double value = fmin(job->urange, fmax(job->lrange, values[band]));
+        job->levels[(size_t)(row - job->first_row) * job->samples + sample] =
+            (uint8_t)round(255 * (value - job->lrange) / range);
+    }
+}
+
+// Decode the whole file once more to compute the spectrogram rows following the current ones.
+static bool export_pass(
+    Audio& audio, std::unique_ptr<AudioFile>& file, FFT& fft,
+    const std::string& path, int fft_bits, SpekExport& job
+)
+{
+    if (!file->rewind()) {
+        file = audio.open(path, 0);
+        if (!!file->get_error()) {
+            return false;
+        }
+    }
+
+    int pass_rows = spek_max(1, (int)(EXPORT_LEVELS_SIZE / job.samples));
+    job.first_row = job.last_row;
+    job.last_row = spek_min(job.first_row + pass_rows, job.rows);
+    job.levels.assign((size_t)(job.last_row - job.first_row) * job.samples, 0);
+    job.done = false;
+    pthread_mutex_init(&job.mutex, NULL);
+    pthread_cond_init(&job.cond, NULL);
+
+    spek_pipeline *pipeline = spek_pipeline_open(
+        std::move(file), fft.create(fft_bits), 0, job.channel, WINDOW_DEFAULT, job.samples,
+        export_cb, &job
+    );
+    // Keep the peaks of the bands sharing a row rather than whichever is nearest.
+    spek_pipeline_set_rows(pipeline, job.rows, REDUCE_MAX);
+    for (const auto& analyzer : job.analyzers) {
+        spek_pipeline_add_analyzer(pipeline, analyzer);
+    }
+    if (job.columns) {
+        job.columns->add_to(pipeline);
+    }
+    spek_pipeline_start(pipeline);
+    pthread_mutex_lock(&job.mutex);
+    while (!job.done) {
+        pthread_cond_wait(&job.cond, &job.mutex);
+    }
+    pthread_mutex_unlock(&job.mutex);
+    const SampleBits *sample_bits = spek_pipeline_sample_bits(pipeline);
+    if (job.sample_bits && sample_bits) {
+        *job.sample_bits = *sample_bits;
+    }
+    job.analyzers.clear();
+    job.sample_bits = NULL;
+    job.columns = NULL;
+    file = spek_pipeline_release(pipeline);
+
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.mutex);
+    return !job.cancelled || !job.cancelled->load(std::memory_order_relaxed);
+}
+
 void SpekSpectrogram::on_char(wxKeyEvent& evt)
 {
     switch (evt.GetKeyCode()) {
@@ -141,6 +524,18 @@ void SpekSpectrogram::on_char(wxKeyEvent& evt)
     case 'U':
         this->urange = spek_max(this->urange - 1, this->lrange + 1);
         break;
+    case 'a':
+        this->scale = (enum frequency_scale) ((this->scale + 1) % SCALE_COUNT);
+        break;
+    case 'A':
+        this->scale = (enum frequency_scale) ((this->scale - 1 + SCALE_COUNT) % SCALE_COUNT);
+        break;
+    case 'z':
+    case 'Z':
+        // Back to the full range after selecting a band.
+        this->band_low = 0.0;
+        this->band_high = 0.0;
+        break;
     case 'w':
         this->fft_bits = spek_min(this->fft_bits + 1, MAX_FFT_BITS);
         this->create_palette();
@@ -154,8 +549,7 @@ void SpekSpectrogram::on_char(wxKeyEvent& evt)
         return;
     }
 
-    start();
-    Refresh();
+    this->restart();
 }
 
 void SpekSpectrogram::on_paint(wxPaintEvent&)
@@ -168,41 +562,190 @@ void SpekSpectrogram::on_size(wxSizeEvent&)
 {
     wxSize size = GetClientSize();
     bool width_changed = this->prev_width != size.GetWidth();
+    bool height_changed = this->prev_height != size.GetHeight();
     this->prev_width = size.GetWidth();
+    this->prev_height = size.GetHeight();
+
+    // The height only matters if the columns are reduced to it.
+    bool reduced = SpekPreferences::get().get_reduce_rows() || this->scale != SCALE_LINEAR;
+    if (width_changed || (height_changed && reduced)) {
+        this->restart();
+    }
+}
+
+// Dragging up or down over the spectrogram selects the band to zoom into.
+void SpekSpectrogram::on_left_down(wxMouseEvent& event)
+{
+    wxSize size = GetClientSize();
+    int x = event.GetX();
+    int y = event.GetY();
+    if (!this->view || x < LPAD || x >= size.GetWidth() - RPAD ||
+        y < TPAD || y >= size.GetHeight() - BPAD) {
+        event.Skip();
+        return;
+    }
+    this->drag_start = this->drag_end = y;
+    CaptureMouse();
+}
 
-    if (width_changed) {
+void SpekSpectrogram::on_motion(wxMouseEvent& event)
+{
+    if (this->drag_start < 0) {
+        event.Skip();
+        return;
+    }
+    int bottom = GetClientSize().GetHeight() - BPAD;
+    this->drag_end = spek_max(TPAD, spek_min(event.GetY(), bottom));
+    Refresh();
+}
+
+void SpekSpectrogram::on_left_up(wxMouseEvent& event)
+{
+    if (this->drag_start < 0) {
+        event.Skip();
+        return;
+    }
+    if (HasCapture()) {
+        ReleaseMouse();
+    }
+    int top = spek_min(this->drag_start, this->drag_end);
+    int bottom = spek_max(this->drag_start, this->drag_end);
+    this->drag_start = this->drag_end = -1;
+    Refresh();
+    if (bottom - top < MIN_DRAG) {
+        return;
+    }
+
+    // The top of the spectrogram is the highest frequency.
+    int height = GetClientSize().GetHeight() - TPAD - BPAD;
+    enum frequency_scale scale = this->view ? this->view->scale : SCALE_LINEAR;
+    double low = this->min_freq;
+    double high = this->max_freq;
+    this->band_low = spek_scale_freq(scale, 1.0 - (bottom - TPAD) / (double)height, low, high);
+    this->band_high = spek_scale_freq(scale, 1.0 - (top - TPAD) / (double)height, low, high);
+    this->restart();
+}
+
+void SpekSpectrogram::on_restart(wxTimerEvent&)
+{
+    start();
+    Refresh();
+}
+
+// Apply the new settings, right away if the view is cached, otherwise once the user stops
+// changing them so that holding down a key doesn't start and cancel an analysis on each repeat.
+void SpekSpectrogram::restart()
+{
+    wxSize size = GetClientSize();
+    int samples = size.GetWidth() - LPAD - RPAD;
+    int rows = this->get_rows(this->fft_bits);
+    if (this->lookup_view(
+            this->stream, this->channel, this->window_function, this->fft_bits, samples, rows)) {
+        this->restart_timer.Stop();
         start();
+        Refresh();
+    } else {
+        this->restart_timer.Start(RESTART_DELAY, wxTIMER_ONE_SHOT);
     }
 }
 
 void SpekSpectrogram::on_have_sample(SpekHaveSampleEvent& event)
 {
+    SpekTraceScope trace("on_have_sample");
+
     int bands = event.get_bands();
     int sample = event.get_sample();
     const float *values = event.get_values();
 
+    SpekView *view = NULL;
+    for (const auto& item : this->views) {
+        if (item->id == event.get_view()) {
+            view = item.get();
+            break;
+        }
+    }
+    if (!view) {
+        // The view was dropped while the event was in the queue.
+        return;
+    }
+
     if (sample == -1) {
-        this->stop();
+        view->done = true;
+        // The pipeline is shared by the views of all the FFT sizes it computes.
+        spek_pipeline *pipeline = view->pipeline;
+        if (!pipeline) {
+            return;
+        }
+        for (const auto& item : this->views) {
+            if (item->pipeline == pipeline && !item->done) {
+                return;
+            }
+        }
+        // What the samples really hold is only known once they are all read.
+        for (const auto& item : this->views) {
+            if (item->pipeline == pipeline) {
+                item->desc = wxString::FromUTF8(spek_pipeline_desc(pipeline, item->fft).c_str());
+            }
+        }
+        if (this->view && this->view->pipeline == pipeline && this->desc != this->view->desc) {
+            this->desc = this->view->desc;
+            Refresh();
+        }
+        this->release_pipeline(pipeline);
+        for (const auto& item : this->views) {
+            if (item->pipeline == pipeline) {
+                item->pipeline = NULL;
+            }
+        }
+        this->trim_views();
+        this->speculate();
         return;
     }
 
-    // TODO: check image size, quit if wrong.
-    double range = this->urange - this->lrange;
-    for (int y = 0; y < bands; y++) {
-        double value = fmin(this->urange, fmax(this->lrange, values[y]));
-        double level = (value - this->lrange) / range;
-        uint32_t color = spek_palette(this->palette, level);
-        this->image.SetRGB(
-            sample,
-            bands - y - 1,
-            color >> 16,
-            (color >> 8) & 0xFF,
-            color & 0xFF
-        );
+    if (bands != view->values.get_bands() || sample >= view->values.get_samples()) {
+        return;
+    }
+    view->values.set(sample, values);
+    if (event.is_approximate()) {
+        view->approximate[sample] = true;
+        view->previewed = sample + 1;
+    } else {
+        view->approximate[sample] = false;
+        view->columns = sample + 1;
+    }
+    if (event.get_envelope()) {
+        view->envelopes[sample] = *event.get_envelope();
+    }
+
+    if (view == this->view) {
+        // Colourised by the pipeline unless the palette or the range changed since.
+        const uint8_t *pixels = event.get_pixels();
+        if (pixels && this->colors && event.get_colors() == this->colors->get_id()) {
+            this->copy_column(sample, bands, pixels);
+        } else {
+            this->draw_column(sample, bands, values);
+        }
+        // TODO: refresh only one pixel column
+        this->Refresh();
     }
+}
 
-    // TODO: refresh only one pixel column
-    this->Refresh();
+void SpekSpectrogram::draw_column(int sample, int bands, const float *values)
+{
+    this->pixels.resize(3 * bands);
+    this->colors->apply(values, bands, this->pixels.data());
+    this->copy_column(sample, bands, this->pixels.data());
+}
+
+// The pixels go from the top of the image down.
+void SpekSpectrogram::copy_column(int sample, int bands, const uint8_t *pixels)
+{
+    unsigned char *data = this->image.GetData();
+    size_t stride = 3 * (size_t)this->image.GetWidth();
+    data += 3 * (size_t)sample;
+    for (int y = 0; y < bands; y++) {
+        memcpy(data + y * stride, pixels + 3 * y, 3);
+    }
 }
 
 static wxString time_formatter(int unit)
@@ -213,6 +756,14 @@ static wxString time_formatter(int unit)
 
 static wxString freq_formatter(int unit)
 {
+    if (unit && unit < 1000) {
+        // The low end of the logarithmic scales.
+        return wxString::Format(_("%d Hz"), unit);
+    }
+    if (unit % 1000) {
+        // The edges of a zoomed band and its finer ticks.
+        return wxString::Format(_("%.1f kHz"), unit / 1000.0);
+    }
     return wxString::Format(_("%d kHz"), unit / 1000);
 }
 
@@ -223,10 +774,93 @@ static wxString density_formatter(int unit)
 
 void SpekSpectrogram::render(wxDC& dc)
 {
+    SpekTraceScope trace("render");
+
     wxSize size = GetClientSize();
     int w = size.GetWidth();
     int h = size.GetHeight();
 
+    SpekFrame frame;
+    frame.width = w;
+    frame.height = h;
+    frame.path = this->path;
+    frame.desc = this->desc;
+    frame.duration = this->duration;
+    frame.tracks = this->tracks;
+    frame.min_freq = this->min_freq;
+    frame.max_freq = this->max_freq;
+    frame.scale = this->view ? this->view->scale : SCALE_LINEAR;
+    frame.urange = this->urange;
+    frame.lrange = this->lrange;
+    frame.palette_image = &this->palette_image;
+    frame.envelopes = this->view ? this->view->envelopes.data() : NULL;
+    frame.samples = this->view ? this->view->samples : 0;
+    frame.columns = this->view ? this->view->columns : 0;
+    frame.titles =
+        this->image.GetWidth() > 1 && this->image.GetHeight() > 1 &&
+        w - LPAD - RPAD > 0 && h - TPAD - BPAD > 0;
+    draw_frame(dc, frame);
+
+    if (frame.titles) {
+        // Draw the spectrogram.
+        wxBitmap bmp(this->image.Scale(w - LPAD - RPAD, h - TPAD - BPAD));
+        dc.DrawBitmap(bmp, LPAD, TPAD);
+
+        // Mark the columns that only have a preview so far, in the gap between the waveform
+        // and the spectrogram so that it stays clear of the description and the border.
+        if (this->view && this->view->previewed) {
+            const std::vector<bool>& approximate = this->view->approximate;
+            double scale = (w - LPAD - RPAD) / (double)approximate.size();
+            dc.SetPen(wxPen(wxColour(128, 128, 128), MARK));
+            for (size_t begin = 0; begin < approximate.size(); ) {
+                if (!approximate[begin]) {
+                    begin++;
+                    continue;
+                }
+                size_t end = begin;
+                while (end < approximate.size() && approximate[end]) {
+                    end++;
+                }
+                dc.DrawLine(
+                    LPAD + (int)(begin * scale), TPAD - GAP / 2,
+                    LPAD + (int)(end * scale), TPAD - GAP / 2
+                );
+                begin = end;
+            }
+            dc.SetPen(*wxWHITE_PEN);
+        }
+
+        // Where the tracks start, the numbers are above in the waveform lane.
+        if (!frame.tracks.empty()) {
+            dc.SetPen(wxPen(wxColour(192, 192, 192), 1, wxPENSTYLE_SHORT_DASH));
+            for (double start : frame.tracks) {
+                int x = LPAD + track_x(frame, start, w - LPAD - RPAD);
+                dc.DrawLine(x, TPAD, x, h - BPAD);
+            }
+            dc.SetPen(*wxWHITE_PEN);
+        }
+    }
+
+    // The band being selected.
+    if (this->drag_start >= 0 && abs(this->drag_end - this->drag_start) >= MIN_DRAG) {
+        dc.DrawRectangle(
+            LPAD,
+            spek_min(this->drag_start, this->drag_end),
+            w - LPAD - RPAD,
+            abs(this->drag_end - this->drag_start) + 1
+        );
+    }
+
+    // Border around the spectrogram.
+    dc.DrawRectangle(LPAD, TPAD, w - LPAD - RPAD, h - TPAD - BPAD);
+}
+
+// Draw everything but the spectrogram itself.
+static void draw_frame(wxDC& dc, const SpekFrame& frame)
+{
+    int w = frame.width;
+    int h = frame.height;
+
     // Initialise.
     dc.SetBackground(*wxBLACK_BRUSH);
     dc.SetBackgroundMode(wxTRANSPARENT);
@@ -254,48 +888,49 @@ void SpekSpectrogram::render(wxDC& dc)
     // Clean the background.
     dc.Clear();
 
+    // The titles go above the waveform.
+    int titles = TPAD - GAP - LANE;
+
     // Spek version
     dc.SetFont(large_font);
     wxString package_name(PACKAGE_NAME);
     dc.DrawText(
         package_name,
         w - RPAD + GAP,
-        TPAD - 2 * GAP - normal_height - large_height
+        titles - 2 * GAP - normal_height - large_height
     );
     int package_name_width = dc.GetTextExtent(package_name + " ").GetWidth();
     dc.SetFont(small_font);
     dc.DrawText(
         PACKAGE_VERSION,
         w - RPAD + GAP + package_name_width,
-        TPAD - 2 * GAP - normal_height - small_height
+        titles - 2 * GAP - normal_height - small_height
     );
 
-    if (this->image.GetWidth() > 1 && this->image.GetHeight() > 1 &&
-        w - LPAD - RPAD > 0 && h - TPAD - BPAD > 0) {
-        // Draw the spectrogram.
-        wxBitmap bmp(this->image.Scale(w - LPAD - RPAD, h - TPAD - BPAD));
-        dc.DrawBitmap(bmp, LPAD, TPAD);
-
+    if (frame.titles) {
         // File name.
         dc.SetFont(large_font);
         dc.DrawText(
-            trim(dc, this->path, w - LPAD - RPAD, false),
+            trim(dc, frame.path, w - LPAD - RPAD, false),
             LPAD,
-            TPAD - 2 * GAP - normal_height - large_height
+            titles - 2 * GAP - normal_height - large_height
         );
 
         // File properties.
         dc.SetFont(normal_font);
         dc.DrawText(
-            trim(dc, this->desc, w - LPAD - RPAD, true),
+            trim(dc, frame.desc, w - LPAD - RPAD, true),
             LPAD,
-            TPAD - GAP - normal_height
+            titles - GAP - normal_height
         );
 
+        draw_waveform(dc, frame);
+        draw_tracks(dc, frame);
+
         // Prepare to draw the rulers.
         dc.SetFont(small_font);
 
-        if (this->duration) {
+        if (frame.duration) {
             // Time ruler.
             int time_factors[] = {1, 2, 5, 10, 20, 30, 1*60, 2*60, 5*60, 10*60, 20*60, 30*60, 0};
             SpekRuler time_ruler(
@@ -306,43 +941,45 @@ void SpekSpectrogram::render(wxDC& dc)
                 "00:00",
                 time_factors,
                 0,
-                (int)this->duration,
+                (int)frame.duration,
                 1.5,
-                (w - LPAD - RPAD) / this->duration,
+                (w - LPAD - RPAD) / frame.duration,
                 0.0,
                 time_formatter
                 );
             time_ruler.draw(dc);
         }
 
-        if (this->sample_rate) {
-            // Frequency ruler.
-            int freq = this->sample_rate / 2;
+        if (frame.max_freq > frame.min_freq) {
+            // Frequency ruler, with finer ticks when zoomed into a narrow band.
+            int min_freq = (int)round(frame.min_freq);
+            int max_freq = (int)round(frame.max_freq);
             int freq_factors[] = {1000, 2000, 5000, 10000, 20000, 0};
+            int zoom_factors[] = {100, 200, 500, 1000, 2000, 5000, 0};
+            bool logarithmic = frame.scale != SCALE_LINEAR;
             SpekRuler freq_ruler(
                 LPAD,
                 TPAD,
                 SpekRuler::LEFT,
                 // TRANSLATORS: keep "00" unchanged, it's used to calc the text width
                 _("00 kHz"),
-                freq_factors,
-                0,
-                freq,
+                max_freq - min_freq < 5000 ? zoom_factors : freq_factors,
+                min_freq,
+                max_freq,
                 3.0,
-                (h - TPAD - BPAD) / (double)freq,
+                (h - TPAD - BPAD) / (logarithmic ?
+                    log(frame.max_freq / frame.min_freq) : (double)(max_freq - min_freq)),
                 0.0,
                 freq_formatter
                 );
+            freq_ruler.set_logarithmic(logarithmic);
             freq_ruler.draw(dc);
         }
     }
 
-    // Border around the spectrogram.
-    dc.DrawRectangle(LPAD, TPAD, w - LPAD - RPAD, h - TPAD - BPAD);
-
     // The palette.
     if (h - TPAD - BPAD > 0) {
-        wxBitmap bmp(this->palette_image.Scale(RULER, h - TPAD - BPAD + 1));
+        wxBitmap bmp(frame.palette_image->Scale(RULER, h - TPAD - BPAD + 1));
         dc.DrawBitmap(bmp, w - RPAD + GAP, TPAD);
 
         // Prepare to draw the ruler.
@@ -357,10 +994,10 @@ void SpekSpectrogram::render(wxDC& dc)
             // TRANSLATORS: keep "-00" unchanged, it's used to calc the text width
             _("-00 dB"),
             density_factors,
-            -this->urange,
-            -this->lrange,
+            -frame.urange,
+            -frame.lrange,
             3.0,
-            (h - TPAD - BPAD) / (double)(this->lrange - this->urange),
+            (h - TPAD - BPAD) / (double)(frame.lrange - frame.urange),
             h - TPAD - BPAD,
             density_formatter
         );
@@ -368,11 +1005,35 @@ void SpekSpectrogram::render(wxDC& dc)
     }
 }
 
-static void pipeline_cb(int bands, int sample, float *values, void *cb_data)
+
+static void pipeline_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data)
+{
+    SpekView *view = (SpekView *)cb_data;
+    SpekHaveSampleEvent event(
+        view->id, bands, sample, values, false, false, NULL, -1, envelope
+    );
+    wxPostEvent(view->spectrogram, event);
+}
+
+static void pixels_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope,
+    const uint8_t *pixels, int colors, void *cb_data)
+{
+    SpekView *view = (SpekView *)cb_data;
+    SpekHaveSampleEvent event(
+        view->id, bands, sample, values, false, false, pixels, colors, envelope
+    );
+    wxPostEvent(view->spectrogram, event);
+}
+
+static void preview_cb(
+    int bands, int sample, float *values, const spek_envelope *envelope, void *cb_data)
 {
-    SpekHaveSampleEvent event(bands, sample, values, false);
-    SpekSpectrogram *s = (SpekSpectrogram *)cb_data;
-    wxPostEvent(s, event);
+    (void)envelope;
+    SpekView *view = (SpekView *)cb_data;
+    SpekHaveSampleEvent event(view->id, bands, sample, values, false, true);
+    wxPostEvent(view->spectrogram, event);
 }
 
 void SpekSpectrogram::start()
@@ -381,45 +1042,478 @@ void SpekSpectrogram::start()
         return;
     }
 
-    this->stop();
-
     // The number of samples is the number of pixels available for the image.
     // The number of bands is fixed, FFT results are very different for
     // different values but we need some consistency.
     wxSize size = GetClientSize();
     int samples = size.GetWidth() - LPAD - RPAD;
-    if (samples > 0) {
-        this->image.Create(samples, bits_to_bands(this->fft_bits));
-        this->pipeline = spek_pipeline_open(
-            this->audio->open(std::string(this->path.utf8_str()), this->stream),
-            this->fft->create(this->fft_bits),
-            this->stream,
-            this->channel,
-            this->window_function,
-            samples,
-            pipeline_cb,
-            this
-        );
-        spek_pipeline_start(this->pipeline);
-        // TODO: extract conversion into a utility function.
-        this->desc = wxString::FromUTF8(spek_pipeline_desc(this->pipeline).c_str());
-        this->streams = spek_pipeline_streams(this->pipeline);
-        this->channels = spek_pipeline_channels(this->pipeline);
-        this->duration = spek_pipeline_duration(this->pipeline);
-        this->sample_rate = spek_pipeline_sample_rate(this->pipeline);
-    } else {
+    if (samples <= 0) {
+        this->stop();
+        this->view = NULL;
         this->image.Create(1, 1);
+        return;
+    }
+
+    this->update_colors();
+    SpekView *view = this->find_view(samples, this->get_rows(this->fft_bits));
+    if (view && view != this->view && view->speculative && view->pipeline &&
+        !spek_pipeline_can_restore_priority()) {
+        // Its threads would go on in the background, start over unless it's complete.
+        this->stop_pipelines(true);
+        view = this->find_view(samples, this->get_rows(this->fft_bits));
+    }
+    if (view) {
+        if (view != this->view) {
+            // Keep it if it was a lucky guess, the rest of the guesses were wrong.
+            if (view->speculative && view->pipeline) {
+                spek_pipeline_set_background(view->pipeline, false);
+            }
+            view->speculative = false;
+            this->stop_pipelines(true);
+        }
+        this->show_view(view);
+        this->speculate();
+        return;
+    }
+
+    this->stop();
+
+    // Views for the other streams are only useful if they can be shown with the same settings.
+    bool all_streams = SpekPreferences::get().get_all_streams();
+    std::vector<std::unique_ptr<AudioFile>> files;
+    if (!all_streams && this->spare_file && this->spare_file->get_stream() == this->stream &&
+        this->spare_file->rewind()) {
+        // Only the analysis parameters changed, skip opening and probing the file again.
+        files.push_back(std::move(this->spare_file));
+    } else {
+        files = this->audio->open_streams(
+            std::string(this->path.utf8_str()), this->stream, all_streams
+        );
+    }
+    this->spare_file.reset();
+    // With all FFT sizes analysed at once, `w`/`W` only have to switch between the views.
+    std::vector<int> fft_bits(1, this->fft_bits);
+    // The pipeline skips the reduction for the sizes with fewer bands than rows.
+    bool reduced = SpekPreferences::get().get_reduce_rows() || this->scale != SCALE_LINEAR;
+    int rows = reduced ? size.GetHeight() - TPAD - BPAD : 0;
+    ColumnPrecision precision = SpekPreferences::get().get_column_precision();
+    int max_rate = SpekPreferences::get().get_max_sample_rate();
+    if (SpekPreferences::get().get_all_fft_sizes()) {
+        for (int bits = MIN_FFT_BITS; bits <= MAX_FFT_BITS; bits++) {
+            if (bits != this->fft_bits) {
+                fft_bits.push_back(bits);
+            }
+        }
     }
+
+    for (auto& file : files) {
+        bool requested = file->get_stream() == this->stream;
+        if (!requested && (!!file->get_error() || this->channel >= file->get_channels())) {
+            continue;
+        }
+
+        bool failed = !!file->get_error();
+        int stream = file->get_stream();
+        double duration = file->get_duration();
+        spek_pipeline *pipeline = NULL;
+        std::vector<SpekView*> pipeline_views;
+        for (int bits : fft_bits) {
+            SpekView *v = new SpekView();
+            v->spectrogram = this;
+            v->id = this->next_view_id++;
+            v->stream = stream;
+            v->channel = this->channel;
+            v->window_function = this->window_function;
+            v->fft_bits = bits;
+            v->samples = samples;
+            v->rows = this->get_rows(bits);
+            v->band_low = this->band_low;
+            v->band_high = this->band_high;
+            v->max_rate = max_rate;
+            v->scale = this->scale;
+            v->done = false;
+            v->speculative = false;
+            v->columns = 0;
+            v->previewed = 0;
+            if (!failed) {
+                v->values.create(samples, v->rows, precision);
+                v->approximate.resize(samples);
+                v->envelopes.resize(samples);
+            }
+            if (!pipeline) {
+                pipeline = spek_pipeline_open(
+                    std::move(file),
+                    this->fft->create(bits),
+                    v->stream,
+                    v->channel,
+                    v->window_function,
+                    samples,
+                    pipeline_cb,
+                    v
+                );
+            } else {
+                spek_pipeline_add_fft(pipeline, this->fft->create(bits), v);
+            }
+            v->pipeline = pipeline;
+            pipeline_views.push_back(v);
+            this->views.push_front(std::unique_ptr<SpekView>(v));
+            if (failed) {
+                // Nothing to analyse, one view is enough for the error message.
+                break;
+            }
+        }
+        if (!failed && rows > 0) {
+            spek_pipeline_set_rows(pipeline, rows, REDUCE_MAX);
+        }
+        if (!failed) {
+            spek_pipeline_set_scale(pipeline, this->scale);
+        }
+        if (!failed) {
+            spek_pipeline_set_max_rate(pipeline, max_rate);
+        }
+        if (!failed && this->band_high > this->band_low) {
+            spek_pipeline_set_band(pipeline, this->band_low, this->band_high);
+        }
+        if (!failed) {
+            // Leave the UI thread only the copying of the pixels into the image.
+            spek_pipeline_set_colors(pipeline, pixels_cb);
+            spek_pipeline_set_color_map(pipeline, this->colors);
+        }
+        if (!failed && duration >= PREVIEW_DURATION) {
+            // Long files take a while to decode, give a rough idea of them first. Only the
+            // first FFT size, the one being shown, is previewed.
+            spek_pipeline_set_preview(pipeline, preview_cb);
+        }
+        if (!failed) {
+            // Measured in the same pass, it ends up in the description.
+            spek_pipeline_add_analyzer(pipeline, std::make_shared<LoudnessAnalyzer>());
+        }
+        spek_pipeline_start(pipeline);
+
+        for (size_t i = 0; i < pipeline_views.size(); i++) {
+            SpekView *v = pipeline_views[i];
+            // TODO: extract conversion into a utility function.
+            v->fft = i;
+            v->desc = wxString::FromUTF8(spek_pipeline_desc(pipeline, i).c_str());
+            v->streams = spek_pipeline_streams(pipeline);
+            v->channels = spek_pipeline_channels(pipeline);
+            v->duration = spek_pipeline_duration(pipeline);
+            v->tracks = spek_pipeline_track_starts(pipeline);
+            v->sample_rate = spek_pipeline_sample_rate(pipeline);
+            spek_pipeline_band(pipeline, &v->min_freq, &v->max_freq);
+            if (failed) {
+                v->pipeline = NULL;
+                v->done = true;
+            }
+        }
+        if (failed) {
+            spek_pipeline_close(pipeline);
+        }
+        if (requested) {
+            view = pipeline_views.front();
+        }
+    }
+
+    this->show_view(view);
+    this->trim_views();
 }
 
 void SpekSpectrogram::stop()
 {
-    if (this->pipeline) {
-        spek_pipeline_close(this->pipeline);
-        this->pipeline = NULL;
+    this->stop_pipelines(false);
+}
+
+// Stop the running pipelines, or just the speculative ones, and drop their incomplete views.
+void SpekSpectrogram::stop_pipelines(bool speculative)
+{
+    std::set<spek_pipeline*> pipelines;
+    for (const auto& item : this->views) {
+        if (item->pipeline && (item->speculative || !speculative)) {
+            pipelines.insert(item->pipeline);
+        }
+    }
+    for (spek_pipeline *pipeline : pipelines) {
+        this->release_pipeline(pipeline);
+    }
+
+    for (auto it = this->views.begin(); it != this->views.end(); ) {
+        SpekView *view = it->get();
+        if (!pipelines.count(view->pipeline)) {
+            ++it;
+            continue;
+        }
+        view->pipeline = NULL;
+        if (view->done) {
+            ++it;
+            continue;
+        }
+        // Incomplete results are of no use later on.
+        if (view == this->view) {
+            this->view = NULL;
+        }
+        // Events still in the queue for it will find no view and be dropped.
+        it = this->views.erase(it);
+    }
+}
+
+void SpekSpectrogram::release_pipeline(spek_pipeline *pipeline)
+{
+    auto file = spek_pipeline_release(pipeline);
+    if (file && !file->get_error()) {
+        this->spare_file = std::move(file);
+    }
+}
+
+// Once the displayed view is complete, use the idle cores to compute the views the user is most
+// likely to ask for next: the neighbouring channels, the next window function and FFT sizes.
+void SpekSpectrogram::speculate()
+{
+    SpekView *current = this->view;
+    if (!current || !current->done || current->values.empty()) {
+        return;
+    }
+    if (current->band_low != this->band_low || current->band_high != this->band_high ||
+        current->scale != this->scale ||
+        current->max_rate != SpekPreferences::get().get_max_sample_rate()) {
+        // Another band was just selected, or the preferences changed.
+        return;
+    }
+
+    int running = 0;
+    for (const auto& item : this->views) {
+        if (item->pipeline) {
+            if (!item->speculative) {
+                // Real work is still in progress.
+                return;
+            }
+            running++;
+        }
+    }
+
+    struct Guess
+    {
+        int channel;
+        enum window_function window_function;
+        int fft_bits;
+    };
+    const int channels = current->channels;
+    const Guess guesses[] = {
+        {(current->channel + 1) % channels, current->window_function, current->fft_bits},
+        {(current->channel - 1 + channels) % channels, current->window_function, current->fft_bits},
+        {
+            current->channel,
+            (enum window_function) ((current->window_function + 1) % WINDOW_COUNT),
+            current->fft_bits
+        },
+        {current->channel, current->window_function, spek_min(current->fft_bits + 1, MAX_FFT_BITS)},
+        {current->channel, current->window_function, spek_max(current->fft_bits - 1, MIN_FFT_BITS)},
+    };
+
+    for (const Guess& guess : guesses) {
+        if (running >= SPECULATIVE_JOBS) {
+            break;
+        }
+        int rows = this->get_rows(guess.fft_bits);
+        if (this->lookup_view(
+                current->stream, guess.channel, guess.window_function, guess.fft_bits,
+                current->samples, rows)) {
+            continue;
+        }
+
+        std::unique_ptr<AudioFile> file;
+        if (this->spare_file && this->spare_file->get_stream() == current->stream &&
+            this->spare_file->rewind()) {
+            file = std::move(this->spare_file);
+        } else {
+            file = this->audio->open(std::string(this->path.utf8_str()), current->stream);
+        }
+        this->spare_file.reset();
+        if (!!file->get_error()) {
+            return;
+        }
+
+        SpekView *v = new SpekView();
+        v->spectrogram = this;
+        v->id = this->next_view_id++;
+        v->stream = current->stream;
+        v->channel = guess.channel;
+        v->window_function = guess.window_function;
+        v->fft_bits = guess.fft_bits;
+        v->samples = current->samples;
+        v->rows = rows;
+        v->band_low = current->band_low;
+        v->band_high = current->band_high;
+        v->max_rate = current->max_rate;
+        v->scale = current->scale;
+        v->fft = 0;
+        v->done = false;
+        v->speculative = true;
+        v->columns = 0;
+        v->previewed = 0;
+        v->values.create(v->samples, v->rows, SpekPreferences::get().get_column_precision());
+        v->approximate.resize(v->samples);
+        v->envelopes.resize(v->samples);
+        v->pipeline = spek_pipeline_open(
+            std::move(file),
+            this->fft->create(v->fft_bits),
+            v->stream,
+            v->channel,
+            v->window_function,
+            v->samples,
+            pipeline_cb,
+            v
+        );
+        if (v->scale != SCALE_LINEAR || v->rows < bits_to_bands(v->fft_bits)) {
+            spek_pipeline_set_rows(v->pipeline, v->rows, REDUCE_MAX);
+        }
+        spek_pipeline_set_scale(v->pipeline, v->scale);
+        spek_pipeline_set_max_rate(v->pipeline, v->max_rate);
+        if (v->band_high > v->band_low) {
+            spek_pipeline_set_band(v->pipeline, v->band_low, v->band_high);
+        }
+        // Colourised too, in case it's shown.
+        spek_pipeline_set_colors(v->pipeline, pixels_cb);
+        spek_pipeline_set_color_map(v->pipeline, this->colors);
+        spek_pipeline_set_background(v->pipeline, true);
+        spek_pipeline_start(v->pipeline);
+        v->desc = wxString::FromUTF8(spek_pipeline_desc(v->pipeline).c_str());
+        v->streams = spek_pipeline_streams(v->pipeline);
+        v->channels = spek_pipeline_channels(v->pipeline);
+        v->duration = spek_pipeline_duration(v->pipeline);
+        v->tracks = spek_pipeline_track_starts(v->pipeline);
+        v->sample_rate = spek_pipeline_sample_rate(v->pipeline);
+        spek_pipeline_band(v->pipeline, &v->min_freq, &v->max_freq);
+        // Least recently used, so it's the first to go if the cache is full.
+        this->views.push_back(std::unique_ptr<SpekView>(v));
+        running++;
+    }
+}
+
+SpekView *SpekSpectrogram::lookup_view(
+    int stream, int channel, enum window_function window_function, int fft_bits, int samples,
+    int rows)
+{
+    int max_rate = SpekPreferences::get().get_max_sample_rate();
+    for (const auto& item : this->views) {
+        if (item->stream == stream &&
+            item->channel == channel &&
+            item->window_function == window_function &&
+            item->fft_bits == fft_bits &&
+            item->samples == samples &&
+            item->rows == rows &&
+            item->band_low == this->band_low &&
+            item->band_high == this->band_high &&
+            item->max_rate == max_rate &&
+            item->scale == this->scale) {
+            return item.get();
+        }
+    }
+    return NULL;
+}
+
+SpekView *SpekSpectrogram::find_view(int samples, int rows)
+{
+    int max_rate = SpekPreferences::get().get_max_sample_rate();
+    for (auto it = this->views.begin(); it != this->views.end(); ++it) {
+        SpekView *view = it->get();
+        if (view->stream == this->stream &&
+            view->channel == this->channel &&
+            view->window_function == this->window_function &&
+            view->fft_bits == this->fft_bits &&
+            view->samples == samples &&
+            view->rows == rows &&
+            view->band_low == this->band_low &&
+            view->band_high == this->band_high &&
+            view->max_rate == max_rate &&
+            view->scale == this->scale) {
+            // Move to the front of the list to mark as recently used.
+            this->views.splice(this->views.begin(), this->views, it);
+            return view;
+        }
+    }
+    return NULL;
+}
+
+void SpekSpectrogram::show_view(SpekView *view)
+{
+    this->view = view;
+    this->desc = view->desc;
+    this->streams = view->streams;
+    this->channels = view->channels;
+    this->duration = view->duration;
+    this->tracks = view->tracks;
+    this->sample_rate = view->sample_rate;
+    this->min_freq = view->min_freq;
+    this->max_freq = view->max_freq;
+
+    this->image.Create(view->samples, view->rows);
+    int columns = spek_max(view->columns, view->previewed);
+    std::vector<float> values(view->rows);
+    for (int sample = 0; sample < columns; sample++) {
+        view->values.get(sample, values.data());
+        this->draw_column(sample, view->rows, values.data());
+    }
+}
+
+// Drop the least recently used views which are no longer needed to fit into VIEWS_SIZE.
+void SpekSpectrogram::trim_views()
+{
+    size_t size = 0;
+    for (auto it = this->views.begin(); it != this->views.end(); ) {
+        SpekView *view = it->get();
+        size += view->values.get_bytes();
+        if (size > VIEWS_SIZE && view != this->view && !view->pipeline) {
+            size -= view->values.get_bytes();
+            it = this->views.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t SpekSpectrogram::get_memory() const
+{
+    size_t size = 0;
+    std::set<spek_pipeline*> pipelines;
+    for (const auto& view : this->views) {
+        size += sizeof(SpekView) + view->values.get_bytes() + view->approximate.size() / 8;
+        if (view->pipeline) {
+            pipelines.insert(view->pipeline);
+        }
+    }
+    for (spek_pipeline *pipeline : pipelines) {
+        size += spek_pipeline_memory(pipeline);
+    }
+    return size + (size_t)this->image.GetWidth() * this->image.GetHeight() * 3;
+}
+
+// The number of values kept per column for the FFT size.
+int SpekSpectrogram::get_rows(int fft_bits)
+{
+    int bands = bits_to_bands(fft_bits);
+    int height = GetClientSize().GetHeight() - TPAD - BPAD;
+    if (this->scale != SCALE_LINEAR) {
+        // Rows of the non-linear scales are narrower than the bands at the bottom.
+        return height > 0 ? height : bands;
+    }
+    if (!SpekPreferences::get().get_reduce_rows()) {
+        return bands;
+    }
+    return height > 0 ? spek_min(height, bands) : bands;
+}
 
-        // Make sure all have_sample events are processed before returning.
-        wxApp::GetInstance()->ProcessPendingEvents();
+// Colourise with the current palette and range, here and in the running pipelines.
+void SpekSpectrogram::update_colors()
+{
+    if (this->colors && this->colors->get_palette() == this->palette &&
+        this->colors->get_lrange() == this->lrange && this->colors->get_urange() == this->urange) {
+        return;
+    }
+    this->colors = std::make_shared<const ColorMap>(this->palette, this->lrange, this->urange);
+    for (const auto& view : this->views) {
+        if (view->pipeline) {
+            spek_pipeline_set_color_map(view->pipeline, this->colors);
+        }
     }
 }
 
@@ -438,6 +1532,84 @@ void SpekSpectrogram::create_palette()
 }
 
 // Trim `s` so that it fits into `length`.
+// The peaks of the columns known so far in a dim colour, and their RMS level over them.
+static void draw_waveform(wxDC& dc, const SpekFrame& frame)
+{
+    int width = frame.width - LPAD - RPAD;
+    if (!frame.envelopes || width <= 0 || frame.samples <= 0) {
+        return;
+    }
+
+    double middle = TPAD - GAP - LANE / 2.0;
+    double half = LANE / 2.0;
+    wxPen peak_pen(wxColour(80, 112, 144));
+    wxPen rms_pen(wxColour(160, 208, 255));
+    for (int x = 0; x < width; x++) {
+        // There are more columns than pixels when exporting at a larger size.
+        int first = (int)((int64_t)x * frame.samples / width);
+        int last = spek_max(first + 1, (int)((int64_t)(x + 1) * frame.samples / width));
+        last = spek_min(last, frame.columns);
+        if (first >= last) {
+            break;
+        }
+        float min = frame.envelopes[first].min;
+        float max = frame.envelopes[first].max;
+        float rms = frame.envelopes[first].rms;
+        for (int i = first + 1; i < last; i++) {
+            min = fminf(min, frame.envelopes[i].min);
+            max = fmaxf(max, frame.envelopes[i].max);
+            rms = fmaxf(rms, frame.envelopes[i].rms);
+        }
+        min = fmaxf(min, -1.0f);
+        max = fminf(max, 1.0f);
+        rms = fminf(rms, 1.0f);
+
+        dc.SetPen(peak_pen);
+        dc.DrawLine(
+            LPAD + x, (int)round(middle - max * half),
+            LPAD + x, (int)round(middle - min * half) + 1
+        );
+        dc.SetPen(rms_pen);
+        dc.DrawLine(
+            LPAD + x, (int)round(middle - rms * half),
+            LPAD + x, (int)round(middle + rms * half) + 1
+        );
+    }
+    dc.SetPen(*wxWHITE_PEN);
+}
+
+// A line across the waveform lane where each track after the first starts, with its number.
+static void draw_tracks(wxDC& dc, const SpekFrame& frame)
+{
+    int width = frame.width - LPAD - RPAD;
+    if (frame.tracks.empty() || width <= 0) {
+        return;
+    }
+
+    dc.SetPen(wxPen(wxColour(192, 192, 192)));
+    for (size_t i = 0; i < frame.tracks.size(); i++) {
+        int x = LPAD + track_x(frame, frame.tracks[i], width);
+        dc.DrawLine(x, TPAD - GAP - LANE, x, TPAD);
+        // Only if there is room for it before the next one.
+        wxString number = wxString::Format("%d", (int)i + 2);
+        int next = i + 1 < frame.tracks.size() ?
+            LPAD + track_x(frame, frame.tracks[i + 1], width) : LPAD + width;
+        if (x + 2 + dc.GetTextExtent(number).GetWidth() < next) {
+            dc.DrawText(number, x + 2, TPAD - GAP - LANE);
+        }
+    }
+    dc.SetPen(*wxWHITE_PEN);
+}
+
+// The column of the spectrogram, `width` columns wide, that `start` seconds fall into.
+static int track_x(const SpekFrame& frame, double start, int width)
+{
+    if (frame.duration <= 0.0) {
+        return 0;
+    }
+    return spek_min(spek_max((int)(start / frame.duration * width), 0), width - 1);
+}
+
 static wxString trim(wxDC& dc, const wxString& s, int length, bool trim_end)
 {
     if (length <= 0) {
@@ -1,17 +1,43 @@
 #pragma once
 
+#include <atomic>
+#include <list>
 #include <memory>
+#include <vector>
 
 #include <wx/wx.h>
 
 #include "spek-palette.h"
 #include "spek-pipeline.h"
 
+class Analyzer;
 class Audio;
+class AudioFile;
+class ColumnsRecorder;
 class FFT;
+class SampleBits;
 class SpekHaveSampleEvent;
+struct SpekView;
 struct spek_pipeline;
 
+// What export_image() draws besides the defaults.
+struct SpekExportOptions
+{
+    int channel = 0;
+    enum palette palette = PALETTE_DEFAULT;
+    // 0 for the smallest FFT that gives every row of the image a band of its own.
+    int fft_bits = 0;
+    // Checked while the file is analysed, the export fails soon after it's set.
+    const std::atomic<bool> *cancelled = nullptr;
+    // Fed the decoded samples in the first pass over the file, see spek_pipeline_add_analyzer(),
+    // their results are ready once export_image() returned true.
+    std::vector<std::shared_ptr<Analyzer>> analyzers;
+    // Set to spek_pipeline_sample_bits() of the first pass if the samples are integers.
+    SampleBits *sample_bits = nullptr;
+    // Records its columns in the first pass too.
+    ColumnsRecorder *columns = nullptr;
+};
+
 class SpekSpectrogram : public wxWindow
 {
 public:
@@ -20,21 +46,53 @@ public:
     void open(const wxString& path);
     void save(const wxString& path);
 
+    // Analyse the file at `path` and save the spectrogram as a PNG image of the given size.
+    // Unlike save() this doesn't depend on the window, and the memory used stays bounded
+    // however large the image is.
+    static bool export_image(
+        const wxString& path, const wxString& image_path, int width, int height,
+        const SpekExportOptions& options = SpekExportOptions()
+    );
+
+    // Bytes held for the open file: the analysis results, the running pipelines and the image.
+    size_t get_memory() const;
+
 private:
     void on_char(wxKeyEvent& evt);
     void on_paint(wxPaintEvent& evt);
     void on_size(wxSizeEvent& evt);
+    void on_left_down(wxMouseEvent& evt);
+    void on_motion(wxMouseEvent& evt);
+    void on_left_up(wxMouseEvent& evt);
     void on_have_sample(SpekHaveSampleEvent& evt);
+    void on_restart(wxTimerEvent& evt);
     void render(wxDC& dc);
 
     void start();
+    void restart();
     void stop();
+    void stop_pipelines(bool speculative);
+    void release_pipeline(spek_pipeline *pipeline);
+    void speculate();
+    SpekView *lookup_view(
+        int stream, int channel, enum window_function f, int bits, int samples, int rows);
+    SpekView *find_view(int samples, int rows);
+    void show_view(SpekView *view);
+    void trim_views();
+    int get_rows(int fft_bits);
 
     void create_palette();
+    void update_colors();
+    void draw_column(int sample, int bands, const float *values);
+    void copy_column(int sample, int bands, const uint8_t *pixels);
 
     std::unique_ptr<Audio> audio;
     std::unique_ptr<FFT> fft;
-    spek_pipeline *pipeline;
+    std::unique_ptr<AudioFile> spare_file; // From the last pipeline, to be rewound and reused.
+    wxTimer restart_timer;
+    std::list<std::unique_ptr<SpekView>> views; // Most recently used first.
+    SpekView *view; // The one being displayed.
+    int next_view_id;
     int streams;
     int stream;
     int channels;
@@ -43,11 +101,22 @@ private:
     wxString path;
     wxString desc;
     double duration;
+    std::vector<double> tracks; // Where the tracks after the first one start, in seconds.
     int sample_rate;
+    double min_freq; // Of the displayed bands.
+    double max_freq;
+    double band_low; // The band selected to zoom into, both 0 for the full range.
+    double band_high;
+    enum frequency_scale scale;
+    int drag_start; // Where the band selection started, -1 if not selecting.
+    int drag_end;
     enum palette palette;
     wxImage palette_image;
+    std::shared_ptr<const ColorMap> colors; // For the palette and the range.
+    std::vector<uint8_t> pixels; // Scratch space for draw_column().
     wxImage image;
     int prev_width;
+    int prev_height;
     int fft_bits;
     int urange;
     int lrange;
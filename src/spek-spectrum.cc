@@ -0,0 +1,104 @@
+#include <math.h>
+
+#include "spek-spectrum.h"
+
+enum
+{
+    MIN_LEVEL = -160, // dB, the histograms' range.
+    MAX_LEVEL = 20,
+    BUCKETS_PER_DB = 2,
+    BUCKETS = (MAX_LEVEL - MIN_LEVEL) * BUCKETS_PER_DB + 1,
+};
+
+void SpectrumStats::create(int bands)
+{
+    this->bands = bands;
+    this->columns = 0;
+    this->powers.assign(bands, 0.0);
+    this->counts.assign((size_t)bands * BUCKETS, 0);
+}
+
+void SpectrumStats::add(const float *values)
+{
+    uint32_t *counts = this->counts.data();
+    for (int band = 0; band < this->bands; band++, counts += BUCKETS) {
+        float value = values[band];
+        int bucket = 0;
+        // Silence is -inf and goes with the other underflows.
+        if (value >= MIN_LEVEL) {
+            bucket = 1 + (int)((value - MIN_LEVEL) * BUCKETS_PER_DB);
+            if (bucket >= BUCKETS) {
+                bucket = BUCKETS - 1;
+            }
+            this->powers[band] += exp(value * (M_LN10 / 10.0));
+        }
+        counts[bucket]++;
+    }
+    this->columns++;
+}
+
+void SpectrumStats::merge(const SpectrumStats& other)
+{
+    if (other.bands != this->bands) {
+        return;
+    }
+    for (int band = 0; band < this->bands; band++) {
+        this->powers[band] += other.powers[band];
+    }
+    for (size_t i = 0; i < this->counts.size(); i++) {
+        this->counts[i] += other.counts[i];
+    }
+    this->columns += other.columns;
+}
+
+double SpectrumStats::get_mean(int band) const
+{
+    if (!this->columns || this->powers[band] <= 0.0) {
+        return -INFINITY;
+    }
+    return 10.0 * log10(this->powers[band] / this->columns);
+}
+
+double SpectrumStats::get_quantile(int band, double q) const
+{
+    if (!this->columns) {
+        return -INFINITY;
+    }
+    const uint32_t *counts = this->counts.data() + (size_t)band * BUCKETS;
+    double target = q * this->columns;
+    double below = 0.0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        if (!counts[bucket] || below + counts[bucket] < target) {
+            below += counts[bucket];
+            continue;
+        }
+        if (!bucket) {
+            return -INFINITY;
+        }
+        // Assume the levels are spread evenly over the bucket.
+        double fraction = (target - below) / counts[bucket];
+        return MIN_LEVEL + (bucket - 1 + fraction) / BUCKETS_PER_DB;
+    }
+    return MAX_LEVEL;
+}
+
+void SpectrumAnalyzer::start(const AnalyzerFormat& format)
+{
+    Analyzer::start(format);
+    this->stats.create(format.bands);
+}
+
+void SpectrumAnalyzer::process_column(int sample, const float *values)
+{
+    (void)sample;
+    this->stats.add(values);
+}
+
+double SpectrumAnalyzer::get_freq(int band) const
+{
+    if (this->format.bands < 2) {
+        return this->format.low;
+    }
+    double width = this->format.high - this->format.low;
+    return this->format.low + band * width / (this->format.bands - 1);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "spek-analyzer.h"
+
+// The distribution of the level of each band over the columns: the mean power, and a histogram
+// of the levels in fixed buckets for the percentiles. The histogram is a quantile sketch for
+// values in a known range, it takes the same memory however long the file is, adding a column
+// is one increment per band, and two of them merge by adding up the counts, e.g. for sections
+// of a file analysed in parallel. The percentiles are exact to the bucket width.
+class SpectrumStats
+{
+public:
+    SpectrumStats() : bands(0), columns(0) {}
+
+    // Start over with `bands` values per column.
+    void create(int bands);
+    void add(const float *values);
+    // Add the columns of `other`, which has the same number of bands.
+    void merge(const SpectrumStats& other);
+
+    int get_bands() const { return this->bands; }
+    int64_t get_columns() const { return this->columns; }
+    // The level of the mean power of the band in dB, the long-term average spectrum.
+    double get_mean(int band) const;
+    // The level in dB the band is below in the share `q` of the columns, -inf if that's below
+    // the range of the histogram.
+    double get_quantile(int band, double q) const;
+
+private:
+    int bands;
+    int64_t columns;
+    std::vector<double> powers; // Summed per band.
+    std::vector<uint32_t> counts; // The buckets of each band, the first one for underflows.
+};
+
+// The long-term average spectrum of the analysed channel with its 10th and 90th percentiles,
+// from the columns of the first FFT size.
+class SpectrumAnalyzer : public Analyzer
+{
+public:
+    std::string get_name() const { return "spectrum"; }
+    bool wants_columns() const { return true; }
+
+    void start(const AnalyzerFormat& format);
+    void process(const float *samples, int n) { (void)samples; (void)n; }
+    void process_column(int sample, const float *values);
+    // The spectrum is too much for a few numbers, see get_stats().
+    std::vector<AnalyzerResult> get_results() const { return {}; }
+
+    const SpectrumStats& get_stats() const { return this->stats; }
+    // The frequency of the band in Hz.
+    double get_freq(int band) const;
+
+private:
+    SpectrumStats stats;
+};
@@ -0,0 +1,180 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "spek-trace.h"
+
+enum
+{
+    TRACE_EVENTS = 1 << 14, // Per-thread ring capacity, events are dropped when it's full.
+    TRACE_NAME = 32,
+};
+
+struct trace_event
+{
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Each thread writes into its own buffer, the flushing thread is the only reader. The only
+// synchronisation between the two is the pair of counters, so recording never takes a lock.
+struct trace_buffer
+{
+    trace_event events[TRACE_EVENTS];
+    std::atomic<uint32_t> head; // Written by the owning thread.
+    std::atomic<uint32_t> tail; // Written by the flushing thread.
+    std::atomic<bool> retired; // The owning thread has exited.
+    int tid;
+    char name[TRACE_NAME];
+    bool named;
+    trace_buffer *next;
+};
+
+bool spek_trace_enabled = false;
+
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static trace_buffer *trace_buffers = NULL;
+static int trace_tids = 0;
+static FILE *trace_file = NULL;
+static std::chrono::steady_clock::time_point trace_epoch;
+
+static void trace_retire(void *data)
+{
+    static_cast<trace_buffer*>(data)->retired.store(true, std::memory_order_release);
+}
+
+static void trace_open()
+{
+    const char *path = getenv("SPEK_TRACE");
+    if (!path || !*path) {
+        return;
+    }
+    trace_file = fopen(path, "w");
+    if (!trace_file) {
+        return;
+    }
+    // The JSON Array Format allows the closing bracket to be omitted, so events can be
+    // appended as they are flushed.
+    fputs("[\n", trace_file);
+    pthread_key_create(&trace_key, trace_retire);
+    trace_epoch = std::chrono::steady_clock::now();
+    spek_trace_enabled = true;
+}
+
+void spek_trace_init()
+{
+    pthread_once(&trace_once, trace_open);
+}
+
+static trace_buffer * trace_get_buffer()
+{
+    trace_buffer *buffer = static_cast<trace_buffer*>(pthread_getspecific(trace_key));
+    if (buffer) {
+        return buffer;
+    }
+
+    buffer = new trace_buffer();
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->retired = false;
+    buffer->named = false;
+    buffer->name[0] = '\0';
+    pthread_mutex_lock(&trace_mutex);
+    buffer->tid = ++trace_tids;
+    buffer->next = trace_buffers;
+    trace_buffers = buffer;
+    pthread_mutex_unlock(&trace_mutex);
+    pthread_setspecific(trace_key, buffer);
+    return buffer;
+}
+
+void spek_trace_thread_name(const char *name)
+{
+    if (!spek_trace_enabled) {
+        return;
+    }
+    trace_buffer *buffer = trace_get_buffer();
+    pthread_mutex_lock(&trace_mutex);
+    strncpy(buffer->name, name, TRACE_NAME - 1);
+    buffer->name[TRACE_NAME - 1] = '\0';
+    buffer->named = false;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+uint64_t spek_trace_now()
+{
+    auto elapsed = std::chrono::steady_clock::now() - trace_epoch;
+    // Never return 0, SpekTraceScope uses it to mark disabled spans.
+    return 1 + std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void spek_trace_record(const char *name, uint64_t begin, uint64_t end)
+{
+    if (!spek_trace_enabled) {
+        return;
+    }
+    trace_buffer *buffer = trace_get_buffer();
+    uint32_t head = buffer->head.load(std::memory_order_relaxed);
+    uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+    if (head - tail >= TRACE_EVENTS) {
+        return;
+    }
+    trace_event& event = buffer->events[head % TRACE_EVENTS];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void spek_trace_flush()
+{
+    if (!spek_trace_enabled) {
+        return;
+    }
+
+    pthread_mutex_lock(&trace_mutex);
+    trace_buffer **link = &trace_buffers;
+    while (trace_buffer *buffer = *link) {
+        if (!buffer->named && buffer->name[0]) {
+            fprintf(
+                trace_file,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}},\n",
+                buffer->tid, buffer->name
+            );
+            buffer->named = true;
+        }
+
+        // Check for retirement first, all the events are visible to us after that.
+        bool retired = buffer->retired.load(std::memory_order_acquire);
+        uint32_t head = buffer->head.load(std::memory_order_acquire);
+        uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+        for (; tail != head; ++tail) {
+            const trace_event& event = buffer->events[tail % TRACE_EVENTS];
+            fprintf(
+                trace_file,
+                "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%llu,\"dur\":%llu},\n",
+                event.name, buffer->tid,
+                (unsigned long long)event.begin, (unsigned long long)(event.end - event.begin)
+            );
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+
+        if (retired) {
+            *link = buffer->next;
+            delete buffer;
+        } else {
+            link = &buffer->next;
+        }
+    }
+    fflush(trace_file);
+    pthread_mutex_unlock(&trace_mutex);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// Opt-in recorder of Chrome trace events, enabled by pointing SPEK_TRACE at an output file.
+// The file can be opened in chrome://tracing or https://ui.perfetto.dev to see how the reader,
+// the worker and the UI threads interleave.
+
+extern bool spek_trace_enabled;
+
+// Reads SPEK_TRACE and opens the output file, safe to call more than once.
+void spek_trace_init();
+
+// Name the calling thread in the trace.
+void spek_trace_thread_name(const char *name);
+
+// Append all recorded events to the output file.
+void spek_trace_flush();
+
+uint64_t spek_trace_now();
+void spek_trace_record(const char *name, uint64_t begin, uint64_t end);
+
+// Records a span covering the lifetime of the object, `name` must be a string literal.
+class SpekTraceScope
+{
+public:
+    SpekTraceScope(const char *name) :
+        name(name), begin(spek_trace_enabled ? spek_trace_now() : 0) {}
+    ~SpekTraceScope()
+    {
+        if (this->begin) {
+            spek_trace_record(this->name, this->begin, spek_trace_now());
+        }
+    }
+
+private:
+    SpekTraceScope(const SpekTraceScope&);
+    void operator=(const SpekTraceScope&);
+
+    const char *name;
+    uint64_t begin;
+};
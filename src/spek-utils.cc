@@ -1,9 +1,59 @@
 #include <assert.h>
+#include <ctype.h>
 #include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "spek-utils.h"
 
+// TODO: s/audio/media/
+const char *spek_audio_extensions[] = {
+    "3gp",
+    "aac",
+    "aif",
+    "aifc",
+    "aiff",
+    "amr",
+    "awb",
+    "ape",
+    "au",
+    "dts",
+    "flac",
+    "flv",
+    "gsm",
+    "m4a",
+    "m4p",
+    "mp3",
+    "mp4",
+    "mp+",
+    "mpc",
+    "mpp",
+    "oga",
+    "ogg",
+    "opus",
+    "ra",
+    "ram",
+    "snd",
+    "wav",
+    "wma",
+    "wv",
+    NULL
+};
+
+long long spek_mtime_ns(const struct stat& st)
+{
+#if defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return st.st_mtime * 1000000000LL;
+#else
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
 int spek_vercmp(const char *a, const char *b)
 {
     assert(a && b);
@@ -45,3 +95,54 @@ int spek_vercmp(const char *a, const char *b)
         b = j + 1;
     }
 }
+
+bool spek_is_audio_file(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/')) {
+        return false;
+    }
+    for (int i = 0; spek_audio_extensions[i]; ++i) {
+        const char *a = dot + 1, *b = spek_audio_extensions[i];
+        while (*a && tolower((unsigned char)*a) == *b) {
+            a++;
+            b++;
+        }
+        if (!*a && !*b) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static spek_translate_cb translate_cb = NULL;
+
+void spek_set_translate(spek_translate_cb cb)
+{
+    translate_cb = cb;
+}
+
+std::string spek_translate(const char *message, const char *plural, int n)
+{
+    if (translate_cb) {
+        return translate_cb(message, plural, n);
+    }
+    return plural && n != 1 ? plural : message;
+}
+
+std::string spek_format(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len <= 0) {
+        return std::string();
+    }
+    std::string s(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&s[0], s.size(), format, args);
+    va_end(args);
+    s.resize(len);
+    return s;
+}
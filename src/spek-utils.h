@@ -1,5 +1,10 @@
 #pragma once
 
+#include <string>
+
+// Forward declarations.
+struct stat;
+
 inline int spek_max(int a, int b)
 {
     return a > b ? a : b;
@@ -10,5 +15,23 @@ inline int spek_min(int a, int b)
     return a < b ? a : b;
 }
 
+// The modification time of a file in nanoseconds, or in whole seconds where the system has no
+// finer one.
+long long spek_mtime_ns(const struct stat& st);
+
 // Compare version numbers, e.g. 1.9.2 < 1.10.0
 int spek_vercmp(const char *a, const char *b);
+
+// The extensions of the files offered in the Open dialog, lowercase and NULL-terminated.
+extern const char *spek_audio_extensions[];
+// Whether `path` has one of them, in any case.
+bool spek_is_audio_file(const char *path);
+
+// Translates the messages of the engine, `plural` is NULL unless the message has a plural form
+// picked by `n`. The engine doesn't depend on wx, the program sets up its translations here.
+typedef std::string (*spek_translate_cb)(const char *message, const char *plural, int n);
+void spek_set_translate(spek_translate_cb cb);
+// The message as is until a translation is set.
+std::string spek_translate(const char *message, const char *plural = NULL, int n = 1);
+// Like sprintf() into a string.
+std::string spek_format(const char *format, ...) __attribute__ ((format (printf, 1, 2)));
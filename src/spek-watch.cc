@@ -0,0 +1,582 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef OS_WIN
+#include <dirent.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "spek-bits.h"
+#include "spek-columns.h"
+#include "spek-report.h"
+#include "spek-utils.h"
+
+#include "spek-watch.h"
+
+enum
+{
+    RESCAN_SECONDS = 10, // How often the tree is scanned without inotify.
+    DATA_FFT_BITS = 11,
+    DATA_COLUMNS = 1024,
+};
+
+#ifndef OS_WIN
+
+typedef std::chrono::steady_clock watch_clock;
+
+// The file as it was when it was processed.
+struct spek_watch_entry
+{
+    long long size;
+    long long mtime; // In nanoseconds.
+    unsigned long long ino;
+};
+
+struct spek_watch
+{
+    std::string dir;
+    std::string out_dir;
+    std::string state_path;
+    dev_t out_dev; // The results are skipped if they're in the tree.
+    ino_t out_ino;
+    int settle_ms;
+    spek_watch_render_cb render_cb;
+    std::ostream *out;
+    int inotify_fd; // -1 without inotify, the tree is scanned again then.
+    int wake_fds[2]; // Written to by spek_watch_stop().
+    std::vector<pthread_t> workers;
+
+    // Only used by the thread of spek_watch_run().
+    std::map<int, std::string> watched; // The relative paths of the directories, by descriptor.
+    std::map<std::string, watch_clock::time_point> pending; // Files settling, until when.
+    watch_clock::time_point next_scan;
+
+    pthread_mutex_t mutex; // Guards everything below.
+    pthread_cond_t cond;
+    std::deque<std::string> queue;
+    std::set<std::string> queued;
+    std::set<std::string> active; // Being processed.
+    std::map<std::string, spek_watch_entry> state;
+    FILE *state_file; // Appended to as the files are done.
+    std::atomic<bool> cancelled;
+    int processed;
+    bool quit;
+};
+
+// Forward declarations.
+static void * worker_func(void *);
+static bool process_file(spek_watch *w, const std::string& relative_path);
+static void scan_dir(spek_watch *w, const std::string& relative_dir);
+static void read_events(spek_watch *w);
+static void enqueue_if_changed(spek_watch *w, const std::string& relative_path);
+static bool load_state(spek_watch *w, std::string *error);
+static spek_watch_entry make_entry(const struct stat& st);
+static bool same_entry(const spek_watch_entry& a, const spek_watch_entry& b);
+static void write_entry(FILE *file, const spek_watch_entry& entry, const std::string& path);
+static bool make_dirs(const std::string& path);
+static std::string join(const std::string& dir, const std::string& name);
+
+struct spek_watch * spek_watch_open(
+    const std::string& dir, const std::string& out_dir, int jobs, int settle_ms,
+    spek_watch_render_cb render_cb, std::ostream& out, std::string *error
+)
+{
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        *error = dir + " is not a directory";
+        return NULL;
+    }
+    struct stat out_st;
+    if (!make_dirs(out_dir) || stat(out_dir.c_str(), &out_st) != 0) {
+        *error = "Cannot create " + out_dir + ": " + strerror(errno);
+        return NULL;
+    }
+
+    spek_watch *w = new spek_watch();
+    w->dir = dir;
+    w->out_dir = out_dir;
+    w->state_path = out_dir + "/watch.state";
+    w->out_dev = out_st.st_dev;
+    w->out_ino = out_st.st_ino;
+    w->settle_ms = spek_max(0, settle_ms);
+    w->render_cb = render_cb;
+    w->out = &out;
+    w->inotify_fd = -1;
+    w->state_file = NULL;
+    w->cancelled = false;
+    w->processed = 0;
+    w->quit = false;
+    if (!load_state(w, error)) {
+        delete w;
+        return NULL;
+    }
+    if (pipe(w->wake_fds) != 0) {
+        *error = strerror(errno);
+        fclose(w->state_file);
+        delete w;
+        return NULL;
+    }
+#ifdef HAVE_SYS_INOTIFY_H
+    w->inotify_fd = inotify_init();
+#endif
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    for (int i = 0; i < spek_max(1, jobs); i++) {
+        pthread_t thread;
+        if (!pthread_create(&thread, NULL, &worker_func, w)) {
+            w->workers.push_back(thread);
+        }
+    }
+    if (w->workers.empty()) {
+        *error = "Cannot start the workers";
+        spek_watch_close(w);
+        return NULL;
+    }
+    return w;
+}
+
+void spek_watch_run(struct spek_watch *w)
+{
+    // Watch the directories before looking inside them, so that nothing slips through.
+    scan_dir(w, "");
+    w->next_scan = watch_clock::now() + std::chrono::seconds(RESCAN_SECONDS);
+
+    while (true) {
+        watch_clock::time_point now = watch_clock::now();
+        watch_clock::time_point wake = now + std::chrono::hours(1);
+        if (w->inotify_fd < 0) {
+            wake = w->next_scan;
+        }
+        for (const auto& item : w->pending) {
+            wake = std::min(wake, item.second);
+        }
+        int timeout = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            wake - now).count();
+
+        struct pollfd fds[2];
+        fds[0].fd = w->wake_fds[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = w->inotify_fd;
+        fds[1].events = POLLIN;
+        int ret = poll(fds, w->inotify_fd < 0 ? 1 : 2, spek_max(0, timeout));
+        if (ret < 0 && errno != EINTR) {
+            break;
+        }
+        if (ret > 0 && fds[0].revents) {
+            break;
+        }
+        if (ret > 0 && w->inotify_fd >= 0 && (fds[1].revents & POLLIN)) {
+            read_events(w);
+        }
+
+        now = watch_clock::now();
+        if (w->inotify_fd < 0 && now >= w->next_scan) {
+            scan_dir(w, "");
+            w->next_scan = now + std::chrono::seconds(RESCAN_SECONDS);
+        }
+        for (auto item = w->pending.begin(); item != w->pending.end(); ) {
+            if (item->second <= now) {
+                std::string relative_path = item->first;
+                item = w->pending.erase(item);
+                enqueue_if_changed(w, relative_path);
+            } else {
+                ++item;
+            }
+        }
+    }
+}
+
+void spek_watch_stop(struct spek_watch *w)
+{
+    char c = 0;
+    ssize_t ret = write(w->wake_fds[1], &c, 1);
+    (void)ret;
+}
+
+int spek_watch_processed(struct spek_watch *w)
+{
+    pthread_mutex_lock(&w->mutex);
+    int processed = w->processed;
+    pthread_mutex_unlock(&w->mutex);
+    return processed;
+}
+
+void spek_watch_close(struct spek_watch *w)
+{
+    pthread_mutex_lock(&w->mutex);
+    w->quit = true;
+    w->cancelled = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+    for (pthread_t thread : w->workers) {
+        pthread_join(thread, NULL);
+    }
+
+    if (w->inotify_fd >= 0) {
+        close(w->inotify_fd);
+    }
+    close(w->wake_fds[0]);
+    close(w->wake_fds[1]);
+    fclose(w->state_file);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    delete w;
+}
+
+static void * worker_func(void *pp)
+{
+    spek_watch *w = (spek_watch *)pp;
+    while (true) {
+        pthread_mutex_lock(&w->mutex);
+        while (w->queue.empty() && !w->quit) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->quit) {
+            pthread_mutex_unlock(&w->mutex);
+            break;
+        }
+        std::string relative_path = w->queue.front();
+        w->queue.pop_front();
+        w->queued.erase(relative_path);
+        w->active.insert(relative_path);
+        pthread_mutex_unlock(&w->mutex);
+
+        // Taken before reading it: if it changes in the meantime, it's processed again.
+        struct stat st;
+        std::string path = join(w->dir, relative_path);
+        bool exists = stat(path.c_str(), &st) == 0;
+        bool ok = exists && process_file(w, relative_path);
+
+        pthread_mutex_lock(&w->mutex);
+        w->active.erase(relative_path);
+        // A cancelled file is done again next time, a failed one only once it changes.
+        if (exists && !w->cancelled) {
+            spek_watch_entry entry = make_entry(st);
+            w->state[relative_path] = entry;
+            write_entry(w->state_file, entry, relative_path);
+            fflush(w->state_file);
+            *w->out << (ok ? "done\t" : "failed\t") << path << std::endl;
+            w->processed++;
+        }
+        pthread_mutex_unlock(&w->mutex);
+    }
+    return NULL;
+}
+
+// Write the results of one file, each to a temporary file first so that they're never seen
+// half done. They all come from one pass over the file.
+static bool process_file(spek_watch *w, const std::string& relative_path)
+{
+    std::string path = join(w->dir, relative_path);
+    std::string base = join(w->out_dir, relative_path);
+    size_t slash = base.rfind('/');
+    if (slash != std::string::npos && !make_dirs(base.substr(0, slash))) {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<Analyzer>> analyzers = spek_report_analyzers();
+    ColumnsRecorder columns(DATA_FFT_BITS, DATA_COLUMNS);
+    SampleBits bits;
+
+    bool ok;
+    std::string tmp_path = base + ".png.tmp";
+    if (w->render_cb) {
+        ok = w->render_cb(path, tmp_path, analyzers, &columns, &bits, &w->cancelled) &&
+            rename(tmp_path.c_str(), (base + ".png").c_str()) == 0;
+        unlink(tmp_path.c_str());
+    } else {
+        ok = spek_report_analyse(path, analyzers, &columns, &bits, &w->cancelled);
+    }
+
+    tmp_path = base + ".f32.tmp";
+    ok = ok && columns.save(tmp_path) && rename(tmp_path.c_str(), (base + ".f32").c_str()) == 0;
+    unlink(tmp_path.c_str());
+
+    tmp_path = base + ".tsv.tmp";
+    if (ok) {
+        std::ofstream out(tmp_path.c_str());
+        out << spek_report_header() << std::endl;
+        out << spek_report_line(path, analyzers, bits.get_bits() ? &bits : NULL) << std::endl;
+        out.close();
+        ok = !out.fail() && rename(tmp_path.c_str(), (base + ".tsv").c_str()) == 0;
+    }
+    unlink(tmp_path.c_str());
+    return ok && !w->cancelled;
+}
+
+// Watch the directory and the ones below it, and look at the audio files in them.
+static void scan_dir(spek_watch *w, const std::string& relative_dir)
+{
+    std::string dir = join(w->dir, relative_dir);
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || (st.st_dev == w->out_dev && st.st_ino == w->out_ino)) {
+        return;
+    }
+#ifdef HAVE_SYS_INOTIFY_H
+    if (w->inotify_fd >= 0) {
+        int wd = inotify_add_watch(
+            w->inotify_fd, dir.c_str(),
+            IN_CREATE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR
+        );
+        if (wd >= 0) {
+            w->watched[wd] = relative_dir;
+        }
+    }
+#endif
+
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    watch_clock::time_point settled = watch_clock::now() +
+        std::chrono::milliseconds(w->settle_ms);
+    std::vector<std::string> subdirs;
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string relative_path = relative_dir.empty() ? name : relative_dir + "/" + name;
+        // Symbolic links to directories aren't followed, they could make a loop.
+        if (lstat(join(w->dir, relative_path).c_str(), &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            subdirs.push_back(relative_path);
+        } else if (spek_is_audio_file(name.c_str()) && !w->pending.count(relative_path)) {
+            w->pending[relative_path] = settled;
+        }
+    }
+    closedir(d);
+    for (const auto& subdir : subdirs) {
+        scan_dir(w, subdir);
+    }
+}
+
+// Note the files that were written to, they're looked at once they settle.
+static void read_events(spek_watch *w)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(w->inotify_fd, buffer, sizeof(buffer));
+    watch_clock::time_point settled = watch_clock::now() +
+        std::chrono::milliseconds(w->settle_ms);
+    for (char *p = buffer; len > 0 && p < buffer + len; ) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            // Events were lost, look at everything again.
+            scan_dir(w, "");
+            continue;
+        }
+        auto watched = w->watched.find(event->wd);
+        if (watched == w->watched.end()) {
+            continue;
+        }
+        if (event->mask & IN_IGNORED) {
+            w->watched.erase(watched);
+            continue;
+        }
+        if (!event->len) {
+            continue;
+        }
+        std::string relative_dir = watched->second;
+        std::string relative_path = relative_dir.empty() ?
+            event->name : relative_dir + "/" + event->name;
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                scan_dir(w, relative_path);
+            }
+        } else if (spek_is_audio_file(event->name)) {
+            // Each write pushes it back.
+            w->pending[relative_path] = settled;
+        }
+    }
+#else
+    (void)w;
+#endif
+}
+
+static void enqueue_if_changed(spek_watch *w, const std::string& relative_path)
+{
+    struct stat st;
+    if (stat(join(w->dir, relative_path).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    // Can't be kept in the state.
+    if (relative_path.find('\n') != std::string::npos) {
+        return;
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    if (w->active.count(relative_path)) {
+        // Look again once it's done.
+        w->pending[relative_path] = watch_clock::now() + std::chrono::milliseconds(w->settle_ms);
+    } else if (!w->queued.count(relative_path)) {
+        auto entry = w->state.find(relative_path);
+        if (entry == w->state.end() || !same_entry(entry->second, make_entry(st))) {
+            w->queue.push_back(relative_path);
+            w->queued.insert(relative_path);
+            pthread_cond_signal(&w->cond);
+        }
+    }
+    pthread_mutex_unlock(&w->mutex);
+}
+
+// Read the files processed before, the last line of a file is the one that counts. The files
+// that are gone are dropped and the state is written again without them before it's appended
+// to. The lines of older versions, with the mtime in whole seconds and no inode, are dropped
+// too, so those files are done again.
+static bool load_state(spek_watch *w, std::string *error)
+{
+    std::ifstream in(w->state_path.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        char *end;
+        long long size = strtoll(line.c_str(), &end, 10);
+        if (*end != '\t') {
+            continue;
+        }
+        long long seconds = strtoll(end + 1, &end, 10);
+        if (*end != '.') {
+            continue;
+        }
+        long long nanoseconds = strtoll(end + 1, &end, 10);
+        if (*end != '\t') {
+            continue;
+        }
+        unsigned long long ino = strtoull(end + 1, &end, 10);
+        if (*end != '\t' || !end[1]) {
+            continue;
+        }
+        spek_watch_entry entry = { size, seconds * 1000000000LL + nanoseconds, ino };
+        w->state[end + 1] = entry;
+    }
+    in.close();
+
+    std::string tmp_path = w->state_path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    if (!file) {
+        *error = "Cannot write " + tmp_path + ": " + strerror(errno);
+        return false;
+    }
+    for (auto entry = w->state.begin(); entry != w->state.end(); ) {
+        if (access(join(w->dir, entry->first).c_str(), F_OK) != 0) {
+            entry = w->state.erase(entry);
+            continue;
+        }
+        write_entry(file, entry->second, entry->first);
+        ++entry;
+    }
+    if (fclose(file) != 0 || rename(tmp_path.c_str(), w->state_path.c_str()) != 0) {
+        *error = "Cannot write " + w->state_path + ": " + strerror(errno);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    w->state_file = fopen(w->state_path.c_str(), "a");
+    if (!w->state_file) {
+        *error = "Cannot write " + w->state_path + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+static spek_watch_entry make_entry(const struct stat& st)
+{
+    spek_watch_entry entry = {
+        (long long)st.st_size, spek_mtime_ns(st), (unsigned long long)st.st_ino
+    };
+    return entry;
+}
+
+static bool same_entry(const spek_watch_entry& a, const spek_watch_entry& b)
+{
+    return a.size == b.size && a.mtime == b.mtime && a.ino == b.ino;
+}
+
+// The size, the mtime as seconds.nanoseconds, the inode and the path, separated by tabs.
+static void write_entry(FILE *file, const spek_watch_entry& entry, const std::string& path)
+{
+    fprintf(
+        file, "%lld\t%lld.%09lld\t%llu\t%s\n", entry.size, entry.mtime / 1000000000LL,
+        entry.mtime % 1000000000LL, entry.ino, path.c_str()
+    );
+}
+
+// Like mkdir -p.
+static bool make_dirs(const std::string& path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string dir = path.substr(0, slash);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+static std::string join(const std::string& dir, const std::string& name)
+{
+    return name.empty() ? dir : dir + "/" + name;
+}
+
+#else
+
+struct spek_watch * spek_watch_open(
+    const std::string& dir, const std::string& out_dir, int jobs, int settle_ms,
+    spek_watch_render_cb render_cb, std::ostream& out, std::string *error
+)
+{
+    (void)dir;
+    (void)out_dir;
+    (void)jobs;
+    (void)settle_ms;
+    (void)render_cb;
+    (void)out;
+    *error = "Not supported on this platform";
+    return NULL;
+}
+
+void spek_watch_run(struct spek_watch *watch)
+{
+    (void)watch;
+}
+
+void spek_watch_stop(struct spek_watch *watch)
+{
+    (void)watch;
+}
+
+int spek_watch_processed(struct spek_watch *watch)
+{
+    (void)watch;
+    return 0;
+}
+
+void spek_watch_close(struct spek_watch *watch)
+{
+    (void)watch;
+}
+
+#endif
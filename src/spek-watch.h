@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Analyzer;
+class ColumnsRecorder;
+class SampleBits;
+struct spek_watch;
+
+// Saves the image of the audio file at `path` to `out_path`, on a worker thread of the watch.
+// The decoded samples go to `analyzers` and `columns` in the same pass and the bits of the
+// samples to `bits`, as spek_report_analyse() does without an image. Returns false if it can't,
+// or if `cancelled` was set in the meantime.
+typedef bool (*spek_watch_render_cb)(
+    const std::string& path, const std::string& out_path,
+    const std::vector<std::shared_ptr<Analyzer>>& analyzers, ColumnsRecorder *columns,
+    SampleBits *bits, const std::atomic<bool> *cancelled);
+
+// Watch the tree under `dir` for audio files, see spek_is_audio_file(), that are new or have
+// changed. Once a file has been left alone for `settle_ms` its results are written under
+// `out_dir`, at the same path relative to it: the image made by `render_cb` with .png added,
+// the columns as in spek_report_columns() with .f32 and the report line with .tsv, all from one
+// pass over the file, that of `render_cb` if there is one. Up to `jobs` files are processed at
+// once, and a line is written to `out` for each, "done" or "failed", a tab and the path. The
+// files processed are kept in `out_dir`/watch.state with their size, modification time to the
+// nanosecond and inode, so that the ones that haven't changed since are skipped, also after a
+// restart. The tree is watched through inotify where there is one and scanned again every few
+// seconds elsewhere. Returns NULL with the reason in `error` if it can't watch `dir` or keep the
+// state. Not available on Windows.
+struct spek_watch * spek_watch_open(
+    const std::string& dir, const std::string& out_dir, int jobs, int settle_ms,
+    spek_watch_render_cb render_cb, std::ostream& out, std::string *error
+);
+// Watch until spek_watch_stop() is called.
+void spek_watch_run(struct spek_watch *watch);
+// Make spek_watch_run() return. Safe to call from any thread and from signal handlers.
+void spek_watch_stop(struct spek_watch *watch);
+// The number of files processed since the watch was opened, done or failed.
+int spek_watch_processed(struct spek_watch *watch);
+// Cancel the files being processed and stop the workers.
+void spek_watch_close(struct spek_watch *watch);
@@ -165,40 +165,6 @@ void SpekWindow::open(const wxString& path)
     }
 }
 
-// TODO: s/audio/media/
-static const char *audio_extensions[] = {
-    "3gp",
-    "aac",
-    "aif",
-    "aifc",
-    "aiff",
-    "amr",
-    "awb",
-    "ape",
-    "au",
-    "dts",
-    "flac",
-    "flv",
-    "gsm",
-    "m4a",
-    "m4p",
-    "mp3",
-    "mp4",
-    "mp+",
-    "mpc",
-    "mpp",
-    "oga",
-    "ogg",
-    "opus",
-    "ra",
-    "ram",
-    "snd",
-    "wav",
-    "wma",
-    "wv",
-    NULL
-};
-
 void SpekWindow::on_open(wxCommandEvent&)
 {
     static wxString filters = wxEmptyString;
@@ -210,13 +176,16 @@ void SpekWindow::on_open(wxCommandEvent&)
         filters += "|*.*|";
         filters += _("Audio files");
         filters += "|";
-        for (int i = 0; audio_extensions[i]; ++i) {
+        for (int i = 0; spek_audio_extensions[i]; ++i) {
             if (i) {
                 filters += ";";
             }
             filters += "*.";
-            filters += wxString::FromAscii(audio_extensions[i]);
+            filters += wxString::FromAscii(spek_audio_extensions[i]);
         }
+        filters += "|";
+        filters += _("Cue sheets and playlists");
+        filters += "|*.cue;*.m3u;*.m3u8";
         filters.Shrink();
     }
 
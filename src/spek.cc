@@ -1,17 +1,35 @@
+#include <signal.h>
+
+#include <iostream>
+#include <thread>
+
 #include <wx/cmdline.h>
+#include <wx/filename.h>
 #include <wx/log.h>
 #include <wx/socket.h>
 
 #include "spek-artwork.h"
 #include "spek-platform.h"
 #include "spek-preferences.h"
+#include "spek-report.h"
+#include "spek-server.h"
+#include "spek-spectrogram.h"
+#include "spek-utils.h"
+#include "spek-watch.h"
 
 #include "spek-window.h"
 
+enum
+{
+    EXPORT_WIDTH = 4096,
+    EXPORT_HEIGHT = 2048,
+    WATCH_SETTLE_MS = 2000, // Files still being written to are left alone for that long.
+};
+
 class Spek: public wxApp
 {
 public:
-    Spek() : wxApp(), window(NULL), quit(false) {}
+    Spek() : wxApp(), window(NULL), quit(false), exit_code(0) {}
 
 protected:
     virtual bool OnInit();
@@ -24,10 +42,17 @@ private:
     SpekWindow *window;
     wxString path;
     bool quit;
+    int exit_code;
 };
 
 IMPLEMENT_APP(Spek)
 
+// Forward declarations.
+static std::string translate(const char *message, const char *plural, int n);
+static int serve(const wxString& socket_path, const wxString& cache_dir, int jobs);
+static int watch_dir(const wxString& dir, const wxString& out_dir, int jobs, int width,
+    int height);
+
 bool Spek::OnInit()
 {
     wxInitAllImageHandlers();
@@ -36,6 +61,7 @@ bool Spek::OnInit()
     spek_artwork_init();
     spek_platform_init();
     SpekPreferences::get().init();
+    spek_set_translate(translate);
 
     static const wxCmdLineEntryDesc desc[] = {{
             wxCMD_LINE_SWITCH,
@@ -51,13 +77,80 @@ bool Spek::OnInit()
             "Display the version and exit",
             wxCMD_LINE_VAL_NONE,
             wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            "e",
+            "export",
+            "Save the spectrogram of FILE as a PNG image and exit",
+            wxCMD_LINE_VAL_STRING,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            NULL,
+            "width",
+            "Width of the exported image",
+            wxCMD_LINE_VAL_NUMBER,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            NULL,
+            "height",
+            "Height of the exported image",
+            wxCMD_LINE_VAL_NUMBER,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_SWITCH,
+            "r",
+            "report",
+            "Check each FILE for the cutoff of a lossy source and measure its levels, print the "
+            "results as tab-separated values and exit",
+            wxCMD_LINE_VAL_NONE,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            "j",
+            "jobs",
+            "Number of files to analyse at once for the report, the server or the watch, all "
+            "cores by default",
+            wxCMD_LINE_VAL_NUMBER,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_SWITCH,
+            NULL,
+            "spectrum",
+            "Print the long-term average spectrum of FILE and the 10th and 90th percentiles of "
+            "its levels as tab-separated values and exit",
+            wxCMD_LINE_VAL_NONE,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            NULL,
+            "serve",
+            "Render the spectrograms clients ask for on the Unix domain socket SOCKET",
+            wxCMD_LINE_VAL_STRING,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            NULL,
+            "cache",
+            "Directory the server or the watch keeps its results in",
+            wxCMD_LINE_VAL_STRING,
+            wxCMD_LINE_PARAM_OPTIONAL,
+        }, {
+            wxCMD_LINE_OPTION,
+            NULL,
+            "watch",
+            "Save the images, columns and reports of the new and changed audio files under DIR "
+            "until interrupted",
+            wxCMD_LINE_VAL_STRING,
+            wxCMD_LINE_PARAM_OPTIONAL,
         }, {
             wxCMD_LINE_PARAM,
             NULL,
             NULL,
             "FILE",
             wxCMD_LINE_VAL_STRING,
-            wxCMD_LINE_PARAM_OPTIONAL,
+            wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE,
         },
         wxCMD_LINE_DESC_END,
     };
@@ -82,6 +175,75 @@ bool Spek::OnInit()
         this->path = parser.GetParam();
     }
 
+    if (parser.Found("report")) {
+        long jobs = spek_max(1, (int)std::thread::hardware_concurrency());
+        parser.Found("jobs", &jobs);
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < parser.GetParamCount(); i++) {
+            paths.push_back(std::string(parser.GetParam(i).utf8_str()));
+        }
+        this->quit = true;
+        if (spek_report(paths, jobs, std::cout)) {
+            this->exit_code = 1;
+        }
+        return true;
+    }
+
+    if (parser.Found("spectrum")) {
+        this->quit = true;
+        if (this->path.IsEmpty() ||
+            spek_report_spectrum(std::string(this->path.utf8_str()), std::cout, std::cerr)) {
+            this->exit_code = 1;
+        }
+        return true;
+    }
+
+    wxString socket_path;
+    if (parser.Found("serve", &socket_path)) {
+        long jobs = spek_max(1, (int)std::thread::hardware_concurrency());
+        parser.Found("jobs", &jobs);
+        wxString cache_dir;
+        if (!parser.Found("cache", &cache_dir)) {
+            cache_dir = spek_platform_cache_path("spek");
+        }
+        this->quit = true;
+        this->exit_code = serve(socket_path, cache_dir, jobs);
+        return true;
+    }
+
+    wxString dir;
+    if (parser.Found("watch", &dir)) {
+        long jobs = spek_max(1, (int)std::thread::hardware_concurrency());
+        parser.Found("jobs", &jobs);
+        long width = EXPORT_WIDTH;
+        long height = EXPORT_HEIGHT;
+        parser.Found("width", &width);
+        parser.Found("height", &height);
+        wxString out_dir;
+        if (!parser.Found("cache", &out_dir)) {
+            out_dir = spek_platform_cache_path("spek") + wxFILE_SEP_PATH + "watch";
+        }
+        this->quit = true;
+        this->exit_code = watch_dir(dir, out_dir, jobs, width, height);
+        return true;
+    }
+
+    wxString image_path;
+    if (parser.Found("export", &image_path)) {
+        long width = EXPORT_WIDTH;
+        long height = EXPORT_HEIGHT;
+        parser.Found("width", &width);
+        parser.Found("height", &height);
+        this->quit = true;
+        if (this->path.IsEmpty() ||
+            !SpekSpectrogram::export_image(this->path, image_path, width, height)) {
+            wxFprintf(stderr, _("Cannot export the spectrogram to %s"), image_path);
+            wxFprintf(stderr, "\n");
+            this->exit_code = 1;
+        }
+        return true;
+    }
+
     this->window = new SpekWindow(this->path);
     this->window->Show(true);
     SetTopWindow(this->window);
@@ -91,7 +253,7 @@ bool Spek::OnInit()
 int Spek::OnRun()
 {
     if (quit) {
-        return 0;
+        return this->exit_code;
     }
 
     return wxApp::OnRun();
@@ -105,3 +267,110 @@ void Spek::MacOpenFiles(const wxArrayString& files)
     }
 }
 #endif
+
+static std::string translate(const char *message, const char *plural, int n)
+{
+    if (plural) {
+        return std::string(wxGetTranslation(
+            wxString::FromUTF8(message), wxString::FromUTF8(plural), n
+        ).utf8_str());
+    }
+    return std::string(wxGetTranslation(wxString::FromUTF8(message)).utf8_str());
+}
+
+static spek_server *server;
+static spek_watch *watch;
+static int watch_width;
+static int watch_height;
+
+static void stop(int)
+{
+    if (server) {
+        spek_server_stop(server);
+    }
+    if (watch) {
+        spek_watch_stop(watch);
+    }
+}
+
+static bool render(
+    const spek_request *request, const std::string& out_path, const std::atomic<bool> *cancelled)
+{
+    SpekExportOptions options;
+    options.channel = request->channel;
+    options.palette = request->palette;
+    options.fft_bits = request->fft_bits;
+    options.cancelled = cancelled;
+    return SpekSpectrogram::export_image(
+        wxString::FromUTF8(request->path.c_str()), wxString::FromUTF8(out_path.c_str()),
+        request->width, request->height, options
+    );
+}
+
+// Serve the clients until interrupted, see spek_server_open().
+static int serve(const wxString& socket_path, const wxString& cache_dir, int jobs)
+{
+    std::string error;
+    if (!wxFileName::Mkdir(cache_dir, 0755, wxPATH_MKDIR_FULL)) {
+        wxFprintf(stderr, _("Cannot create the directory %s"), cache_dir);
+        wxFprintf(stderr, "\n");
+        return 1;
+    }
+    server = spek_server_open(
+        std::string(socket_path.utf8_str()), std::string(cache_dir.utf8_str()), jobs, render,
+        &error
+    );
+    if (!server) {
+        wxFprintf(stderr, "%s: %s\n", socket_path, wxString::FromUTF8(error.c_str()));
+        return 1;
+    }
+#ifndef OS_WIN
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+#endif
+    spek_server_run(server);
+    spek_server_close(server);
+    server = NULL;
+    return 0;
+}
+
+static bool render_file(
+    const std::string& path, const std::string& out_path,
+    const std::vector<std::shared_ptr<Analyzer>>& analyzers, ColumnsRecorder *columns,
+    SampleBits *bits, const std::atomic<bool> *cancelled)
+{
+    SpekExportOptions options;
+    options.cancelled = cancelled;
+    options.analyzers = analyzers;
+    options.sample_bits = bits;
+    options.columns = columns;
+    return SpekSpectrogram::export_image(
+        wxString::FromUTF8(path.c_str()), wxString::FromUTF8(out_path.c_str()),
+        watch_width, watch_height, options
+    );
+}
+
+// Process the files as they change until interrupted, see spek_watch_open().
+static int watch_dir(const wxString& dir, const wxString& out_dir, int jobs, int width,
+    int height)
+{
+    std::string error;
+    watch_width = width;
+    watch_height = height;
+    watch = spek_watch_open(
+        std::string(dir.utf8_str()), std::string(out_dir.utf8_str()), jobs, WATCH_SETTLE_MS,
+        render_file, std::cout, &error
+    );
+    if (!watch) {
+        wxFprintf(stderr, "%s: %s\n", dir, wxString::FromUTF8(error.c_str()));
+        return 1;
+    }
+#ifndef OS_WIN
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+#endif
+    spek_watch_run(watch);
+    spek_watch_close(watch);
+    watch = NULL;
+    return 0;
+}
@@ -1,7 +1,15 @@
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
 
+#ifndef OS_WIN
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "spek-audio.h"
+
 const char *SAMPLE_FILE = SAMPLES_DIR "/perf.wav";
 const int SAMPLE_RATE = 44100;
 const int SAMPLE_DURATION = 8 * 60; // 8 minutes
@@ -39,9 +47,42 @@ static void create_samples()
     }
 }
 
+// Evict the sample file from the page cache, as far as the OS lets us.
+static void drop_cache()
+{
+#if !defined(OS_WIN) && defined(POSIX_FADV_DONTNEED)
+    int fd = open(SAMPLE_FILE, O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+static double decode(Audio& audio)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto file = audio.open(SAMPLE_FILE, 0);
+    file->start(0, 1024);
+    while (file->read() > 0) {
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
 // Reading and decoding an audio file.
 static void perf_decoder()
 {
+    for (bool read_ahead : {false, true}) {
+        Audio audio;
+        audio.set_read_ahead(read_ahead);
+        drop_cache();
+        double cold = decode(audio);
+        double warm = decode(audio);
+        std::cout << "decoder (" << (read_ahead ? "read-ahead" : "default I/O") << "): ";
+        std::cout << "cold cache " << cold << "s, warm cache " << warm << "s" << std::endl;
+    }
 }
 
 // Running FFTs and processing the results.
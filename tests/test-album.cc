@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include "spek-album.h"
+#include "spek-audio.h"
+
+#include "test.h"
+
+static void test_track(
+    const AudioSource& track, const std::string& file_name, double start, double end)
+{
+    test("file name", file_name, track.file_name);
+    test("start", start, track.start);
+    test("end", end, track.end);
+}
+
+static std::string temp_dir()
+{
+    char dir[] = "/tmp/spek-test-XXXXXX";
+    test("temp dir", true, mkdtemp(dir) != NULL);
+    return std::string(dir) + "/";
+}
+
+static void test_is_album()
+{
+    test("cue", true, spek_is_album("/music/album.cue"));
+    test("upper case", true, spek_is_album("ALBUM.CUE"));
+    test("m3u", true, spek_is_album("list.m3u"));
+    test("m3u8", true, spek_is_album("list.m3u8"));
+    test("flac", false, spek_is_album("album.flac"));
+    test("directory", false, spek_is_album("/music/a.cue/track.flac"));
+    test("none", false, spek_is_album("cue"));
+}
+
+static void test_cue()
+{
+    std::string dir = temp_dir();
+    std::string path = dir + "album.cue";
+    std::ofstream(path.c_str()) <<
+        "\xEF\xBB\xBFREM GENRE Rock\r\n"
+        "PERFORMER \"Someone\"\r\n"
+        "FILE \"disc one.flac\" WAVE\r\n"
+        "  TRACK 01 AUDIO\r\n"
+        "    INDEX 00 00:00:00\r\n"
+        "    INDEX 01 00:00:32\r\n"
+        "  TRACK 02 AUDIO\r\n"
+        "    INDEX 00 01:59:70\r\n"
+        "    INDEX 01 02:00:15\r\n"
+        "  TRACK 03 MODE1/2352\r\n"
+        "    INDEX 01 03:00:00\r\n"
+        "FILE /other.wav WAVE\r\n"
+        "  TRACK 04 AUDIO\r\n"
+        "    INDEX 01 00:00:00\r\n"
+        "  TRACK 05 AUDIO\r\n"
+        "    INDEX 01 00:01:15\r\n";
+
+    std::vector<AudioSource> tracks;
+    test("read", true, spek_read_album(path, tracks));
+    test("tracks", (size_t)4, tracks.size());
+    if (tracks.size() == 4) {
+        // The first track has the pregap too, the data track isn't there.
+        test_track(tracks[0], dir + "disc one.flac", 0.0, 120.2);
+        test_track(tracks[1], dir + "disc one.flac", 120.2, 0.0);
+        test_track(tracks[2], "/other.wav", 0.0, 1.2);
+        test_track(tracks[3], "/other.wav", 1.2, 0.0);
+    }
+
+    std::ofstream(path.c_str()) << "FILE a.wav WAVE\nTRACK 01 AUDIO\nINDEX 01 1:2\n";
+    test("bad time", false, spek_read_album(path, tracks));
+    std::ofstream(path.c_str()) << "REM nothing\n";
+    test("no tracks", false, spek_read_album(path, tracks));
+    remove(path.c_str());
+    test("missing", false, spek_read_album(path, tracks));
+    rmdir(dir.c_str());
+}
+
+static void test_playlist()
+{
+    std::string dir = temp_dir();
+    std::string path = dir + "list.m3u8";
+    std::ofstream(path.c_str()) <<
+        "#EXTM3U\r\n"
+        "#EXTINF:123,Someone - Something\r\n"
+        "a.flac\r\n"
+        "/music/b.wav\r\n"
+        "\r\n"
+        "sub/c.mp3\n";
+
+    std::vector<AudioSource> tracks;
+    test("read", true, spek_read_album(path, tracks));
+    test("tracks", (size_t)3, tracks.size());
+    if (tracks.size() == 3) {
+        test_track(tracks[0], dir + "a.flac", 0.0, 0.0);
+        test_track(tracks[1], "/music/b.wav", 0.0, 0.0);
+        test_track(tracks[2], dir + "sub/c.mp3", 0.0, 0.0);
+    }
+    remove(path.c_str());
+    rmdir(dir.c_str());
+}
+
+void test_album()
+{
+    run("album is album", test_is_album);
+    run("album cue", test_cue);
+    run("album playlist", test_playlist);
+}
@@ -0,0 +1,114 @@
+#include <math.h>
+
+#include <vector>
+
+#include "spek-analyzer.h"
+#include "spek-utils.h"
+
+#include "test.h"
+
+// Feed the samples in blocks of uneven sizes and return the named result.
+static double measure(Analyzer& analyzer, const std::vector<float>& samples, const char *name)
+{
+    AnalyzerFormat format = { 44100, 16, samples.size() / 44100.0, 0, 0.0, 0.0, 1 };
+    analyzer.start(format);
+    size_t pos = 0;
+    for (int block = 1; pos < samples.size(); block = block * 3 % 1000 + 7) {
+        int n = spek_min(block, (int)(samples.size() - pos));
+        analyzer.process(&samples[pos], n);
+        pos += n;
+    }
+    analyzer.finish();
+    for (const auto& result : analyzer.get_results()) {
+        if (result.name == name) {
+            return result.value;
+        }
+    }
+    return NAN;
+}
+
+static std::vector<float> sine(double amplitude, double offset, int n)
+{
+    std::vector<float> samples(n);
+    for (int i = 0; i < n; i++) {
+        samples[i] = (float)(offset + amplitude * sin(2.0 * M_PI * 1000.0 * i / 44100.0));
+    }
+    return samples;
+}
+
+static void test_levels()
+{
+    std::vector<float> samples = sine(0.5, 0.0, 44100);
+    PeakAnalyzer peak;
+    test("peak", true, fabs(measure(peak, samples, "peak") - 20.0 * log10(0.5)) < 0.01);
+    RmsAnalyzer rms;
+    test("rms", true, fabs(measure(rms, samples, "rms") - 20.0 * log10(0.5 / sqrt(2.0))) < 0.01);
+    DcOffsetAnalyzer dc;
+    test("no dc offset", true, fabs(measure(dc, samples, "dc_offset")) < 0.01);
+
+    samples = sine(0.25, 0.1, 44100);
+    DcOffsetAnalyzer offset;
+    test("dc offset", true, fabs(measure(offset, samples, "dc_offset") - 10.0) < 0.01);
+
+    std::vector<float> silence(1000);
+    PeakAnalyzer silent;
+    test("silence", true, std::isinf(measure(silent, silence, "peak")));
+}
+
+static void test_clipping()
+{
+    // A sine driven 6 dB over full scale has flat tops twice a cycle.
+    std::vector<float> samples = sine(2.0, 0.0, 44100);
+    for (auto& sample : samples) {
+        sample = fmaxf(-1.0f, fminf(1.0f, sample));
+    }
+    ClipAnalyzer clipped;
+    test("clipped runs", 2000.0, measure(clipped, samples, "clipped_runs"));
+    test("clipped samples", true, measure(clipped, samples, "clipped_samples") > 10000.0);
+
+    ClipAnalyzer clean;
+    test("no clipping", 0.0, measure(clean, sine(0.99, 0.0, 44100), "clipped_samples"));
+}
+
+static void test_channels()
+{
+    // The left channel is quiet, the right one is clipped.
+    std::vector<float> left = sine(0.25, 0.0, 44100);
+    std::vector<float> right = sine(2.0, 0.0, 44100);
+    std::vector<float> samples;
+    for (size_t i = 0; i < left.size(); i++) {
+        samples.push_back(left[i]);
+        samples.push_back(fmaxf(-1.0f, fminf(1.0f, right[i])));
+    }
+    AnalyzerFormat format = { 44100, 16, 1.0, 0, 0.0, 0.0, 2 };
+
+    PeakAnalyzer peak;
+    ClipAnalyzer clipped;
+    for (Analyzer *analyzer : std::vector<Analyzer*>{ &peak, &clipped }) {
+        test("all channels", true, analyzer->wants_all_channels());
+        analyzer->start(format);
+        // Split in the middle of the flat tops.
+        analyzer->process_channels(samples.data(), 1001);
+        analyzer->process_channels(samples.data() + 2 * 1001, left.size() - 1001);
+        analyzer->finish();
+    }
+    test("peak", 0.0, peak.get_results().front().value);
+    test("clipped runs", 2000.0, clipped.get_results()[1].value);
+}
+
+static void test_builtins()
+{
+    for (const auto& name : spek_analyzer_names()) {
+        auto analyzer = spek_analyzer_create(name);
+        test("built-in", true, analyzer && analyzer->get_name() == name);
+    }
+    test("unknown", true, !spek_analyzer_create("unknown"));
+}
+
+void test_analyzer()
+{
+    run("analyzer levels", test_levels);
+    run("analyzer clipping", test_clipping);
+    run("analyzer channels", test_channels);
+    run("analyzer built-ins", test_builtins);
+}
@@ -0,0 +1,145 @@
+#include <math.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "spek-api.h"
+
+#include "test.h"
+
+static const char *SAMPLE = SAMPLES_DIR "/2ch-48000Hz-16bps.flac";
+
+enum
+{
+    BITS = 8,
+    BANDS = (1 << (BITS - 1)) + 1,
+    COLUMNS = 50,
+};
+
+// All the columns of the sample, read in blocks of uneven sizes.
+static std::vector<float> read_all(spek_analysis *analysis)
+{
+    test("fft bits", (int)SPEK_OK, spek_set_fft_bits(analysis, BITS));
+    test("columns", (int)SPEK_OK, spek_set_columns(analysis, COLUMNS));
+    test("start", (int)SPEK_OK, spek_start(analysis));
+    test("started", (int)SPEK_ERROR_INVALID_STATE, spek_set_columns(analysis, COLUMNS));
+
+    std::vector<float> values;
+    std::vector<float> buffer(BANDS * 7);
+    for (int block = 1; ; block = block % 7 + 1) {
+        int columns = spek_read_columns(analysis, buffer.data(), block);
+        if (columns <= 0) {
+            test("end", 0, columns);
+            break;
+        }
+        values.insert(values.end(), buffer.begin(), buffer.begin() + columns * BANDS);
+    }
+
+    spek_stats stats;
+    test("stats", (int)SPEK_OK, spek_get_stats(analysis, &stats));
+    test("bands", (int)BANDS, stats.bands);
+    test("columns done", (int)COLUMNS, stats.columns_done);
+    test("columns read", (int)COLUMNS, stats.columns_read);
+    test("finished", 1, stats.finished);
+    return values;
+}
+
+static void test_file()
+{
+    int status = -1;
+    spek_analysis *analysis = spek_open_file(SAMPLE, 0, &status);
+    test("status", (int)SPEK_OK, status);
+    spek_info info;
+    test("info", (int)SPEK_OK, spek_get_info(analysis, &info));
+    test("channels", 2, info.channels);
+    test("sample rate", 48000, info.sample_rate);
+    test("bad channel", (int)SPEK_ERROR_INVALID_ARGUMENT, spek_set_channel(analysis, 2));
+    std::vector<float> values = read_all(analysis);
+    test("values", (size_t)(COLUMNS * BANDS), values.size());
+    spek_close(analysis);
+}
+
+static void test_memory()
+{
+    std::ifstream stream(SAMPLE, std::ios::binary);
+    std::vector<char> data(
+        (std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>()
+    );
+    spek_analysis *from_memory = spek_open_memory(data.data(), data.size(), 0, NULL);
+    spek_analysis *from_file = spek_open_file(SAMPLE, 0, NULL);
+    test("same columns", true, read_all(from_memory) == read_all(from_file));
+    spek_close(from_memory);
+    spek_close(from_file);
+
+    int status = -1;
+    test("garbage", true, !spek_open_memory("not audio", 9, 0, &status));
+    test("garbage status", (int)SPEK_ERROR_CANNOT_OPEN_FILE, status);
+    test("empty", true, !spek_open_memory(data.data(), 0, 0, &status));
+    test("empty status", (int)SPEK_ERROR_INVALID_ARGUMENT, status);
+}
+
+static void test_levels()
+{
+    spek_analysis *analysis = spek_open_file(SAMPLE, 0, NULL);
+    spek_set_fft_bits(analysis, BITS);
+    spek_set_columns(analysis, COLUMNS);
+    spek_start(analysis);
+    std::vector<float> buffer(BANDS * COLUMNS);
+    std::vector<spek_levels> levels(COLUMNS);
+    test("columns", (int)COLUMNS,
+        spek_read_columns_levels(analysis, buffer.data(), levels.data(), COLUMNS));
+    bool ordered = true;
+    bool loud = false;
+    for (const auto& column : levels) {
+        ordered = ordered && column.min <= column.max && column.rms >= 0.0f &&
+            column.rms <= fmaxf(-column.min, column.max);
+        loud = loud || column.rms > 0.0f;
+    }
+    test("ordered", true, ordered);
+    test("loud", true, loud);
+    test("end", 0, spek_read_columns_levels(analysis, buffer.data(), NULL, COLUMNS));
+    spek_close(analysis);
+}
+
+static void test_cancel()
+{
+    spek_analysis *analysis = spek_open_file(SAMPLE, 0, NULL);
+    spek_start(analysis);
+    std::vector<float> buffer(2048 / 2 + 1);
+    test("first", 1, spek_read_columns(analysis, buffer.data(), 1));
+    spek_cancel(analysis);
+    test("cancelled", -(int)SPEK_ERROR_CANCELLED, spek_read_columns(analysis, buffer.data(), 1));
+    // Closing before all the columns are read doesn't wait for them.
+    spek_close(analysis);
+
+    analysis = spek_open_file(SAMPLE, 0, NULL);
+    spek_start(analysis);
+    spek_close(analysis);
+}
+
+static void test_global()
+{
+    test("version", (int)SPEK_API_VERSION, spek_api_version());
+    spek_global_stats before, after;
+    spek_get_global_stats(&before);
+    int status = -1;
+    test("missing", true, !spek_open_file(SAMPLES_DIR "/missing.flac", 0, &status));
+    test("missing status", (int)SPEK_ERROR_CANNOT_OPEN_FILE, status);
+    test("no stream", true, !spek_open_file(SAMPLE, 1, &status));
+    test("no stream status", (int)SPEK_ERROR_NO_AUDIO, status);
+    spek_get_global_stats(&after);
+    test("failed", before.analyses_failed + 2, after.analyses_failed);
+    test("open", before.analyses_open, after.analyses_open);
+    std::string message = spek_status_string(SPEK_ERROR_CANCELLED);
+    test("message", std::string("Cancelled"), message);
+}
+
+void test_api()
+{
+    run("api file", test_file);
+    run("api memory", test_memory);
+    run("api levels", test_levels);
+    run("api cancel", test_cancel);
+    run("api global stats", test_global);
+}
@@ -1,3 +1,6 @@
+#include <stdio.h>
+
+#include <fstream>
 #include <map>
 
 #include "spek-audio.h"
@@ -48,6 +51,13 @@ static void test_read(AudioFile *file, int samples)
 
     test("samples", samples, samples_read);
 
+    // The samples are all silent, of every channel.
+    const SampleBits& bits = file->get_sample_bits();
+    for (int channel = 0; channel < bits.get_channels(); channel++) {
+        test("effective bits", 0, bits.get_effective_bits(channel));
+        test("sample peak", 0.0, bits.get_peak(channel));
+    }
+
     if (samples > 0) {
         power /= samples_read;
         test("error", 0, len);
@@ -57,6 +67,133 @@ static void test_read(AudioFile *file, int samples)
     }
 }
 
+static void test_probe(const AudioInfo& probed, const FileInfo& info)
+{
+    test("error", info.error, probed.error);
+    test("sample rate", info.sample_rate, probed.sample_rate);
+    test("channels", info.channels, probed.channels);
+}
+
+static void test_streams()
+{
+    Audio audio;
+    auto files = audio.open_streams(SAMPLES_DIR "/2ch-48000Hz-16bps.flac", 0, true);
+    test("files", 1, static_cast<int>(files.size()));
+    test("stream", 0, files[0]->get_stream());
+    test("error", AudioError::OK, files[0]->get_error());
+    test_read(files[0].get(), 48000 / 10);
+
+    files = audio.open_streams(SAMPLES_DIR "/2ch-48000Hz-16bps.flac", 1, true);
+    test("files", 2, static_cast<int>(files.size()));
+    test("error", AudioError::NO_AUDIO, files[0]->get_error());
+    test("stream", 0, files[1]->get_stream());
+
+    files = audio.open_streams(SAMPLES_DIR "/no.file", 0, true);
+    test("files", 1, static_cast<int>(files.size()));
+    test("error", AudioError::CANNOT_OPEN_FILE, files[0]->get_error());
+}
+
+static void test_batch()
+{
+    Audio audio;
+    auto file = audio.open(SAMPLES_DIR "/2ch-48000Hz-16bps.flac", 0);
+    file->start(0, 1024);
+    file->set_batch_size(2048);
+
+    int samples_read = 0;
+    int short_reads = 0;
+    int len;
+    while ((len = file->read()) > 0) {
+        samples_read += len;
+        if (len < 2048) {
+            short_reads++;
+        }
+    }
+    test("samples", 48000 / 10, samples_read);
+    test("short reads", true, short_reads <= 1);
+}
+
+static void test_rewind()
+{
+    Audio audio;
+    auto file = audio.open(SAMPLES_DIR "/2ch-48000Hz-16bps.flac", 0);
+    test_read(file.get(), 48000 / 10);
+    test("rewind", true, file->rewind());
+    file->start(1, 1024);
+    int samples_read = 0;
+    int len;
+    while ((len = file->read()) > 0) {
+        samples_read += len;
+    }
+    test("samples", 48000 / 10, samples_read);
+
+    test("rewind", true, file->rewind());
+    file->start(0, 1024);
+    file->interrupt();
+    test("interrupted", 0, file->read());
+
+    auto files = audio.open_streams(SAMPLES_DIR "/no.file", 0, false);
+    test("rewind", false, files[0]->rewind());
+}
+
+static void test_seek()
+{
+    Audio audio;
+    auto file = audio.open(SAMPLES_DIR "/2ch-44100Hz-16bps.wav", 0);
+    file->start(0, 1024);
+    test("seek", true, file->seek(0.05));
+    int samples_read = 0;
+    int len;
+    while ((len = file->read()) > 0) {
+        samples_read += len;
+    }
+    test("samples", true, samples_read > 0 && samples_read < 44100 / 10);
+}
+
+static void test_sequence()
+{
+    // Written to the current directory, the paths in it are relative to that.
+    Audio audio;
+    std::ofstream("spek-test.m3u") <<
+        "#EXTM3U\n" SAMPLES_DIR "/2ch-48000Hz-16bps.flac\n" SAMPLES_DIR "/2ch-48000Hz-16bps.wv\n";
+    auto file = audio.open("spek-test.m3u", 0);
+    test("error", AudioError::OK, file->get_error());
+    test("sample rate", 48000, file->get_sample_rate());
+    test("duration", 0.2, file->get_duration());
+    test("tracks", (size_t)1, file->get_track_starts().size());
+    test("track start", 0.1, file->get_track_starts().empty() ? 0.0 : file->get_track_starts()[0]);
+    test_read(file.get(), 2 * 48000 / 10);
+    test("rewind", true, file->rewind());
+    file->start(1, 1024);
+    int samples_read = 0;
+    int len;
+    while ((len = file->read()) > 0) {
+        samples_read += len;
+    }
+    test("samples", 2 * 48000 / 10, samples_read);
+    test("probe", 0.2, audio.probe("spek-test.m3u", 0).duration);
+
+    // The tracks of a file are read in one go.
+    std::ofstream("spek-test.cue") <<
+        "FILE \"" SAMPLES_DIR "/2ch-48000Hz-16bps.flac\" WAVE\n"
+        "  TRACK 01 AUDIO\n    INDEX 01 00:00:00\n"
+        "  TRACK 02 AUDIO\n    INDEX 01 00:00:03\n";
+    file = audio.open("spek-test.cue", 0);
+    test("error", AudioError::OK, file->get_error());
+    test("duration", 0.1, file->get_duration());
+    test("track start", 0.04, file->get_track_starts().empty() ? 0.0 : file->get_track_starts()[0]);
+    test_read(file.get(), 48000 / 10);
+
+    std::ofstream("spek-test.m3u") <<
+        SAMPLES_DIR "/2ch-48000Hz-16bps.flac\n" SAMPLES_DIR "/2ch-44100Hz-16bps.wav\n";
+    test("mixed", AudioError::MIXED_FORMATS, audio.open("spek-test.m3u", 0)->get_error());
+    std::ofstream("spek-test.m3u") << SAMPLES_DIR "/no.file\n";
+    test("missing", AudioError::CANNOT_OPEN_FILE, audio.open("spek-test.m3u", 0)->get_error());
+    remove("spek-test.m3u");
+    remove("spek-test.cue");
+    test("no list", AudioError::CANNOT_OPEN_FILE, audio.open("spek-test.m3u", 0)->get_error());
+}
+
 void test_audio()
 {
     const double MP3_T = 5.0 * 1152 / 44100; // 5 frames * duration per mp3 frame
@@ -108,6 +245,12 @@ void test_audio()
     };
 
     Audio audio;
+    std::vector<std::string> names;
+    for (const auto& item : files) {
+        names.push_back(SAMPLES_DIR "/" + item.first);
+    }
+    auto probed = audio.probe(names, 0, 4);
+    int i = 0;
     for (const auto& item : files) {
         auto name = item.first;
         auto info = item.second;
@@ -120,5 +263,15 @@ void test_audio()
             "audio read: " + name,
             [&] () { test_read(file.get(), info.samples); }
         );
+        run(
+            "audio probe: " + name,
+            [&] () { test_probe(probed[i++], info); }
+        );
     }
+
+    run("audio streams", test_streams);
+    run("audio batch", test_batch);
+    run("audio rewind", test_rewind);
+    run("audio seek", test_seek);
+    run("audio sequence", test_sequence);
 }
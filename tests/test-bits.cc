@@ -0,0 +1,105 @@
+#include <stdint.h>
+
+#include <vector>
+
+#include "spek-bits.h"
+
+#include "test.h"
+
+static void test_padded()
+{
+    // 16-bit stereo samples padded to 24 bits and stored in 32, as FFmpeg decodes them.
+    std::vector<int32_t> samples;
+    for (int i = 0; i < 1001; i++) {
+        samples.push_back((i * 37 - 18000) * 65536);
+        samples.push_back(-i * 11 * 65536);
+    }
+    SampleBits bits;
+    bits.reset(2, 32);
+    bits.add(samples.data(), samples.size(), 0, 2);
+    test("bits", 32, bits.get_bits());
+    test("channels", 2, bits.get_channels());
+    test("left", 16, bits.get_effective_bits(0));
+    test("right", 16, bits.get_effective_bits(1));
+    test("left peak", 19000.0 / 32768.0, bits.get_peak(0));
+    test("right peak", 11000.0 / 32768.0, bits.get_peak(1));
+}
+
+static void test_planar()
+{
+    // Each plane on its own, with an odd number of samples left over for the scalar loop.
+    std::vector<int16_t> left, right;
+    for (int i = 0; i < 77; i++) {
+        left.push_back(i * 4);
+        right.push_back(-i);
+    }
+    SampleBits bits;
+    bits.reset(2, 16);
+    bits.add(left.data(), left.size(), 0, 1);
+    bits.add(right.data(), right.size(), 1, 1);
+    test("left", 14, bits.get_effective_bits(0));
+    test("right", 16, bits.get_effective_bits(1));
+    test("left peak", 304.0 / 32768.0, bits.get_peak(0));
+    test("right peak", 76.0 / 32768.0, bits.get_peak(1));
+}
+
+static void test_channels()
+{
+    // Three channels don't line up with the lanes.
+    std::vector<int16_t> samples;
+    for (int i = 0; i < 50; i++) {
+        samples.push_back(INT16_MIN);
+        samples.push_back(i << 8);
+        samples.push_back(7);
+    }
+    SampleBits bits;
+    bits.reset(3, 16);
+    bits.add(samples.data(), samples.size(), 0, 3);
+    test("constant", 0, bits.get_effective_bits(0));
+    test("high bits", 8, bits.get_effective_bits(1));
+    test("dc", 0, bits.get_effective_bits(2));
+    test("full scale", 1.0, bits.get_peak(0));
+}
+
+static void test_empty()
+{
+    SampleBits bits;
+    test("bits", 0, bits.get_bits());
+    test("channels", 0, bits.get_channels());
+    bits.reset(1, 16);
+    test("effective bits", 0, bits.get_effective_bits(0));
+    test("peak", 0.0, bits.get_peak(0));
+}
+
+static void test_merge()
+{
+    // Two tracks of an album, one quiet and one using the low bits.
+    std::vector<int16_t> quiet = { 256, -512, 1024, 0 };
+    std::vector<int16_t> loud = { 3, -20000, 7, 1 };
+    SampleBits first, second, merged;
+    first.reset(1, 16);
+    first.add(quiet.data(), quiet.size(), 0, 1);
+    second.reset(1, 16);
+    second.add(loud.data(), loud.size(), 0, 1);
+    merged.merge(first);
+    test("first", 8, merged.get_effective_bits(0));
+    merged.merge(second);
+    test("both", 16, merged.get_effective_bits(0));
+    test("peak", 20000.0 / 32768.0, merged.get_peak(0));
+    merged.merge(SampleBits());
+    test("empty", 16, merged.get_bits());
+
+    SampleBits wider;
+    wider.reset(1, 32);
+    merged.merge(wider);
+    test("mismatched", 0, merged.get_bits());
+}
+
+void test_bits()
+{
+    run("bits padded", test_padded);
+    run("bits planar", test_planar);
+    run("bits channels", test_channels);
+    run("bits empty", test_empty);
+    run("bits merge", test_merge);
+}
@@ -0,0 +1,109 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <fstream>
+
+#include "spek-columns.h"
+#include "spek-report.h"
+
+#include "test.h"
+
+static void test_precision(ColumnPrecision precision, size_t bytes_per_value, float tolerance)
+{
+    const int samples = 3;
+    const int bands = 200;
+    ColumnStore store;
+    store.create(samples, bands, precision);
+    test("samples", samples, store.get_samples());
+    test("bands", bands, store.get_bands());
+    test("bytes", samples * bands * bytes_per_value, store.get_bytes());
+
+    std::vector<float> values(bands);
+    for (int sample = 0; sample < samples; sample++) {
+        for (int i = 0; i < bands; i++) {
+            values[i] = ColumnStore::MIN_DB + (i + sample) * 0.79f;
+        }
+        store.set(sample, values.data());
+    }
+
+    std::vector<float> decoded(bands);
+    float error = 0.0f;
+    for (int sample = 0; sample < samples; sample++) {
+        store.get(sample, decoded.data());
+        for (int i = 0; i < bands; i++) {
+            float expected = ColumnStore::MIN_DB + (i + sample) * 0.79f;
+            error = fmaxf(error, fabsf(fminf(expected, ColumnStore::MAX_DB) - decoded[i]));
+        }
+    }
+    test("error", true, error <= tolerance);
+
+    // Silence and anything out of range are clamped.
+    values[0] = -INFINITY;
+    values[1] = ColumnStore::MAX_DB + 20.0f;
+    store.set(0, values.data());
+    store.get(0, decoded.data());
+    if (precision == ColumnPrecision::FLOAT) {
+        test("silence", true, std::isinf(decoded[0]));
+    } else {
+        test("silence", (double)ColumnStore::MIN_DB, (double)decoded[0]);
+        test("overload", (double)ColumnStore::MAX_DB, (double)decoded[1]);
+    }
+}
+
+static void test_clear()
+{
+    ColumnStore store;
+    test("empty", true, store.empty());
+    store.create(10, 10, ColumnPrecision::BITS_8);
+    test("empty", false, store.empty());
+    store.clear();
+    test("empty", true, store.empty());
+    test("bytes", (size_t)0, store.get_bytes());
+}
+
+// The columns recorded in a pass made for something else are those of the C API.
+static void test_columns_recorder()
+{
+    const std::string path = SAMPLES_DIR "/2ch-48000Hz-16bps.flac";
+    const int bits = 8;
+    const int columns = 10;
+    const int bands = (1 << (bits - 1)) + 1;
+    ColumnsRecorder recorder(bits, columns);
+    test("analysed", true, spek_report_analyse(path, {}, &recorder, NULL));
+    test("bands", bands, recorder.get_bands());
+    test("columns", columns, recorder.get_columns());
+    test("values", (size_t)(columns * bands), recorder.get_values().size());
+
+    char dir[] = "/tmp/spek-test-XXXXXX";
+    test("temp dir", true, mkdtemp(dir) != NULL);
+    std::string columns_path = std::string(dir) + "/columns.f32";
+    test("written", true, spek_report_columns(path, 0, bits, columns, columns_path));
+    std::ifstream in(columns_path.c_str(), std::ios::binary);
+    std::vector<float> expected((size_t)columns * (bands + 3));
+    in.read((char *)expected.data(), expected.size() * sizeof(float));
+    test("read", true, !!in);
+    std::vector<float> values = recorder.get_values();
+    values.insert(values.end(), recorder.get_levels().begin(), recorder.get_levels().end());
+    test("same", true, values == expected);
+
+    std::string saved_path = std::string(dir) + "/saved.f32";
+    test("save", true, recorder.save(saved_path));
+    std::ifstream saved(saved_path.c_str(), std::ios::binary);
+    std::vector<float> read(expected.size() + 1);
+    saved.read((char *)read.data(), read.size() * sizeof(float));
+    test("saved size", (std::streamsize)(expected.size() * sizeof(float)), saved.gcount());
+    read.pop_back();
+    test("saved", true, read == expected);
+
+    std::string command = std::string("rm -rf ") + dir;
+    test("cleanup", 0, system(command.c_str()));
+}
+
+void test_columns()
+{
+    run("columns float", [] () { test_precision(ColumnPrecision::FLOAT, 4, 0.0f); });
+    run("columns 16 bits", [] () { test_precision(ColumnPrecision::BITS_16, 2, 0.002f); });
+    run("columns 8 bits", [] () { test_precision(ColumnPrecision::BITS_8, 1, 0.32f); });
+    run("columns clear", test_clear);
+    run("columns recorder", test_columns_recorder);
+}
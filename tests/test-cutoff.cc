@@ -0,0 +1,117 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "spek-cutoff.h"
+
+#include "test.h"
+
+static const int BANDS = 2049;
+static const double NYQUIST = 22050.0;
+
+// Columns of a spectrum sloping down with the frequency, with some noise, and nothing above
+// `cutoff` if it's set, or only up to `gap` Hz above it if that's set too.
+static void analyse(
+    CutoffAnalyzer& analyzer, int columns, double cutoff, double level = -40.0, double gap = 0.0)
+{
+    AnalyzerFormat format = { 44100, 16, 60.0, BANDS, 0.0, NYQUIST, 1 };
+    analyzer.start(format);
+    std::vector<float> values(BANDS);
+    srand(1);
+    for (int sample = 0; sample < columns; sample++) {
+        for (int i = 0; i < BANDS; i++) {
+            double freq = i * NYQUIST / (BANDS - 1);
+            double noise = 6.0 * rand() / RAND_MAX - 3.0;
+            bool cut = cutoff && freq >= cutoff && (!gap || freq < cutoff + gap);
+            values[i] = cut ? -INFINITY : level - freq / 1000.0 + noise;
+        }
+        analyzer.process_column(sample, values.data());
+    }
+    analyzer.finish();
+}
+
+static void test_transcoded()
+{
+    CutoffAnalyzer analyzer;
+    analyse(analyzer, 100, 16000.0);
+    test("cutoff", true, fabs(analyzer.get_cutoff() - 16000.0) < 50.0);
+    test("confidence", true, analyzer.get_confidence() > 0.9);
+    test("bit rate", 128, analyzer.get_bit_rate());
+    test("columns", (size_t)100, analyzer.get_cutoffs().size());
+    test("verdict", std::string("likely transcoded from MP3/AAC at ~128 kbps"),
+        analyzer.get_verdict());
+
+    CutoffAnalyzer high;
+    analyse(high, 100, 19800.0);
+    test("high bit rate", 256, high.get_bit_rate());
+}
+
+static void test_high()
+{
+    // Up there an encoder's lowpass looks like a shelf.
+    CutoffAnalyzer shelf;
+    analyse(shelf, 100, 20800.0);
+    test("shelf", 320, shelf.get_bit_rate());
+
+    // The level coming back above the drop isn't an encoder's.
+    CutoffAnalyzer notch;
+    analyse(notch, 100, 20400.0, -40.0, 800.0);
+    test("notch cutoff", true, fabs(notch.get_cutoff() - 20400.0) < 50.0);
+    test("notch", 0, notch.get_bit_rate());
+    test("notch verdict", std::string("cutoff at 20.4 kHz, source unknown"),
+        notch.get_verdict());
+
+    // Nor is a lowpass in only some of the columns.
+    CutoffAnalyzer some;
+    AnalyzerFormat format = { 44100, 16, 60.0, BANDS, 0.0, NYQUIST, 1 };
+    some.start(format);
+    std::vector<float> cut(BANDS), full(BANDS);
+    for (int i = 0; i < BANDS; i++) {
+        double freq = i * NYQUIST / (BANDS - 1);
+        full[i] = (float)(-40.0 - freq / 1000.0);
+        cut[i] = freq < 20800.0 ? full[i] : -INFINITY;
+    }
+    for (int sample = 0; sample < 100; sample++) {
+        some.process_column(sample, sample % 4 ? cut.data() : full.data());
+    }
+    some.finish();
+    test("some columns", 0, some.get_bit_rate());
+}
+
+static void test_lossless()
+{
+    CutoffAnalyzer analyzer;
+    analyse(analyzer, 100, 0.0);
+    test("no cutoff", 0.0, analyzer.get_cutoff());
+    test("no bit rate", 0, analyzer.get_bit_rate());
+    test("verdict", std::string("no lossy cutoff"), analyzer.get_verdict());
+}
+
+static void test_silence()
+{
+    // Silent columns don't count against the ones with a cutoff.
+    CutoffAnalyzer analyzer;
+    AnalyzerFormat format = { 44100, 16, 60.0, BANDS, 0.0, NYQUIST, 1 };
+    analyzer.start(format);
+    std::vector<float> silence(BANDS, -INFINITY);
+    std::vector<float> values(BANDS);
+    for (int i = 0; i < BANDS; i++) {
+        values[i] = i * NYQUIST / (BANDS - 1) < 17000.0 ? -50.0f : -150.0f;
+    }
+    for (int sample = 0; sample < 20; sample++) {
+        analyzer.process_column(sample, sample % 2 ? values.data() : silence.data());
+    }
+    analyzer.finish();
+    test("quiet columns", true, std::isnan(analyzer.get_cutoffs()[0]));
+    test("confidence", 1.0, analyzer.get_confidence());
+    test("bit rate", 128, analyzer.get_bit_rate());
+}
+
+void test_cutoff()
+{
+    run("cutoff transcoded", test_transcoded);
+    run("cutoff high", test_high);
+    run("cutoff lossless", test_lossless);
+    run("cutoff silence", test_silence);
+}
@@ -0,0 +1,126 @@
+#include <math.h>
+
+#include <vector>
+
+#include "spek-dsp.h"
+
+#include "test.h"
+
+static void test_lowpass()
+{
+    std::vector<float> coefs = spek_lowpass(65, 0.1);
+    double sum = 0.0;
+    bool symmetric = true;
+    for (size_t k = 0; k < coefs.size(); k++) {
+        sum += coefs[k];
+        symmetric = symmetric && coefs[k] == coefs[coefs.size() - 1 - k];
+    }
+    test("unity gain", true, fabs(sum - 1.0) < 1e-6);
+    test("symmetric", true, symmetric);
+}
+
+// Decimate a tone at `freq` and return the magnitude of the output, or -1 if it isn't steady.
+static double decimate_tone(int factor, double center, double freq, int *outputs)
+{
+    const int n = 64 * 1024;
+    std::vector<float> in(n);
+    for (int i = 0; i < n; i++) {
+        in[i] = (float)cos(2.0 * M_PI * freq * i);
+    }
+
+    ComplexDecimator decimator(factor, center);
+    std::vector<float> re(n / factor + decimator.get_delay() + 2);
+    std::vector<float> im(re.size());
+    int count = decimator.process(in.data(), n, re.data(), im.data());
+    count += decimator.flush(&re[count], &im[count]);
+    *outputs = count;
+
+    // Skip the edges where the filter runs into the silence around the tone.
+    double min = INFINITY, max = 0.0;
+    for (int i = 2 * decimator.get_delay(); i < count - 2 * decimator.get_delay(); i++) {
+        double magnitude = hypot(re[i], im[i]);
+        min = fmin(min, magnitude);
+        max = fmax(max, magnitude);
+    }
+    return max - min < 1e-3 ? max : -1.0;
+}
+
+static void test_decimator()
+{
+    int outputs;
+    // A real tone has half of its amplitude at the positive frequency.
+    test("center", true, fabs(decimate_tone(8, 0.3, 0.3, &outputs) - 0.5) < 1e-3);
+    test("outputs", 64 * 1024 / 8, outputs);
+    test("pass band", true, fabs(decimate_tone(8, 0.3, 0.3 + 0.02, &outputs) - 0.5) < 1e-3);
+    test("below", true, fabs(decimate_tone(8, 0.3, 0.3 - 0.02, &outputs) - 0.5) < 1e-3);
+    test("stop band", true, fabs(decimate_tone(8, 0.3, 0.3 + 0.1, &outputs)) < 1e-4);
+    test("mirror", true, fabs(decimate_tone(16, 0.05, 0.05, &outputs) - 0.5) < 1e-3);
+}
+
+// The amplitude of a tone at `freq` once decimated.
+static double decimate_real_tone(int factor, double freq)
+{
+    const int n = 64 * 1024;
+    std::vector<float> in(n);
+    for (int i = 0; i < n; i++) {
+        in[i] = (float)sin(2.0 * M_PI * freq * i);
+    }
+
+    Decimator decimator(factor);
+    std::vector<float> out(n / factor + decimator.get_delay() + 2);
+    int count = decimator.process(in.data(), n, out.data());
+    count += decimator.flush(&out[count]);
+    test("outputs", n / factor, count);
+
+    // From the power over the middle, where the filter is fully inside the tone.
+    double power = 0.0;
+    int first = 2 * decimator.get_delay();
+    int last = count - 2 * decimator.get_delay();
+    for (int i = first; i < last; i++) {
+        power += out[i] * out[i];
+    }
+    return sqrt(2.0 * power / (last - first));
+}
+
+static void test_real_decimator()
+{
+    // Well within the new band, 0.1 of the output rate.
+    test("pass band", true, fabs(decimate_real_tone(4, 0.025) - 1.0) < 2e-3);
+    test("pass band", true, fabs(decimate_real_tone(8, 0.0125) - 1.0) < 2e-3);
+    // Above the new Nyquist frequency, it would fold back to 0.4 of the output rate.
+    test("stop band", true, decimate_real_tone(4, 0.15) < 1e-4);
+    test("stop band", true, decimate_real_tone(8, 0.075) < 1e-4);
+}
+
+static void test_interpolator()
+{
+    // Sampled half-way between its peaks, the tone never shows more than 0.707 in the samples.
+    const int n = 1000;
+    std::vector<float> in(2 * n);
+    for (int i = 0; i < n; i++) {
+        in[2 * i] = (float)sin(2.0 * M_PI * 0.25 * i + M_PI / 4.0);
+        in[2 * i + 1] = 0.0f;
+    }
+    Interpolator interpolator(4);
+    std::vector<float> out(4 * n);
+    interpolator.process(in.data(), n, 2, out.data());
+    float peak = 0.0f;
+    float middle = 0.0f;
+    // Past the start of the tone, once the filter is full.
+    for (int i = 8 * interpolator.get_delay(); i < 4 * n; i++) {
+        peak = fmaxf(peak, fabsf(out[i]));
+    }
+    for (int i = 4 * n / 2; i < 4 * n / 2 + 4; i++) {
+        middle = fmaxf(middle, fabsf(out[i]));
+    }
+    test("true peak", true, fabs(peak - 1.0) < 0.02);
+    test("between", true, middle > 0.95);
+}
+
+void test_dsp()
+{
+    run("lowpass", test_lowpass);
+    run("complex decimator", test_decimator);
+    run("real decimator", test_real_decimator);
+    run("interpolator", test_interpolator);
+}
@@ -72,8 +72,37 @@ static void test_sine()
     }
 }
 
+static void test_complex()
+{
+    FFT fft;
+    for (int nbits = FFT_BITS_MIN; nbits <= FFT_BITS_MAX; ++nbits) {
+        auto plan = fft.create_complex(nbits);
+        int n = plan->get_input_size();
+        test("complex", true, plan->is_complex());
+        test("output size", n / 2 + 1, plan->get_output_size());
+        // The bands go from -n/4 to n/4.
+        for (int k = -n / 4; k <= n / 4; k += n / 8) {
+            for (int i = 0; i < n; ++i) {
+                double phase = k * i * 2.0 * M_PI / n;
+                plan->set_input(i, 0.5 * cos(phase), 0.5 * sin(phase));
+            }
+            plan->execute();
+            test("exp", -602, static_cast<int>(plan->get_output(k + n / 4) * 100));
+            bool silence = true;
+            for (int i = 0; i < plan->get_output_size(); ++i) {
+                if (i != k + n / 4 && plan->get_output(i) > -150.0f) {
+                    silence = false;
+                    break;
+                }
+            }
+            test("silence", true, silence);
+        }
+    }
+}
+
 void test_fft()
 {
     run("fft const", test_const);
     run("fft sine", test_sine);
+    run("fft complex", test_complex);
 }
@@ -0,0 +1,99 @@
+#include <math.h>
+
+#include <vector>
+
+#include "spek-loudness.h"
+#include "spek-utils.h"
+
+#include "test.h"
+
+// A sine of `amplitude` in all the `channels`, `seconds` long at 48 kHz.
+static std::vector<float> sine(
+    double amplitude, double freq, double phase, int channels, double seconds
+)
+{
+    int n = (int)(seconds * 48000);
+    std::vector<float> samples((size_t)n * channels);
+    for (int i = 0; i < n; i++) {
+        float value = (float)(amplitude * sin(2.0 * M_PI * freq * i / 48000.0 + phase));
+        for (int c = 0; c < channels; c++) {
+            samples[(size_t)i * channels + c] = value;
+        }
+    }
+    return samples;
+}
+
+// Feed the frames in blocks of uneven sizes.
+static void measure(LoudnessAnalyzer& analyzer, const std::vector<float>& samples, int channels)
+{
+    int frames = samples.size() / channels;
+    AnalyzerFormat format = { 48000, 16, frames / 48000.0, 0, 0.0, 0.0, channels };
+    analyzer.start(format);
+    int pos = 0;
+    for (int block = 1; pos < frames; block = block * 3 % 1000 + 7) {
+        int n = spek_min(block, frames - pos);
+        analyzer.process_channels(&samples[(size_t)pos * channels], n);
+        pos += n;
+    }
+    analyzer.finish();
+}
+
+static void test_integrated()
+{
+    // The reference of BS.1770: a 997 Hz sine at 0 dBFS in one channel is -3.01 LUFS.
+    LoudnessAnalyzer mono;
+    measure(mono, sine(1.0, 997.0, 0.0, 1, 5.0), 1);
+    test("mono", true, fabs(mono.get_integrated() - -3.01) < 0.1);
+
+    // Two channels add up their power.
+    LoudnessAnalyzer stereo;
+    measure(stereo, sine(1.0, 997.0, 0.0, 2, 5.0), 2);
+    test("stereo", true, fabs(stereo.get_integrated() - 0.0) < 0.1);
+
+    // The LFE doesn't count, the surround channels count more.
+    LoudnessAnalyzer surround;
+    measure(surround, sine(1.0, 997.0, 0.0, 6, 5.0), 6);
+    double expected = mono.get_integrated() + 10.0 * log10(3 + 2 * 1.41);
+    test("5.1", true, fabs(surround.get_integrated() - expected) < 0.01);
+
+    LoudnessAnalyzer silent;
+    measure(silent, std::vector<float>(48000 * 2), 1);
+    test("silence", true, std::isinf(silent.get_integrated()));
+    test("silent summary", true, silent.get_summary().empty());
+}
+
+static void test_range()
+{
+    // 10 s at -20 dB then 10 s at -30 dB, the range is about the difference.
+    std::vector<float> samples = sine(0.1, 997.0, 0.0, 1, 10.0);
+    std::vector<float> quiet = sine(0.1 / sqrt(10.0), 997.0, 0.0, 1, 10.0);
+    samples.insert(samples.end(), quiet.begin(), quiet.end());
+    LoudnessAnalyzer analyzer;
+    measure(analyzer, samples, 1);
+    test("range", true, fabs(analyzer.get_range() - 10.0) < 1.0);
+
+    LoudnessAnalyzer steady;
+    measure(steady, sine(0.1, 997.0, 0.0, 1, 10.0), 1);
+    test("steady", true, steady.get_range() < 0.1);
+}
+
+static void test_true_peak()
+{
+    // At a quarter of the rate with a 45° phase the samples miss the peaks by 3 dB.
+    std::vector<float> samples = sine(1.0, 12000.0, M_PI / 4.0, 1, 1.0);
+    float sample_peak = 0.0f;
+    for (float value : samples) {
+        sample_peak = fmaxf(sample_peak, fabsf(value));
+    }
+    test("sample peak", true, fabs(sample_peak - sqrt(0.5)) < 1e-3);
+    LoudnessAnalyzer analyzer;
+    measure(analyzer, samples, 1);
+    test("true peak", true, fabs(analyzer.get_true_peak() - 0.0) < 0.5);
+}
+
+void test_loudness()
+{
+    run("loudness integrated", test_integrated);
+    run("loudness range", test_range);
+    run("loudness true peak", test_true_peak);
+}
@@ -0,0 +1,65 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "spek-palette.h"
+
+#include "test.h"
+
+// The same colour as the palette computes for the value, within a step of the table.
+static int max_error(
+    enum palette palette, int lrange, int urange, const std::vector<float>& values)
+{
+    ColorMap map(palette, lrange, urange);
+    int n = values.size();
+    std::vector<uint8_t> pixels(3 * n);
+    map.apply(values.data(), n, pixels.data());
+
+    int error = 0;
+    for (int i = 0; i < n; i++) {
+        double value = fmin(urange, fmax(lrange, values[i]));
+        uint32_t color = spek_palette(palette, (value - lrange) / (urange - lrange));
+        // The last value is at the top.
+        const uint8_t *pixel = &pixels[3 * (n - i - 1)];
+        error = std::max(error, abs((int)(color >> 16) - pixel[0]));
+        error = std::max(error, abs((int)((color >> 8) & 0xFF) - pixel[1]));
+        error = std::max(error, abs((int)(color & 0xFF) - pixel[2]));
+    }
+    return error;
+}
+
+static void test_colors()
+{
+    std::vector<float> values;
+    for (int i = 0; i < 1000; i++) {
+        values.push_back(-150.0f + i * 0.163f);
+    }
+    for (int palette = 0; palette < PALETTE_COUNT; palette++) {
+        test("levels", true, max_error((enum palette)palette, -120, 0, values) <= 1);
+        test("narrow range", true, max_error((enum palette)palette, -50, -30, values) <= 1);
+    }
+}
+
+static void test_limits()
+{
+    ColorMap map(PALETTE_MONO, -120, 0);
+    float values[] = { -INFINITY, NAN, -200.0f, 10.0f, INFINITY };
+    uint8_t pixels[3 * 5];
+    map.apply(values, 5, pixels);
+    test("infinity", 255, (int)pixels[0]);
+    test("overload", 255, (int)pixels[3]);
+    test("underload", 0, (int)pixels[6]);
+    test("nan", 0, (int)pixels[9]);
+    test("silence", 0, (int)pixels[12]);
+
+    ColorMap other(PALETTE_MONO, -120, 0);
+    test("unique id", true, map.get_id() != other.get_id());
+}
+
+void test_palette()
+{
+    run("palette colours", test_colors);
+    run("palette limits", test_limits);
+}
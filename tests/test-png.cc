@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <zlib.h>
+
+#include "spek-png.h"
+
+#include "test.h"
+
+static uint32_t get_uint32(const uint8_t *data)
+{
+    return (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+static std::vector<uint8_t> read_file(const char *file_name)
+{
+    std::vector<uint8_t> data;
+    FILE *file = fopen(file_name, "rb");
+    if (!file) {
+        return data;
+    }
+    uint8_t buffer[4096];
+    size_t len;
+    while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + len);
+    }
+    fclose(file);
+    return data;
+}
+
+static void test_image(int width, int height)
+{
+    std::vector<uint8_t> pixels(3 * width * height);
+    srand(width * height);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = i % 7 ? rand() % 256 : 0;
+    }
+
+    char file_name[] = "/tmp/spek-test-XXXXXX";
+    int fd = mkstemp(file_name);
+    test("temp file", true, fd >= 0);
+    close(fd);
+
+    PngWriter writer;
+    test("open", true, writer.open(file_name, width, height));
+    for (int y = 0; y < height; y++) {
+        test("write row", true, writer.write_row(&pixels[3 * width * y]));
+    }
+    test("close", true, writer.close());
+
+    std::vector<uint8_t> data = read_file(file_name);
+    remove(file_name);
+    test("signature", true, data.size() > 8 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G');
+
+    // Walk the chunks, checking the CRCs and collecting the compressed data.
+    std::vector<uint8_t> compressed;
+    bool crc_ok = true;
+    bool end = false;
+    size_t pos = 8;
+    while (pos + 12 <= data.size() && !end) {
+        uint32_t len = get_uint32(&data[pos]);
+        const uint8_t *type = &data[pos + 4];
+        const uint8_t *chunk = &data[pos + 8];
+        if (crc32(0, type, len + 4) != get_uint32(chunk + len)) {
+            crc_ok = false;
+        }
+        if (!memcmp(type, "IHDR", 4)) {
+            test("width", width, (int)get_uint32(chunk));
+            test("height", height, (int)get_uint32(chunk + 4));
+        } else if (!memcmp(type, "IDAT", 4)) {
+            compressed.insert(compressed.end(), chunk, chunk + len);
+        } else if (!memcmp(type, "IEND", 4)) {
+            end = true;
+        }
+        pos += len + 12;
+    }
+    test("crc", true, crc_ok);
+    test("end", true, end && pos == data.size());
+
+    size_t stride = 1 + 3 * width;
+    std::vector<uint8_t> raw(stride * height);
+    uLongf raw_len = raw.size();
+    test("inflate", Z_OK, uncompress(raw.data(), &raw_len, compressed.data(), compressed.size()));
+    test("size", (int)raw.size(), (int)raw_len);
+
+    // Undo the Sub filter.
+    bool same = true;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = &raw[stride * y];
+        for (int i = 0; i < 3 * width; i++) {
+            uint8_t value = row[1 + i] + (i >= 3 ? row[1 + i - 3] : 0);
+            row[1 + i] = value;
+            if (value != pixels[3 * width * y + i]) {
+                same = false;
+            }
+        }
+    }
+    test("pixels", true, same);
+}
+
+void test_png()
+{
+    run("png tiny", [] () { test_image(1, 1); });
+    run("png small", [] () { test_image(7, 5); });
+    run("png large", [] () { test_image(1500, 200); });
+}
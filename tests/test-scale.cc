@@ -0,0 +1,57 @@
+#include <math.h>
+
+#include <vector>
+
+#include "spek-scale.h"
+
+#include "test.h"
+
+static void test_position()
+{
+    test("linear", 0.25, spek_scale_position(SCALE_LINEAR, 5000.0, 0.0, 20000.0));
+    test("log", 0.5, spek_scale_position(SCALE_LOG, 200.0, 20.0, 2000.0));
+    test("log freq", true, fabs(spek_scale_freq(SCALE_LOG, 0.5, 20.0, 2000.0) - 200.0) < 1e-9);
+    test("cqt freq", 20000.0, spek_scale_freq(SCALE_CQT, 1.0, 20.0, 20000.0));
+}
+
+static void test_kernel(enum frequency_scale scale)
+{
+    const int bands = 1025;
+    const int rows = 300;
+    ScaleKernel kernel;
+    kernel.create(scale, bands, 0.0, 22050.0, rows, 20.0, 22050.0);
+    test("rows", rows, kernel.get_rows());
+
+    // A flat spectrum stays flat.
+    std::vector<float> spectrum(bands, -30.0f);
+    std::vector<float> values(rows);
+    kernel.apply(spectrum.data(), values.data());
+    bool flat = true;
+    for (int row = 0; row < rows; row++) {
+        flat = flat && fabsf(values[row] + 30.0f) < 1e-3f;
+    }
+    test("flat", true, flat);
+
+    // A single band at 1 kHz shows up in the row of 1 kHz.
+    spectrum.assign(bands, -INFINITY);
+    int band = (int)round(1000.0 / (22050.0 / (bands - 1)));
+    spectrum[band] = 0.0f;
+    kernel.apply(spectrum.data(), values.data());
+    int peak = 0;
+    for (int row = 1; row < rows; row++) {
+        if (values[row] > values[peak]) {
+            peak = row;
+        }
+    }
+    double freq = band * 22050.0 / (bands - 1);
+    int expected = (int)(spek_scale_position(scale, freq, 20.0, 22050.0) * rows);
+    test("peak", true, abs(peak - expected) <= 1);
+    test("silence", true, std::isinf(values[0]) && std::isinf(values[rows - 1]));
+}
+
+void test_scale()
+{
+    run("scale position", test_position);
+    run("scale log", [] () { test_kernel(SCALE_LOG); });
+    run("scale cqt", [] () { test_kernel(SCALE_CQT); });
+}
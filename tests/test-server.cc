@@ -0,0 +1,230 @@
+#ifndef OS_WIN
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spek-server.h"
+
+#include "test.h"
+
+#ifndef OS_WIN
+
+static const std::string SAMPLE = SAMPLES_DIR "/2ch-48000Hz-16bps.flac";
+
+enum
+{
+    BLOCKING_WIDTH = 200, // The fake renderer waits to be cancelled for this width.
+};
+
+static std::mutex rendered_mutex;
+static std::vector<int> rendered; // The widths, in the order the images were made.
+
+static bool fake_render(
+    const spek_request *request, const std::string& out_path, const std::atomic<bool> *cancelled)
+{
+    while (request->width == BLOCKING_WIDTH && !*cancelled) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (*cancelled) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(rendered_mutex);
+        rendered.push_back(request->width);
+    }
+    FILE *file = fopen(out_path.c_str(), "wb");
+    fputs("png", file);
+    fclose(file);
+    return true;
+}
+
+// A local client sending lines and reading them back one at a time.
+struct Client
+{
+    explicit Client(const std::string& socket_path)
+    {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, socket_path.c_str());
+        this->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        connect(this->fd, (struct sockaddr *)&address, sizeof(address));
+    }
+    ~Client() { close(this->fd); }
+
+    void send(const std::string& line)
+    {
+        std::string data = line + "\n";
+        ssize_t ret = write(this->fd, data.data(), data.size());
+        (void)ret;
+    }
+
+    std::string receive()
+    {
+        size_t end;
+        while ((end = this->input.find('\n')) == std::string::npos) {
+            char buffer[256];
+            ssize_t len = read(this->fd, buffer, sizeof(buffer));
+            if (len <= 0) {
+                return std::string();
+            }
+            this->input.append(buffer, len);
+        }
+        std::string line = this->input.substr(0, end);
+        this->input.erase(0, end + 1);
+        return line;
+    }
+
+    int fd;
+    std::string input;
+};
+
+// The path in an "ok" response.
+static std::string result_path(const std::string& response)
+{
+    size_t start = response.find('\t', 3) + 1;
+    return response.substr(start, response.rfind('\t') - start);
+}
+
+static bool starts_with(const std::string& s, const std::string& prefix)
+{
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+static void test_requests()
+{
+    char dir[] = "/tmp/spek-test-XXXXXX";
+    test("temp dir", true, mkdtemp(dir) != NULL);
+    std::string socket_path = std::string(dir) + "/socket";
+    std::string error;
+    spek_server *server = spek_server_open(socket_path, dir, 1, fake_render, &error);
+    test("open", std::string(), error);
+    struct stat socket_st;
+    test("socket", 0, stat(socket_path.c_str(), &socket_st));
+    test("socket mode", (int)(S_IRUSR | S_IWUSR), (int)(socket_st.st_mode & 0777));
+    std::thread thread(spek_server_run, server);
+
+    {
+        Client client(socket_path);
+        client.send("render\tr1\t" + SAMPLE + "\twidth=100\theight=50");
+        std::string response = client.receive();
+        test("render", true, starts_with(response, "ok\tr1\t"));
+        test("miss", true, response.find("\tmiss") != std::string::npos);
+        struct stat st;
+        test("image", 0, stat(result_path(response).c_str(), &st));
+
+        client.send("render\tr2\t" + SAMPLE + "\twidth=100\theight=50");
+        test("cached", "ok\tr2\t" + result_path(response) + "\thit", client.receive());
+
+        client.send("data\td1\t" + SAMPLE + "\twidth=10\tfft=8");
+        response = client.receive();
+        test("data", true, starts_with(response, "ok\td1\t"));
+        test("data size", 0, stat(result_path(response).c_str(), &st));
+        test("data bytes", (int64_t)(10 * (129 + 3) * sizeof(float)), (int64_t)st.st_size);
+        client.send("data\td2\t" + SAMPLE + "\twidth=10\tfft=8\theight=7\tpalette=mono");
+        test("same data", "ok\td2\t" + result_path(response) + "\thit", client.receive());
+
+        // The only worker is busy, the queued requests go by priority.
+        client.send("render\tb\t" + SAMPLE + "\twidth=200");
+        while (true) {
+            client.send("stats");
+            if (client.receive().find("running=1") != std::string::npos) {
+                break;
+            }
+        }
+        client.send("render\tlow\t" + SAMPLE + "\twidth=201");
+        client.send("render\thigh\t" + SAMPLE + "\twidth=202\tpriority=5");
+        client.send("cancel\tb");
+        // The worker may go on before the answer to the cancel is sent.
+        std::vector<std::string> responses;
+        for (int i = 0; i < 3; i++) {
+            std::string line = client.receive();
+            if (line != "error\tb\tCancelled") {
+                responses.push_back(line.substr(0, line.find('\t', 3)));
+            }
+        }
+        test("cancelled", 2, (int)responses.size());
+        test("high first", std::string("ok\thigh"), responses[0]);
+        test("low next", std::string("ok\tlow"), responses[1]);
+        test("order", true, rendered == std::vector<int>({ 100, 202, 201 }));
+
+        // Joining a queued job raises its priority.
+        client.send("render\tb\t" + SAMPLE + "\twidth=200");
+        while (true) {
+            client.send("stats");
+            if (client.receive().find("running=1") != std::string::npos) {
+                break;
+            }
+        }
+        client.send("render\tlow\t" + SAMPLE + "\twidth=301");
+        client.send("render\thigh\t" + SAMPLE + "\twidth=302\tpriority=5");
+        client.send("render\turgent\t" + SAMPLE + "\twidth=301\tpriority=9");
+        client.send("cancel\tb");
+        responses.clear();
+        for (int i = 0; i < 4; i++) {
+            std::string line = client.receive();
+            if (line != "error\tb\tCancelled") {
+                responses.push_back(line.substr(0, line.find('\t', 3)));
+            }
+        }
+        test("raised", 3, (int)responses.size());
+        test("raised first", std::string("ok\tlow"), responses[0]);
+        test("raised too", std::string("ok\turgent"), responses[1]);
+        test("high after", std::string("ok\thigh"), responses[2]);
+
+        client.send("render\tm\t" + std::string(dir) + "/missing.flac");
+        test("missing", true, starts_with(client.receive(), "error\tm\t"));
+        client.send("render\tp\t" + SAMPLE + "\tpalette=pink");
+        test("palette", std::string("error\tp\tUnknown palette pink"), client.receive());
+        client.send("bogus");
+        test("unknown", std::string("error\t\tUnknown command"), client.receive());
+        client.send("cancel\tnothing");
+        test("unknown id", std::string("error\tnothing\tUnknown request"), client.receive());
+        client.send("stats");
+        test("stats", true, starts_with(client.receive(), "stats\tqueued=0\trunning=0\t"));
+    }
+
+    spek_server_stop(server);
+    thread.join();
+    spek_server_close(server);
+    test("socket removed", -1, access(socket_path.c_str(), F_OK));
+    std::string command = std::string("rm -rf ") + dir;
+    test("cleanup", 0, system(command.c_str()));
+}
+
+static void test_socket_path()
+{
+    char dir[] = "/tmp/spek-test-XXXXXX";
+    test("temp dir", true, mkdtemp(dir) != NULL);
+    std::string socket_path = std::string(dir) + "/notes.txt";
+    std::ofstream(socket_path.c_str()) << "notes";
+
+    std::string error;
+    spek_server *server = spek_server_open(socket_path, dir, 1, fake_render, &error);
+    test("not opened", true, server == NULL);
+    test("error", socket_path + " exists and isn't a socket", error);
+    std::string contents;
+    std::getline(std::ifstream(socket_path.c_str()), contents);
+    test("file kept", std::string("notes"), contents);
+
+    std::string command = std::string("rm -rf ") + dir;
+    test("cleanup", 0, system(command.c_str()));
+}
+
+#endif
+
+void test_server()
+{
+#ifndef OS_WIN
+    run("server requests", test_requests);
+    run("server socket path", test_socket_path);
+#endif
+}
@@ -0,0 +1,65 @@
+#include <math.h>
+
+#include <vector>
+
+#include "spek-spectrum.h"
+
+#include "test.h"
+
+static void test_stats()
+{
+    // The first band's level goes evenly from -100 to -1 dB, the second one is silent.
+    SpectrumStats stats;
+    stats.create(2);
+    for (int i = 0; i < 100; i++) {
+        float values[] = { -100.0f + i, -INFINITY };
+        stats.add(values);
+    }
+    test("columns", (int64_t)100, stats.get_columns());
+    test("p10", true, fabs(stats.get_quantile(0, 0.1) - -90.0) <= 0.5);
+    test("p90", true, fabs(stats.get_quantile(0, 0.9) - -10.0) <= 0.5);
+    test("median", true, fabs(stats.get_quantile(0, 0.5) - -50.0) <= 0.5);
+    // The mean power is dominated by the loudest columns.
+    test("mean", true, stats.get_mean(0) > -15.0 && stats.get_mean(0) < -13.0);
+    test("silent mean", true, std::isinf(stats.get_mean(1)));
+    test("silent p90", true, std::isinf(stats.get_quantile(1, 0.9)));
+}
+
+static void test_merge()
+{
+    // Two halves of a file give the same as the whole.
+    SpectrumStats whole, first, second;
+    whole.create(1);
+    first.create(1);
+    second.create(1);
+    for (int i = 0; i < 200; i++) {
+        float value = -60.0f + (i * 7 % 40);
+        whole.add(&value);
+        (i < 100 ? first : second).add(&value);
+    }
+    first.merge(second);
+    test("columns", whole.get_columns(), first.get_columns());
+    test("mean", whole.get_mean(0), first.get_mean(0));
+    test("p10", whole.get_quantile(0, 0.1), first.get_quantile(0, 0.1));
+    test("p90", whole.get_quantile(0, 0.9), first.get_quantile(0, 0.9));
+}
+
+static void test_spectrum_analyzer()
+{
+    SpectrumAnalyzer analyzer;
+    AnalyzerFormat format = { 44100, 16, 1.0, 3, 0.0, 22050.0, 1 };
+    analyzer.start(format);
+    std::vector<float> values = { -20.0f, -40.0f, -60.0f };
+    analyzer.process_column(0, values.data());
+    analyzer.finish();
+    test("bands", 3, analyzer.get_stats().get_bands());
+    test("freq", 11025.0, analyzer.get_freq(1));
+    test("level", true, fabs(analyzer.get_stats().get_mean(2) - -60.0) < 1e-6);
+}
+
+void test_spectrum()
+{
+    run("spectrum stats", test_stats);
+    run("spectrum merge", test_merge);
+    run("spectrum analyzer", test_spectrum_analyzer);
+}
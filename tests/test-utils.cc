@@ -23,7 +23,20 @@ static void test_vercmp()
     test("1.0.0 < 1.0.1", -1, spek_vercmp("1.0.0", "1.0.1"));
 }
 
+static void test_audio_file()
+{
+    test("flac", true, spek_is_audio_file("/music/track.flac"));
+    test("upper case", true, spek_is_audio_file("TRACK.MP3"));
+    test("plus", true, spek_is_audio_file("track.mp+"));
+    test("image", false, spek_is_audio_file("/music/cover.png"));
+    test("prefix", false, spek_is_audio_file("track.fla"));
+    test("longer", false, spek_is_audio_file("track.flac2"));
+    test("no extension", false, spek_is_audio_file("/music.flac/track"));
+    test("dot only", false, spek_is_audio_file("track."));
+}
+
 void test_utils()
 {
     run("vercmp", test_vercmp);
+    run("audio file", test_audio_file);
 }
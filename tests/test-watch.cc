@@ -0,0 +1,160 @@
+#ifndef OS_WIN
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "spek-report.h"
+#include "spek-watch.h"
+
+#include "test.h"
+
+#ifndef OS_WIN
+
+static const std::string SAMPLE = SAMPLES_DIR "/2ch-48000Hz-16bps.flac";
+
+enum
+{
+    SETTLE_MS = 50,
+    TIMEOUT_MS = 10000,
+    BANDS = 1025, // Of the columns the watch saves.
+    COLUMNS = 1024,
+};
+
+static std::mutex rendered_mutex;
+static std::multiset<std::string> rendered; // The audio files the images were made of.
+
+// Makes the pass over the file without an image.
+static bool fake_render(
+    const std::string& path, const std::string& out_path,
+    const std::vector<std::shared_ptr<Analyzer>>& analyzers, ColumnsRecorder *columns,
+    SampleBits *bits, const std::atomic<bool> *cancelled)
+{
+    {
+        std::lock_guard<std::mutex> lock(rendered_mutex);
+        rendered.insert(path);
+    }
+    if (!spek_report_analyse(path, analyzers, columns, bits, cancelled)) {
+        return false;
+    }
+    std::ofstream(out_path.c_str()) << "png";
+    return true;
+}
+
+static void copy_file(const std::string& from, const std::string& to)
+{
+    std::ifstream in(from.c_str(), std::ios::binary);
+    std::ofstream out(to.c_str(), std::ios::binary);
+    out << in.rdbuf();
+}
+
+static bool wait_for(spek_watch *watch, int processed)
+{
+    for (int ms = 0; ms < TIMEOUT_MS; ms += 10) {
+        if (spek_watch_processed(watch) >= processed) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static long long file_size(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (long long)st.st_size : -1;
+}
+
+static void test_changes()
+{
+    char root[] = "/tmp/spek-test-XXXXXX";
+    test("temp dir", true, mkdtemp(root) != NULL);
+    std::string in = std::string(root) + "/in";
+    std::string out = std::string(root) + "/out";
+    mkdir(in.c_str(), 0755);
+    copy_file(SAMPLE, in + "/a.flac");
+
+    std::ostringstream log;
+    std::string error;
+    spek_watch *watch = spek_watch_open(in, out, 2, SETTLE_MS, fake_render, log, &error);
+    test("open", std::string(), error);
+    std::thread thread(spek_watch_run, watch);
+
+    test("existing", true, wait_for(watch, 1));
+    test("image", 3LL, file_size(out + "/a.flac.png"));
+    // With the lowest, the highest and the RMS sample value of each column.
+    test(
+        "columns", (long long)((BANDS + 3) * COLUMNS * sizeof(float)),
+        file_size(out + "/a.flac.f32")
+    );
+    std::ifstream report((out + "/a.flac.tsv").c_str());
+    std::string header, result;
+    std::getline(report, header);
+    std::getline(report, result);
+    test("report header", spek_report_header(), header);
+    test("report line", in + "/a.flac\t", result.substr(0, in.size() + 8));
+
+    mkdir((in + "/sub").c_str(), 0755);
+    std::ofstream((in + "/sub/notes.txt").c_str()) << "not audio";
+    copy_file(SAMPLE, in + "/sub/b.FLAC");
+    test("new", true, wait_for(watch, 2));
+    test("new image", 3LL, file_size(out + "/sub/b.FLAC.png"));
+
+    spek_watch_stop(watch);
+    thread.join();
+    spek_watch_close(watch);
+    std::string expected = "done\t" + in + "/a.flac\ndone\t" + in + "/sub/b.FLAC\n";
+    test("log", expected, log.str());
+
+    // A restart skips the files done until they change.
+    watch = spek_watch_open(in, out, 2, SETTLE_MS, fake_render, log, &error);
+    thread = std::thread(spek_watch_run, watch);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS * 4));
+    test("unchanged", 0, spek_watch_processed(watch));
+    struct timeval times[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+    utimes((in + "/a.flac").c_str(), times);
+    test("changed", true, wait_for(watch, 1));
+    // Within the same second.
+    times[0].tv_usec = times[1].tv_usec = 500000;
+    utimes((in + "/a.flac").c_str(), times);
+    test("changed subsecond", true, wait_for(watch, 2));
+    spek_watch_stop(watch);
+    thread.join();
+    spek_watch_close(watch);
+
+    test("rendered", (size_t)3, rendered.count(in + "/a.flac"));
+    test("rendered new", (size_t)1, rendered.count(in + "/sub/b.FLAC"));
+    test("rendered all", (size_t)4, rendered.size());
+
+    std::ifstream state((out + "/watch.state").c_str());
+    std::string line;
+    int lines = 0;
+    while (std::getline(state, line)) {
+        lines++;
+    }
+    test("state", 4, lines);
+
+    error.clear();
+    test("missing dir", true, !spek_watch_open(in + "/missing", out, 1, 0, NULL, log, &error));
+    test("missing dir error", false, error.empty());
+
+    std::string command = std::string("rm -rf ") + root;
+    test("cleanup", 0, system(command.c_str()));
+}
+
+#endif
+
+void test_watch()
+{
+#ifndef OS_WIN
+    run("watch changes", test_changes);
+#endif
+}
@@ -7,9 +7,23 @@ int main()
 {
     std::cerr << "-------------" << std::endl;
 
+    test_album();
+    test_analyzer();
+    test_api();
     test_audio();
+    test_bits();
+    test_columns();
+    test_cutoff();
+    test_dsp();
     test_fft();
+    test_loudness();
+    test_palette();
+    test_png();
+    test_scale();
+    test_server();
+    test_spectrum();
     test_utils();
+    test_watch();
 
     if (g_passes < g_total) {
         std::cerr << "\x1b[31;1m" << (g_total - g_passes) << "/" << g_total;
@@ -33,6 +33,20 @@ template<class T> void test(const std::string& message, const T& expected, const
     }
 }
 
+void test_album();
+void test_analyzer();
+void test_api();
 void test_audio();
+void test_bits();
+void test_columns();
+void test_cutoff();
+void test_dsp();
 void test_fft();
+void test_loudness();
+void test_palette();
+void test_png();
+void test_scale();
+void test_server();
+void test_spectrum();
 void test_utils();
+void test_watch();